@@ -42,11 +42,12 @@
 #include "meer-def.h"
 #include "config-yaml.h"
 #include "util.h"
+#include "util-cidr.h"
 #include "decode-json-alert.h"
 
 #ifdef WITH_BLUEDOT
 #include "output-plugins/bluedot.h"
-struct _Bluedot_Skip *Bluedot_Skip = NULL;
+struct _CIDR_Trie Bluedot_Skip;
 #endif
 
 #ifdef WITH_ELASTICSEARCH
@@ -58,7 +59,7 @@ struct _MeerOutput *MeerOutput;
 struct _MeerCounters *MeerCounters;
 struct _MeerHealth *MeerHealth = NULL;
 
-struct _Fingerprint_Networks *Fingerprint_Networks;
+struct _CIDR_Trie Fingerprint_Networks;
 
 void Load_YAML_Config( char *yaml_file )
 {
@@ -104,8 +105,16 @@ void Load_YAML_Config( char *yaml_file )
     MeerConfig->classification_file[0] = '\0';
     MeerConfig->waldo_file[0] = '\0';
     MeerConfig->follow_file[0] = '\0';
+    MeerConfig->socket_stream[0] = '\0';
+    MeerConfig->socket_dgram[0] = '\0';
+    MeerConfig->socket_spool[0] = '\0';
+    MeerConfig->decode_threads = 0;
+    MeerConfig->spill_dir[0] = '\0';
+    MeerConfig->spool_punch_holes = false;
     MeerConfig->lock_file[0] = '\0';
     MeerConfig->fingerprint_log[0] = '\0';
+    MeerConfig->dns_snapshot[0] = '\0';
+    MeerConfig->dns_snapshot_interval = DNS_SNAPSHOT_INTERVAL_DEFAULT;
     MeerConfig->fingerprint = false;
 
     strlcpy(MeerConfig->meer_log, MEER_LOG, sizeof(MeerConfig->meer_log));
@@ -149,6 +158,7 @@ void Load_YAML_Config( char *yaml_file )
 
     MeerConfig->client_stats = false;
     MeerConfig->oui = false;
+    MeerConfig->oui_database[0] = '\0';
 
 
     MeerOutput->pipe_size =  DEFAULT_PIPE_SIZE;
@@ -334,6 +344,48 @@ void Load_YAML_Config( char *yaml_file )
                                     strlcpy(MeerConfig->follow_file, value, sizeof(MeerConfig->follow_file));
                                 }
 
+                            else if ( !strcmp(last_pass, "socket_stream" ) )
+                                {
+                                    strlcpy(MeerConfig->socket_stream, value, sizeof(MeerConfig->socket_stream));
+                                }
+
+                            else if ( !strcmp(last_pass, "socket_dgram" ) )
+                                {
+                                    strlcpy(MeerConfig->socket_dgram, value, sizeof(MeerConfig->socket_dgram));
+                                }
+
+                            else if ( !strcmp(last_pass, "socket_spool" ) )
+                                {
+                                    strlcpy(MeerConfig->socket_spool, value, sizeof(MeerConfig->socket_spool));
+                                }
+
+                            else if ( !strcmp(last_pass, "decode_threads" ) )
+                                {
+
+                                    MeerConfig->decode_threads = atoi(value);
+
+                                    if ( MeerConfig->decode_threads > PIPELINE_MAX_THREADS )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'decode_threads' can't be more than %d. Abort!", __FILE__, __LINE__, PIPELINE_MAX_THREADS);
+                                        }
+
+                                }
+
+                            else if ( !strcmp(last_pass, "spill_dir" ) )
+                                {
+                                    strlcpy(MeerConfig->spill_dir, value, sizeof(MeerConfig->spill_dir));
+                                }
+
+                            else if ( !strcmp(last_pass, "spool_punch_holes" ) )
+                                {
+
+                                    if ( !strcasecmp(value, "yes") || !strcasecmp(value, "true" ) || !strcasecmp(value, "enabled"))
+                                        {
+                                            MeerConfig->spool_punch_holes = true;
+                                        }
+
+                                }
+
                             else if ( !strcmp(last_pass, "dns" ))
                                 {
 
@@ -341,6 +393,10 @@ void Load_YAML_Config( char *yaml_file )
                                         {
                                             MeerConfig->dns = true;
                                             MeerConfig->dns_cache = DNS_CACHE_DEFAULT;
+                                            MeerConfig->dns_cache_size = DNS_CACHE_SIZE_DEFAULT;
+                                            MeerConfig->dns_negative_cache = DNS_NEGATIVE_CACHE_DEFAULT;
+                                            MeerConfig->dns_threads = DNS_THREADS_DEFAULT;
+                                            MeerConfig->dns_wait = DNS_WAIT_DEFAULT;
                                         }
 
                                 }
@@ -352,6 +408,53 @@ void Load_YAML_Config( char *yaml_file )
 
                                 }
 
+                            else if ( !strcmp(last_pass, "dns_cache_size" ))
+                                {
+
+                                    MeerConfig->dns_cache_size = atoi(value);
+
+                                }
+
+                            else if ( !strcmp(last_pass, "dns_negative_cache" ))
+                                {
+
+                                    MeerConfig->dns_negative_cache = atoi(value);
+
+                                }
+
+                            else if ( !strcmp(last_pass, "dns_threads" ))
+                                {
+
+                                    MeerConfig->dns_threads = atoi(value);
+
+                                    if ( MeerConfig->dns_threads > DNS_MAX_THREADS )
+                                        {
+                                            Meer_Log(ERROR, "[%s, line %d] 'dns_threads' can't be more than %d. Abort!", __FILE__, __LINE__, DNS_MAX_THREADS);
+                                        }
+
+                                }
+
+                            else if ( !strcmp(last_pass, "dns_wait" ))
+                                {
+
+                                    MeerConfig->dns_wait = atoi(value);
+
+                                }
+
+                            else if ( !strcmp(last_pass, "dns_snapshot" ))
+                                {
+
+                                    strlcpy(MeerConfig->dns_snapshot, value, sizeof(MeerConfig->dns_snapshot));
+
+                                }
+
+                            else if ( !strcmp(last_pass, "dns_snapshot_interval" ))
+                                {
+
+                                    MeerConfig->dns_snapshot_interval = atoi(value);
+
+                                }
+
                             else if ( !strcmp(last_pass, "oui_lookup" ))
                                 {
 
@@ -367,6 +470,11 @@ void Load_YAML_Config( char *yaml_file )
                                     strlcpy(MeerConfig->oui_filename, value, sizeof(MeerConfig->oui_filename));
                                 }
 
+                            else if ( !strcmp(last_pass, "oui_database" ))
+                                {
+                                    strlcpy(MeerConfig->oui_database, value, sizeof(MeerConfig->oui_database));
+                                }
+
 
                             else if ( !strcmp(last_pass, "metadata" ) )
                                 {
@@ -479,15 +587,7 @@ void Load_YAML_Config( char *yaml_file )
                                 {
 
                                     char *fp_ptr = NULL;
-                                    char *fp_range = NULL;
                                     char *tok = NULL;
-                                    char *fp_ipblock = NULL;
-
-                                    unsigned char fp_ipbits[MAXIPBIT] = { 0 };
-                                    unsigned char fp_maskbits[MAXIPBIT]= { 0 };
-
-                                    int fp_mask;
-
 
                                     Remove_Spaces(value);
 
@@ -496,46 +596,13 @@ void Load_YAML_Config( char *yaml_file )
                                     while ( fp_ptr != NULL )
                                         {
 
-                                            //printf("%s\n", fp_ptr);
-
-                                            fp_ipblock = strtok_r(fp_ptr, "/", &fp_range);
-
-                                            //printf("%s %s\n", fp_ipblock, fp_range);
-
-                                            if ( fp_ipblock == NULL )
-                                                {
-                                                    Meer_Log(ERROR, "Fingerprint ip block %s is invalid.  Abort", fp_ptr);
-                                                }
-
-                                            if (!IP2Bit(fp_ipblock, fp_ipbits))
-                                                {
-                                                    Meer_Log(ERROR, "[%s, line %d] Invalid address %s in 'fingerprint_networks'. Abort", __FILE__, __LINE__, fp_ptr );
-                                                }
-
-                                            Fingerprint_Networks = (_Fingerprint_Networks *) realloc(Fingerprint_Networks, (MeerCounters->fingerprint_network_count+1) * sizeof(_Fingerprint_Networks));
-
-                                            if ( Fingerprint_Networks == NULL )
-                                                {
-                                                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for _Fingerprint_Networks Abort!", __FILE__, __LINE__);
-                                                }
-
-                                            memset(&Fingerprint_Networks[MeerCounters->fingerprint_network_count], 0, sizeof(_Fingerprint_Networks));
-
-                                            fp_mask = atoi(fp_range);
-
-
-                                            if ( fp_mask == 0 || !Mask2Bit(fp_mask, fp_maskbits))
+                                            if ( !CIDR_Trie_Add_String( &Fingerprint_Networks, fp_ptr ) )
                                                 {
-                                                    Meer_Log(ERROR, "[%s, line %d] Invalid mask for GeoIP 'skip_networks'. Abort", __FILE__, __LINE__);
+                                                    Meer_Log(ERROR, "[%s, line %d] Invalid network %s in 'fingerprint_networks'. Abort", __FILE__, __LINE__, fp_ptr );
                                                 }
 
-
-
-                                            memcpy(Fingerprint_Networks[MeerCounters->fingerprint_network_count].range.ipbits, fp_ipbits, sizeof(fp_ipbits));
-                                            memcpy(Fingerprint_Networks[MeerCounters->fingerprint_network_count].range.maskbits, fp_maskbits, sizeof(fp_maskbits));
                                             MeerCounters->fingerprint_network_count++;
 
-
                                             fp_ptr = strtok_r(NULL, ",", &tok);
 
                                         }
@@ -1364,60 +1431,19 @@ void Load_YAML_Config( char *yaml_file )
 
                                     Remove_Spaces(value);
 
-                                    int  bluedot_mask = 0;
-
                                     char *tok = NULL;
-                                    char *bluedot_iprange = NULL;
-                                    char *bluedot_tok = NULL;
-                                    char *bluedot_tmpmask = NULL;
-
-                                    unsigned char bluedot_ipbits[MAXIPBIT] = { 0 };
-                                    unsigned char bluedot_maskbits[MAXIPBIT]= { 0 };
-
                                     char *bluedot_ptr = strtok_r(value, ",", &tok);
 
                                     while ( bluedot_ptr != NULL )
                                         {
 
-                                            bluedot_iprange = strtok_r(bluedot_ptr, "/", &bluedot_tok);
-
-                                            if ( bluedot_iprange == NULL )
-                                                {
-                                                    Meer_Log(ERROR, "[%s, line %d] 'bluedot' - 'skip_networks' is invalid. Abort.", __FILE__, __LINE__);
-                                                }
+                                            /* Without a mask it's a single host */
 
-                                            if (!IP2Bit(bluedot_iprange, bluedot_ipbits))
+                                            if ( !CIDR_Trie_Add_String( &Bluedot_Skip, bluedot_ptr ) )
                                                 {
-                                                    Meer_Log(ERROR, "[%s, line %d] 'bluedot' - 'skip_address' is invalid. Abort", __FILE__, __LINE__);
+                                                    Meer_Log(ERROR, "[%s, line %d] 'bluedot' - '%s' in 'skip_networks' is invalid. Abort", __FILE__, __LINE__, bluedot_ptr);
                                                 }
 
-                                            bluedot_tmpmask = strtok_r(NULL, "/", &bluedot_tok);
-
-                                            if ( bluedot_tmpmask == NULL )
-                                                {
-                                                    bluedot_mask = 32;
-                                                }
-
-                                            Bluedot_Skip = (_Bluedot_Skip *) realloc(Bluedot_Skip, (MeerCounters->bluedot_skip_count+1) * sizeof(_Bluedot_Skip));
-
-                                            if ( Bluedot_Skip == NULL )
-                                                {
-                                                    Meer_Log(ERROR, "[%s, line %d] 'bluedot' - Failed to reallocate memory for Bluedot_Skip Abort!", __FILE__, __LINE__);
-                                                }
-
-                                            memset(&Bluedot_Skip[MeerCounters->bluedot_skip_count], 0, sizeof(_Bluedot_Skip));
-
-                                            bluedot_mask = atoi(bluedot_tmpmask);
-
-                                            if ( bluedot_mask == 0 || !Mask2Bit(bluedot_mask, bluedot_maskbits))
-                                                {
-                                                    Meer_Log(ERROR, "[%s, line %d] Invalid mask for Bluedot 'skip_networks'. Abort", __FILE__, __LINE__);
-                                                }
-
-
-                                            memcpy(Bluedot_Skip[MeerCounters->bluedot_skip_count].range.ipbits, bluedot_ipbits, sizeof(bluedot_ipbits));
-                                            memcpy(Bluedot_Skip[MeerCounters->bluedot_skip_count].range.maskbits, bluedot_maskbits, sizeof(bluedot_maskbits));
-
                                             MeerCounters->bluedot_skip_count++;
 
                                             bluedot_ptr = strtok_r(NULL, ",", &tok);
@@ -1602,9 +1628,9 @@ void Load_YAML_Config( char *yaml_file )
             Meer_Log(ERROR, "Configuration incomplete.  No 'waldo-file' specified!");
         }
 
-    if ( MeerConfig->follow_file[0] == '\0' )
+    if ( MeerConfig->follow_file[0] == '\0' && MeerConfig->socket_stream[0] == '\0' && MeerConfig->socket_dgram[0] == '\0' )
         {
-            Meer_Log(ERROR, "Configuration incomplete.  No 'follow-exe' file specified!");
+            Meer_Log(ERROR, "Configuration incomplete.  No 'follow-exe' file or 'socket_stream'/'socket_dgram' specified!");
         }
 
     if ( MeerConfig->lock_file[0] == '\0' )
@@ -1612,6 +1638,11 @@ void Load_YAML_Config( char *yaml_file )
             Meer_Log(ERROR, "Configuration incomplete.  No 'lock-file' file specified!");
         }
 
+    if ( MeerConfig->spill_dir[0] != '\0' && MeerConfig->decode_threads == 0 )
+        {
+            Meer_Log(ERROR, "'spill_dir' needs 'decode_threads' to be set.  Abort!");
+        }
+
 #ifdef HAVE_LIBMYSQLCLIENT
 
     if ( MeerOutput->sql_enabled == true )
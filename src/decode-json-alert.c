@@ -18,7 +18,9 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-/* Decode Sagan/Suricata "alerts" */
+/* Decode Sagan/Suricata "alerts".  The event has already been parsed (in
+   Decode_JSON()),  so the nested objects ("alert",  "flow",  "http",  etc)
+   are read straight out of that tree.  Nothing is parsed twice. */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"             /* From autoconf */
@@ -38,685 +40,880 @@ libjson-c is required for Meer to function!
 #include <errno.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
+#include <pthread.h>
 
 #include "util.h"
+#include "util-dns.h"
 #include "meer.h"
 #include "meer-def.h"
+#include "meer-json.h"
 
 #include "decode-json-alert.h"
+#include "sid-cache.h"
 
 struct _MeerCounters *MeerCounters;
 struct _MeerConfig *MeerConfig;
+struct _MeerOutput *MeerOutput;
 
-struct _DecodeAlert *Decode_JSON_Alert( struct json_object *json_obj, char *json_string )
-{
-
-    struct _DecodeAlert *Alert_Return_Struct = NULL;
-    struct json_object *tmp = NULL;
-
-    struct json_object *tmp_alert = NULL;
-    struct json_object *tmp_flow = NULL;
-    struct json_object *tmp_http = NULL;
-    struct json_object *tmp_tls = NULL;
-    struct json_object *tmp_smtp = NULL;
-    struct json_object *tmp_email = NULL;
-
-    struct json_object *tmp_ssh_server = NULL;
-    struct json_object *tmp_ssh_server_2 = NULL;
-    struct json_object *tmp_ssh_server_3 = NULL;
+/* Where each protocol's fields go in _DecodeAlert */
 
-    struct json_object *tmp_ssh_client = NULL;
-    struct json_object *tmp_ssh_client_2 = NULL;
-    struct json_object *tmp_ssh_client_3 = NULL;
+#define DECODE_STRING(k, f)	{ k, offsetof(_DecodeAlert, f), sizeof(((_DecodeAlert *)0)->f), DECODE_FIELD_STRING }
+#define DECODE_REF(k, f)	{ k, offsetof(_DecodeAlert, f), 0, DECODE_FIELD_REF }
+#define DECODE_NUMBER(k, f, t)	{ k, offsetof(_DecodeAlert, f), sizeof(((_DecodeAlert *)0)->f), t }
 
-    struct json_object *json_obj_alert = NULL;
-    struct json_object *json_obj_flow = NULL;
-    struct json_object *json_obj_http = NULL;
-    struct json_object *json_obj_tls = NULL;
-    struct json_object *json_obj_smtp = NULL;
-    struct json_object *json_obj_email = NULL;
+static const struct _DecodeAlertField DecodeAlertFlow[] =
+{
+    DECODE_NUMBER("pkts_toserver", flow_pkts_toserver, DECODE_FIELD_UINT64),
+    DECODE_NUMBER("pkts_toclient", flow_pkts_toclient, DECODE_FIELD_UINT64),
+    DECODE_NUMBER("bytes_toserver", flow_bytes_toserver, DECODE_FIELD_UINT64),
+    DECODE_NUMBER("bytes_toclient", flow_bytes_toclient, DECODE_FIELD_UINT64),
+    DECODE_STRING("start", flow_start_timestamp),
+    { NULL }
+};
+
+static const struct _DecodeAlertField DecodeAlertHTTP[] =
+{
+    DECODE_STRING("hostname", http_hostname),
+    DECODE_REF("url", http_url),
+    DECODE_STRING("http_content_type", http_content_type),
+    DECODE_STRING("http_method", http_method),
+    DECODE_REF("http_user_agent", http_user_agent),
+    DECODE_REF("http_refer", http_refer),
+    DECODE_STRING("protocol", http_protocol),
+    DECODE_STRING("xff", http_xff),
+    DECODE_NUMBER("status", http_status, DECODE_FIELD_INT),
+    DECODE_NUMBER("length", http_length, DECODE_FIELD_UINT64),
+    { NULL }
+};
+
+static const struct _DecodeAlertField DecodeAlertEmail[] =
+{
+    DECODE_STRING("status", email_status),
+    DECODE_REF("from", email_from),
+    DECODE_REF("to", email_to),
+    DECODE_REF("attachment", email_attachment),
+    { NULL }
+};
+
+static const struct _DecodeAlertField DecodeAlertSMTP[] =
+{
+    DECODE_STRING("helo", smtp_helo),
+    DECODE_STRING("mail_from", smtp_mail_from),
+    DECODE_REF("rcpt_to", smtp_rcpt_to),
+    { NULL }
+};
 
-    struct json_object *json_obj_ssh_server = NULL;
-    struct json_object *json_obj_ssh_client = NULL;
+static const struct _DecodeAlertField DecodeAlertTLS[] =
+{
+    DECODE_STRING("session_resumed", tls_session_resumed),
+    DECODE_STRING("sni", tls_sni),
+    DECODE_STRING("version", tls_version),
+    DECODE_STRING("subject", tls_subject),
+    DECODE_STRING("issuerdn", tls_issuerdn),
+    DECODE_STRING("notbefore", tls_notbefore),
+    DECODE_STRING("notafter", tls_notafter),
+    DECODE_STRING("fingerprint", tls_fingerprint),
+    DECODE_NUMBER("serial", tls_serial, DECODE_FIELD_UINT32),
+    { NULL }
+};
+
+static const struct _DecodeAlertField DecodeAlertSSHServer[] =
+{
+    DECODE_STRING("proto_version", ssh_server_proto_version),
+    DECODE_STRING("software_version", ssh_server_software_version),
+    { NULL }
+};
 
-    bool has_alert = false;
+static const struct _DecodeAlertField DecodeAlertSSHClient[] =
+{
+    DECODE_STRING("proto_version", ssh_client_proto_version),
+    DECODE_STRING("software_version", ssh_client_software_version),
+    { NULL }
+};
 
-    char new_ip[64];
+static const struct _DecodeAlertSection DecodeAlertSections[] =
+{
+    { "flow", NULL, NULL, offsetof(_DecodeAlert, has_flow), false, true, offsetof(_MeerCounters, FlowCount), DecodeAlertFlow },
+    { "http", NULL, "http", offsetof(_DecodeAlert, has_http), false, true, offsetof(_MeerCounters, HTTPCount), DecodeAlertHTTP },
+    { "email", NULL, "smtp", offsetof(_DecodeAlert, has_email), true, true, offsetof(_MeerCounters, EmailCount), DecodeAlertEmail },
+    { "smtp", NULL, "smtp", offsetof(_DecodeAlert, has_smtp), true, true, offsetof(_MeerCounters, SMTPCount), DecodeAlertSMTP },
+    { "tls", NULL, "tls", offsetof(_DecodeAlert, has_tls), true, true, offsetof(_MeerCounters, TLSCount), DecodeAlertTLS },
+    { "ssh", "server", "ssh", offsetof(_DecodeAlert, has_ssh_server), false, true, offsetof(_MeerCounters, SSHCount), DecodeAlertSSHServer },
+    { "ssh", "client", "ssh", offsetof(_DecodeAlert, has_ssh_client), false, false, 0, DecodeAlertSSHClient }
+};
+
+#define DECODE_ALERT_SECTIONS	( sizeof(DecodeAlertSections) / sizeof(DecodeAlertSections[0]) )
+
+static const struct _DecodeAlertSection *DecodeAlertPlan[DECODE_ALERT_SECTIONS];
+static int DecodeAlertPlanCount = 0;
+
+/****************************************************************************
+ * Decode_JSON_Alert_Init - Work out which protocol sections of an alert
+ * anything reads.  Those are the only ones Decode_JSON_Alert() extracts.
+ ****************************************************************************/
+
+void Decode_JSON_Alert_Init( void )
+{
 
-    Alert_Return_Struct = (struct _DecodeAlert *) malloc(sizeof(_DecodeAlert));
+    const struct _DecodeAlertSection *Section = NULL;
+    bool sql = MeerOutput->sql_enabled;
+    bool wanted = false;
+    bool enabled = false;
+    int i = 0;
 
-    if ( Alert_Return_Struct == NULL )
+    for ( i = 0; i < DECODE_ALERT_SECTIONS; i++ )
         {
-            Meer_Log(ERROR, "[%s, line %d] JSON: \"%s\" Failed to allocate memory for _DecodeAlert. Abort!", __FILE__, __LINE__, json_string);
-        }
 
-    memset(Alert_Return_Struct, 0, sizeof(_DecodeAlert));
+            Section = &DecodeAlertSections[i];
 
-    Alert_Return_Struct->json = json_string;
-    Remove_Return(Alert_Return_Struct->json);
+            if ( !strcmp(Section->key, "flow") )
+                {
+                    enabled = MeerConfig->flow;
+                    wanted = sql && MeerOutput->sql_flow;
+                }
 
-    Alert_Return_Struct->event_type = "alert";
-    Alert_Return_Struct->ip_version = 4;
+            else if ( !strcmp(Section->key, "http") )
+                {
+                    enabled = MeerConfig->http;
+                    wanted = sql && MeerOutput->sql_http;
 
-    Alert_Return_Struct->timestamp = NULL;
-    Alert_Return_Struct->src_ip = NULL;
-    Alert_Return_Struct->dest_ip = NULL;
-    Alert_Return_Struct->flowid = NULL;
-    Alert_Return_Struct->proto = NULL;
-    Alert_Return_Struct->host = NULL;
+#ifdef HAVE_LIBHIREDIS
 
-    Alert_Return_Struct->facility = NULL;
-    Alert_Return_Struct->priority = NULL;
-    Alert_Return_Struct->level = NULL;
-    Alert_Return_Struct->program = NULL;
+                    /* Fingerprints keep the user agent and xff */
 
-    Alert_Return_Struct->converted_timestamp[0] = '\0';
-    Alert_Return_Struct->app_proto[0] = '\0';
+                    wanted = wanted || ( MeerOutput->redis_flag && MeerConfig->fingerprint );
+#endif
 
-    /* Extra data */
+                }
 
-    Alert_Return_Struct->xff = NULL;
+            else if ( !strcmp(Section->key, "email") )
+                {
+                    enabled = MeerConfig->email;
+                    wanted = sql && MeerOutput->sql_email;
+                }
 
-    Alert_Return_Struct->payload[0] = '\0';
-    Alert_Return_Struct->src_dns[0] = '\0';
-    Alert_Return_Struct->dest_dns[0] = '\0';
+            else if ( !strcmp(Section->key, "smtp") )
+                {
+                    enabled = MeerConfig->smtp;
+                    wanted = sql && MeerOutput->sql_smtp;
+                }
 
-    Alert_Return_Struct->alert_action[0] = '\0';
-    Alert_Return_Struct->alert_gid[0] = '\0';
-    Alert_Return_Struct->alert_rev = 0;
-    Alert_Return_Struct->alert_signature[0] = '\0';
-    Alert_Return_Struct->alert_category[0] = '\0';
-    Alert_Return_Struct->alert_severity[0] = '\0';
-    Alert_Return_Struct->alert_metadata[0] = '\0';
+            else if ( !strcmp(Section->key, "tls") )
+                {
+                    enabled = MeerConfig->tls;
+                    wanted = sql && MeerOutput->sql_tls;
+                }
 
-    Alert_Return_Struct->alert_has_metadata = false;
-    Alert_Return_Struct->alert_signature_id = 0;
+            else if ( !strcmp(Section->key, "ssh") )
+                {
+                    enabled = MeerConfig->ssh;
+                    wanted = sql && MeerOutput->sql_ssh;
+                }
 
-    /* Flow */
+            if ( enabled == false )
+                {
+                    continue;
+                }
 
-    Alert_Return_Struct->has_flow = false;
+            if ( wanted == false )
+                {
 
-    Alert_Return_Struct->flow_pkts_toserver = 0 ;
-    Alert_Return_Struct->flow_pkts_toclient = 0;
-    Alert_Return_Struct->flow_bytes_toserver = 0;
-    Alert_Return_Struct->flow_bytes_toclient = 0;
-    Alert_Return_Struct->flow_start_timestamp[0] = '\0';
+                    if ( Section->count == true )
+                        {
+                            Meer_Log(NORMAL, "Decode '%s' is enabled but no output uses it.  Skipping it.", Section->key);
+                        }
 
-    /* SMTP */
+                    continue;
+                }
 
-    Alert_Return_Struct->has_smtp = false;
+            DecodeAlertPlan[DecodeAlertPlanCount++] = Section;
+        }
 
-    Alert_Return_Struct->smtp_helo[0] = '\0';
-    Alert_Return_Struct->smtp_mail_from[0] = '\0';
-    Alert_Return_Struct->smtp_rcpt_to[0] = '\0';
+}
 
-    /* HTTP */
+/****************************************************************************
+ * Decode_JSON_Alert_Get - Take a _DecodeAlert from the pool (or make one)
+ * and clear it.  Only the small fixed fields are cleared,  the arena is
+ * just reset.
+ ****************************************************************************/
 
-    Alert_Return_Struct->has_http = false;
+static struct _DecodeAlert *DecodeAlertPool = NULL;
+static uint32_t DecodeAlertPoolCount = 0;
+static pthread_mutex_t DecodeAlertPoolMutex = PTHREAD_MUTEX_INITIALIZER;
 
-    Alert_Return_Struct->http_hostname[0] = '\0';
-    Alert_Return_Struct->http_url[0] = '\0';
-    Alert_Return_Struct->http_content_type[0] = '\0';
-    Alert_Return_Struct->http_method[0] = '\0';
-    Alert_Return_Struct->http_user_agent[0] = '\0';
-    Alert_Return_Struct->http_refer[0] = '\0';
-    Alert_Return_Struct->http_protocol[0] = '\0';
-    Alert_Return_Struct->http_xff[0] = '\0';
-    Alert_Return_Struct->http_length = 0;
+static char DecodeAlertEmpty[1] = "";
 
-    /* TLS */
+static struct _DecodeAlert *Decode_JSON_Alert_Get( void )
+{
 
-    Alert_Return_Struct->has_tls = false;
+    struct _DecodeAlert *DecodeAlert = NULL;
+    struct _MeerArena arena;
 
-    Alert_Return_Struct->tls_session_resumed[0] = '\0';
-    Alert_Return_Struct->tls_sni[0] = '\0';
-    Alert_Return_Struct->tls_version[0] = '\0';
-    Alert_Return_Struct->tls_subject[0] = '\0';
-    Alert_Return_Struct->tls_issuerdn[0] = '\0';
-    Alert_Return_Struct->tls_notbefore[0] = '\0';
-    Alert_Return_Struct->tls_notafter[0] = '\0';
-    Alert_Return_Struct->tls_fingerprint[0] = '\0';
-    Alert_Return_Struct->tls_serial = 0;
+    pthread_mutex_lock(&DecodeAlertPoolMutex);
 
+    DecodeAlert = DecodeAlertPool;
 
-    /* SSH */
+    if ( DecodeAlert != NULL )
+        {
+            DecodeAlertPool = DecodeAlert->next;
+            DecodeAlertPoolCount--;
+        }
 
-    Alert_Return_Struct->has_ssh_server = false;
-    Alert_Return_Struct->has_ssh_client = false;
+    pthread_mutex_unlock(&DecodeAlertPoolMutex);
 
-    Alert_Return_Struct->ssh_client_proto_version[0] = '\0';
-    Alert_Return_Struct->ssh_client_software_version[0] = '\0';
-    Alert_Return_Struct->ssh_server_proto_version[0] = '\0';
-    Alert_Return_Struct->ssh_server_software_version[0] = '\0';
+    if ( DecodeAlert == NULL )
+        {
 
-    /* Email */
+            DecodeAlert = (struct _DecodeAlert *) malloc(sizeof(_DecodeAlert));
 
-    Alert_Return_Struct->email_status[0] = '\0';
-    Alert_Return_Struct->email_from[0] = '\0';
-    Alert_Return_Struct->email_to[0] = '\0';
-    Alert_Return_Struct->email_cc[0] = '\0';
-    Alert_Return_Struct->email_attachment[0] = '\0';
+            if ( DecodeAlert == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _DecodeAlert. Abort!", __FILE__, __LINE__);
+                }
 
+            Arena_Init(&DecodeAlert->arena, DECODE_ALERT_ARENA_SIZE);
+        }
 
+    arena = DecodeAlert->arena;
+    memset(DecodeAlert, 0, sizeof(_DecodeAlert));
+    DecodeAlert->arena = arena;
+
+    DecodeAlert->new_json_string = DecodeAlertEmpty;
+    DecodeAlert->payload = DecodeAlertEmpty;
+    DecodeAlert->alert_metadata = DecodeAlertEmpty;
+    DecodeAlert->http_url = DecodeAlertEmpty;
+    DecodeAlert->http_user_agent = DecodeAlertEmpty;
+    DecodeAlert->http_refer = DecodeAlertEmpty;
+    DecodeAlert->smtp_rcpt_to = DecodeAlertEmpty;
+    DecodeAlert->email_from = DecodeAlertEmpty;
+    DecodeAlert->email_to = DecodeAlertEmpty;
+    DecodeAlert->email_cc = DecodeAlertEmpty;
+    DecodeAlert->email_attachment = DecodeAlertEmpty;
+
+    return(DecodeAlert);
+}
 
+/****************************************************************************
+ * Decode_JSON_Alert_Free - Give a _DecodeAlert back to the pool
+ ****************************************************************************/
 
-    /* Base information from JSON */
+void Decode_JSON_Alert_Free( struct _DecodeAlert *DecodeAlert )
+{
 
-    if (json_object_object_get_ex(json_obj, "timestamp", &tmp))
+    if ( DecodeAlert == NULL )
         {
-            Alert_Return_Struct->timestamp = (char *)json_object_get_string(tmp);
-            Convert_ISO8601_For_SQL( Alert_Return_Struct->timestamp, Alert_Return_Struct->converted_timestamp, sizeof( Alert_Return_Struct->converted_timestamp) );
-
+            return;
         }
 
-    if (json_object_object_get_ex(json_obj, "flow_id", &tmp))
-        {
-            Alert_Return_Struct->flowid = (char *)json_object_get_string(tmp);
-        }
+    Arena_Reset(&DecodeAlert->arena);
 
-    if (json_object_object_get_ex(json_obj, "in_iface", &tmp))
-        {
-            Alert_Return_Struct->in_iface = (char *)json_object_get_string(tmp);
-        }
+    pthread_mutex_lock(&DecodeAlertPoolMutex);
 
-    if (json_object_object_get_ex(json_obj, "src_ip", &tmp))
+    if ( DecodeAlertPoolCount < DECODE_ALERT_POOL_MAX )
         {
-            Alert_Return_Struct->src_ip = (char *)json_object_get_string(tmp);
+            DecodeAlert->next = DecodeAlertPool;
+            DecodeAlertPool = DecodeAlert;
+            DecodeAlertPoolCount++;
+            DecodeAlert = NULL;
         }
 
-    if (json_object_object_get_ex(json_obj, "src_port", &tmp))
-        {
-            Alert_Return_Struct->src_port = (char *)json_object_get_string(tmp);
-        }
+    pthread_mutex_unlock(&DecodeAlertPoolMutex);
 
-    if (json_object_object_get_ex(json_obj, "dest_ip", &tmp))
+    if ( DecodeAlert != NULL )
         {
-            Alert_Return_Struct->dest_ip = (char *)json_object_get_string(tmp);
+            Arena_Free(&DecodeAlert->arena);
+            free(DecodeAlert);
         }
 
-    if (json_object_object_get_ex(json_obj, "dest_port", &tmp))
-        {
-            Alert_Return_Struct->dest_port = (char *)json_object_get_string(tmp);
-        }
+}
 
-    if (json_object_object_get_ex(json_obj, "proto", &tmp))
-        {
-            Alert_Return_Struct->proto = (char *)json_object_get_string(tmp);
-        }
+/****************************************************************************
+ * Decode_JSON_Alert_Add - Queue a '"key":value' to be added to the event.
+ * With "quote" the value is a plain string and gets quoted/escaped,
+ * otherwise it is already JSON (an object from a fingerprint,  etc).
+ ****************************************************************************/
 
-    if (json_object_object_get_ex(json_obj, "host", &tmp))
-        {
-            Alert_Return_Struct->host = (char *)json_object_get_string(tmp);
-        }
+void Decode_JSON_Alert_Add( struct _DecodeAlert *DecodeAlert, const char *key, const char *value, bool quote )
+{
 
-    if (json_object_object_get_ex(json_obj, "payload", &tmp))
-        {
-            strlcpy(Alert_Return_Struct->payload, (char *)json_object_get_string(tmp), sizeof(Alert_Return_Struct->payload));
-        }
+    struct _DecodeAlertAdd *Add = NULL;
+
+    size_t len = 0;
+    size_t i = 0;
+    char *p = NULL;
+
+    /* Worst case every byte is a control character (\u00XX) */
+
+    len = strlen(key) + 3 + ( quote == true ? strlen(value) * 6 + 2 : strlen(value) );
+
+    Add = (struct _DecodeAlertAdd *) Arena_Alloc(&DecodeAlert->arena, sizeof(_DecodeAlertAdd) + len + 1);
 
-    if (json_object_object_get_ex(json_obj, "icmp_type", &tmp))
+    p = Add->data;
+
+    *p++ = '"';
+
+    for ( i = 0; key[i] != '\0'; i++ )
         {
-            Alert_Return_Struct->icmp_type = (char *)json_object_get_string(tmp);
+            *p++ = key[i];
         }
 
-    if (json_object_object_get_ex(json_obj, "icmp_code", &tmp))
+    *p++ = '"';
+    *p++ = ':';
+
+    if ( quote == false )
         {
-            Alert_Return_Struct->icmp_code = (char *)json_object_get_string(tmp);
+            memcpy(p, value, strlen(value));
+            p += strlen(value);
         }
-
-    if (json_object_object_get_ex(json_obj, "app_proto", &tmp))
+    else
         {
-            strlcpy(Alert_Return_Struct->app_proto, (char *)json_object_get_string(tmp), sizeof(Alert_Return_Struct->app_proto));
+
+            *p++ = '"';
+
+            for ( i = 0; value[i] != '\0'; i++ )
+                {
+
+                    unsigned char c = (unsigned char)value[i];
+
+                    if ( c == '"' || c == '\\' )
+                        {
+                            *p++ = '\\';
+                            *p++ = c;
+                        }
+
+                    else if ( c < 0x20 )
+                        {
+                            p += snprintf(p, 7, "\\u%04x", c);
+                        }
+
+                    else
+                        {
+                            *p++ = c;
+                        }
+                }
+
+            *p++ = '"';
         }
 
-    if (json_object_object_get_ex(json_obj, "xff", &tmp))
+    *p = '\0';
+
+    Add->len = p - Add->data;
+    Add->next = NULL;
+
+    if ( DecodeAlert->add_tail == NULL )
         {
-            Alert_Return_Struct->xff = (char *)json_object_get_string(tmp);
+            DecodeAlert->add = Add;
         }
-
-    if (json_object_object_get_ex(json_obj, "facility", &tmp))
+    else
         {
-            Alert_Return_Struct->facility = (char *)json_object_get_string(tmp);
+            DecodeAlert->add_tail->next = Add;
         }
 
-    if (json_object_object_get_ex(json_obj, "priority", &tmp))
+    DecodeAlert->add_tail = Add;
+    DecodeAlert->add_len += Add->len + 1;	/* + ',' */
+
+}
+
+/****************************************************************************
+ * Decode_JSON_Alert_Splice - Build new_json_string.  The original line
+ * is kept as is and anything added goes in before its closing brace,  in
+ * one allocation.  With nothing added the original line is used.
+ ****************************************************************************/
+
+void Decode_JSON_Alert_Splice( struct _DecodeAlert *DecodeAlert )
+{
+
+    struct _DecodeAlertAdd *Add = NULL;
+
+    size_t len = 0;
+    size_t i = 0;
+    bool empty = true;
+    char *p = NULL;
+
+    DecodeAlert->new_json_string = DecodeAlert->json;
+
+    if ( DecodeAlert->add == NULL )
         {
-            Alert_Return_Struct->priority = (char *)json_object_get_string(tmp);
+            return;
         }
 
-    if (json_object_object_get_ex(json_obj, "level", &tmp))
+    len = strlen(DecodeAlert->json);
+
+    while ( len > 0 && ( DecodeAlert->json[len-1] == ' ' || DecodeAlert->json[len-1] == '\t' ||
+                         DecodeAlert->json[len-1] == '\r' || DecodeAlert->json[len-1] == '\n' ) )
         {
-            Alert_Return_Struct->level = (char *)json_object_get_string(tmp);
+            len--;
         }
 
-    if (json_object_object_get_ex(json_obj, "program", &tmp))
+    if ( len == 0 || DecodeAlert->json[len-1] != '}' )
         {
-            Alert_Return_Struct->program = (char *)json_object_get_string(tmp);
+            Meer_Log(WARN, "[%s, line %d] Event doesn't end with '}'.  Not adding fields.", __FILE__, __LINE__);
+            return;
         }
 
-    if ( json_object_object_get_ex(json_obj, "normalize", &tmp))
+    len--;
+
+    /* "{}" gets no leading comma */
+
+    for ( i = 0; i < len; i++ )
         {
 
-            if ( (char *)json_object_get_string(tmp) != NULL && Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
+            if ( DecodeAlert->json[i] != '{' && DecodeAlert->json[i] != ' ' && DecodeAlert->json[i] != '\t' )
                 {
-                    Alert_Return_Struct->has_normalize = true;
-                    Alert_Return_Struct->normalize = (char *)json_object_get_string(tmp);
+                    empty = false;
+                    break;
                 }
-
         }
 
-    if ( MeerConfig->bluedot == true )
+    p = (char *) Arena_Alloc(&DecodeAlert->arena, len + DecodeAlert->add_len + 2);
+    DecodeAlert->new_json_string = p;
+
+    memcpy(p, DecodeAlert->json, len);
+    p += len;
+
+    for ( Add = DecodeAlert->add; Add != NULL; Add = Add->next )
         {
 
-            if ( json_object_object_get_ex(json_obj, "bluedot", &tmp))
+            if ( empty == false )
                 {
+                    *p++ = ',';
+                }
 
-                    if ( Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
-                        {
+            memcpy(p, Add->data, Add->len);
+            p += Add->len;
+            empty = false;
+        }
 
-                            MeerCounters->BluedotCount++;
+    *p++ = '}';
+    *p = '\0';
 
-                            Alert_Return_Struct->has_bluedot = true;
-                            Alert_Return_Struct->bluedot = (char *)json_object_get_string(tmp);
+}
 
+/****************************************************************************
+ * Decode_JSON_Alert_Metadata - Index "alert.metadata" once so the outputs
+ * (external,  bluedot,  fingerprint) don't each parse it again.  Every
+ * value of every key becomes a key/value pair.  The strings belong to the
+ * parsed line,  the index to the arena.
+ ****************************************************************************/
 
-                        }
-                }
+typedef struct _DecodeAlertMetadataWalk _DecodeAlertMetadataWalk;
+struct _DecodeAlertMetadataWalk
+{
+    struct _MeerJSON *doc;
+    struct _DecodeAlertMetadata *metadata;	/* NULL while counting */
+    const char *key;
+    uint32_t count;
+};
+
+static void Decode_JSON_Alert_Metadata_Value( const char *key, struct _MeerJSONVal *val, void *data )
+{
+
+    struct _DecodeAlertMetadataWalk *Walk = (struct _DecodeAlertMetadataWalk *)data;
 
+    if ( Walk->metadata != NULL )
+        {
+            Walk->metadata[Walk->count].key = Walk->key;
+            Walk->metadata[Walk->count].value = Meer_JSON_String(Walk->doc, val);
         }
 
+    Walk->count++;
+}
 
-    /* Extract "alert" information */
+static void Decode_JSON_Alert_Metadata_Key( const char *key, struct _MeerJSONVal *val, void *data )
+{
 
-    if (json_object_object_get_ex(json_obj, "alert", &tmp))
+    struct _DecodeAlertMetadataWalk *Walk = (struct _DecodeAlertMetadataWalk *)data;
+
+    Walk->key = key;
+
+    if ( Meer_JSON_Is_Array(val) )
         {
+            Meer_JSON_Foreach(val, Decode_JSON_Alert_Metadata_Value, Walk);
+        }
+    else
+        {
+            Decode_JSON_Alert_Metadata_Value(NULL, val, Walk);
+        }
 
-            has_alert = true;
+}
 
-            json_obj_alert = json_tokener_parse(json_object_get_string(tmp));
+static void Decode_JSON_Alert_Metadata( struct _MeerJSON *doc, struct _MeerJSONVal *val, struct _DecodeAlert *DecodeAlert )
+{
 
-            if (json_object_object_get_ex(json_obj_alert, "action", &tmp_alert))
-                {
-                    strlcpy(Alert_Return_Struct->alert_action, (char *)json_object_get_string(tmp_alert), sizeof(Alert_Return_Struct->alert_action));
-                }
+    struct _DecodeAlertMetadataWalk Walk = { 0 };
 
-            if (json_object_object_get_ex(json_obj_alert, "gid", &tmp_alert))
-                {
-                    strlcpy(Alert_Return_Struct->alert_gid, (char *)json_object_get_string(tmp_alert), sizeof(Alert_Return_Struct->alert_action));
-                }
+    Walk.doc = doc;
 
-            if (json_object_object_get_ex(json_obj_alert, "signature_id", &tmp_alert))
-                {
-                    Alert_Return_Struct->alert_signature_id = atol((char *)json_object_get_string(tmp_alert));
-                }
+    Meer_JSON_Foreach(val, Decode_JSON_Alert_Metadata_Key, &Walk);
 
-            if (json_object_object_get_ex(json_obj_alert, "rev", &tmp_alert))
-                {
-                    Alert_Return_Struct->alert_rev = atol((char *)json_object_get_string(tmp_alert));
-                }
+    if ( Walk.count == 0 )
+        {
+            return;
+        }
 
-            if (json_object_object_get_ex(json_obj_alert, "signature", &tmp_alert))
-                {
-                    strlcpy(Alert_Return_Struct->alert_signature, (char *)json_object_get_string(tmp_alert), sizeof(Alert_Return_Struct->alert_signature));
-                }
+    Walk.metadata = (struct _DecodeAlertMetadata *) Arena_Alloc(&DecodeAlert->arena, Walk.count * sizeof(_DecodeAlertMetadata));
+    Walk.count = 0;
 
-            if (json_object_object_get_ex(json_obj_alert, "category", &tmp_alert))
-                {
-                    strlcpy(Alert_Return_Struct->alert_category, (char *)json_object_get_string(tmp_alert), sizeof(Alert_Return_Struct->alert_category));
-                }
+    Meer_JSON_Foreach(val, Decode_JSON_Alert_Metadata_Key, &Walk);
 
-            if (json_object_object_get_ex(json_obj_alert, "severity", &tmp_alert))
-                {
-                    strlcpy(Alert_Return_Struct->alert_severity, (char *)json_object_get_string(tmp_alert), sizeof(Alert_Return_Struct->alert_severity));
-                }
+    DecodeAlert->metadata = Walk.metadata;
+    DecodeAlert->metadata_count = Walk.count;
+}
 
-            if (json_object_object_get_ex(json_obj_alert, "metadata", &tmp_alert))
-                {
+/****************************************************************************
+ * Decode_JSON_Alert_Metadata_Get - First value of a metadata key,  or NULL
+ ****************************************************************************/
 
-                    strlcpy(Alert_Return_Struct->alert_metadata, (char *)json_object_get_string(tmp_alert), sizeof(Alert_Return_Struct->alert_metadata));
-                    Alert_Return_Struct->alert_has_metadata = true;
-                    MeerCounters->MetadataCount++;
+const char *Decode_JSON_Alert_Metadata_Get( struct _DecodeAlert *DecodeAlert, const char *key )
+{
 
-                }
+    uint32_t i = 0;
 
-            json_object_put(json_obj_alert);
+    for ( i = 0; i < DecodeAlert->metadata_count; i++ )
+        {
 
+            if ( !strcmp( DecodeAlert->metadata[i].key, key ) )
+                {
+                    return( DecodeAlert->metadata[i].value );
+                }
         }
 
-    /* Decode flow data */
+    return(NULL);
+}
+
+/****************************************************************************
+ * Decode_JSON_Alert_Metadata_Has - Does any value of "key" contain "value"?
+ * ("policy" has "security-ips drop",  "meer" has "external",  etc)
+ ****************************************************************************/
+
+bool Decode_JSON_Alert_Metadata_Has( struct _DecodeAlert *DecodeAlert, const char *key, const char *value )
+{
+
+    uint32_t i = 0;
 
-    if ( MeerConfig->flow == true )
+    for ( i = 0; i < DecodeAlert->metadata_count; i++ )
         {
 
-            if ( json_object_object_get_ex(json_obj, "flow", &tmp))
+            if ( DecodeAlert->metadata[i].value != NULL &&
+                    !strcmp( DecodeAlert->metadata[i].key, key ) &&
+                    strstr( DecodeAlert->metadata[i].value, value ) )
                 {
-                    Alert_Return_Struct->has_flow = true;
-
-                    if ( Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
-                        {
+                    return(true);
+                }
+        }
 
-                            MeerCounters->FlowCount++;
+    return(false);
+}
 
-                            json_obj_flow = json_tokener_parse(json_object_get_string(tmp));
+struct _DecodeAlert *Decode_JSON_Alert( struct _MeerJSON *doc, char *json_string )
+{
 
-                            if (json_object_object_get_ex(json_obj_flow, "pkts_toserver", &tmp_flow))
-                                {
-                                    Alert_Return_Struct->flow_pkts_toserver = atol((char *)json_object_get_string(tmp_flow));
-                                }
+    struct _DecodeAlert *Alert_Return_Struct = NULL;
+    struct _MeerJSONVal *json_obj = Meer_JSON_Root(doc);
+    struct _MeerJSONVal *tmp = NULL;
 
-                            if (json_object_object_get_ex(json_obj_flow, "pkts_toclient", &tmp_flow))
-                                {
-                                    Alert_Return_Struct->flow_pkts_toclient = atol((char *)json_object_get_string(tmp_flow));
-                                }
+    struct _MeerJSONVal *tmp_alert = NULL;
+    struct _MeerJSONVal *tmp_field = NULL;
+    struct _MeerJSONVal *json_obj_alert = NULL;
 
-                            if (json_object_object_get_ex(json_obj_flow, "bytes_toserver", &tmp_flow))
-                                {
-                                    Alert_Return_Struct->flow_bytes_toserver = atol((char *)json_object_get_string(tmp_flow));
-                                }
+    const struct _DecodeAlertSection *Section = NULL;
+    const struct _DecodeAlertField *Field = NULL;
+    char *field = NULL;
+    bool *has = NULL;
+    int i = 0;
 
-                            if (json_object_object_get_ex(json_obj_flow, "bytes_toclient", &tmp_flow))
-                                {
-                                    Alert_Return_Struct->flow_bytes_toclient = atol((char *)json_object_get_string(tmp_flow));
-                                }
+    bool has_alert = false;
 
-                            if (json_object_object_get_ex(json_obj_flow, "start", &tmp_flow))
-                                {
-                                    strlcpy(Alert_Return_Struct->flow_start_timestamp, (char *)json_object_get_string(tmp_flow), sizeof(Alert_Return_Struct->flow_start_timestamp));
+    char new_ip[64];
 
-                                    Convert_ISO8601_For_SQL( Alert_Return_Struct->flow_start_timestamp, Alert_Return_Struct->flow_start_timestamp_converted, sizeof( Alert_Return_Struct->flow_start_timestamp_converted) );
-                                }
+    Alert_Return_Struct = Decode_JSON_Alert_Get();
 
-                            json_object_put(json_obj_flow);
+    Alert_Return_Struct->json = json_string;
+    Remove_Return(Alert_Return_Struct->json);
 
-                        }
-                }
+    Alert_Return_Struct->event_type = "alert";
+    Alert_Return_Struct->ip_version = 4;
 
-        }
+    /* Base information from JSON */
 
-    if ( MeerConfig->http == true && !strcmp( Alert_Return_Struct->app_proto, "http" ))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "timestamp") ) != NULL )
         {
+            Alert_Return_Struct->timestamp = Meer_JSON_String(doc, tmp);
+            Convert_ISO8601( Alert_Return_Struct->timestamp, &Alert_Return_Struct->epoch, &Alert_Return_Struct->usec, Alert_Return_Struct->converted_timestamp, sizeof( Alert_Return_Struct->converted_timestamp) );
 
-            if ( json_object_object_get_ex(json_obj, "http", &tmp))
-                {
-
-                    Alert_Return_Struct->has_http = true;
+        }
 
-                    if ( Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
-                        {
+    if ( ( tmp = Meer_JSON_Get(json_obj, "flow_id") ) != NULL )
+        {
+            Alert_Return_Struct->flowid = Meer_JSON_String(doc, tmp);
+        }
 
-                            MeerCounters->HTTPCount++;
-
-                            json_obj_http = json_tokener_parse(json_object_get_string(tmp));
-
-                            if (json_object_object_get_ex(json_obj_http, "hostname", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_hostname, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_hostname));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "url", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_url, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_url));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "http_content_type", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_content_type, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_content_type));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "http_method", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_method, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_method));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "http_user_agent", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_user_agent, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_user_agent));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "http_refer", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_refer, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_refer));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "protocol", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_protocol, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_protocol));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "xff", &tmp_http))
-                                {
-                                    strlcpy(Alert_Return_Struct->http_xff, (char *)json_object_get_string(tmp_http), sizeof(Alert_Return_Struct->http_xff));
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "status", &tmp_http))
-                                {
-                                    Alert_Return_Struct->http_status = atoi( (char *)json_object_get_string(tmp_http) );
-                                }
-
-                            if (json_object_object_get_ex(json_obj_http, "length", &tmp_http))
-                                {
-                                    Alert_Return_Struct->http_length = atol( (char *)json_object_get_string(tmp_http) );
-                                }
-
-                            json_object_put(json_obj_http);
-                        }
-                }
+    if ( ( tmp = Meer_JSON_Get(json_obj, "in_iface") ) != NULL )
+        {
+            Alert_Return_Struct->in_iface = Meer_JSON_String(doc, tmp);
+        }
 
+    if ( ( tmp = Meer_JSON_Get(json_obj, "src_ip") ) != NULL )
+        {
+            Alert_Return_Struct->src_ip = Meer_JSON_String(doc, tmp);
         }
 
-    /* Proto is still "smtp",  email is a secondary part */
+    if ( ( tmp = Meer_JSON_Get(json_obj, "src_port") ) != NULL )
+        {
+            Alert_Return_Struct->src_port = Meer_JSON_String(doc, tmp);
+        }
 
-    if ( MeerConfig->email == true && !strcmp( Alert_Return_Struct->app_proto, "smtp" ))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "dest_ip") ) != NULL )
         {
+            Alert_Return_Struct->dest_ip = Meer_JSON_String(doc, tmp);
+        }
 
-            Alert_Return_Struct->has_email = true;
+    if ( ( tmp = Meer_JSON_Get(json_obj, "dest_port") ) != NULL )
+        {
+            Alert_Return_Struct->dest_port = Meer_JSON_String(doc, tmp);
+        }
 
-            if ( json_object_object_get_ex(json_obj, "email", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "proto") ) != NULL )
+        {
+            Alert_Return_Struct->proto = Meer_JSON_String(doc, tmp);
+        }
 
-                if ( Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
-                    {
+    if ( ( tmp = Meer_JSON_Get(json_obj, "host") ) != NULL )
+        {
+            Alert_Return_Struct->host = Meer_JSON_String(doc, tmp);
+        }
 
-                        MeerCounters->EmailCount++;
+    if ( ( tmp = Meer_JSON_Get(json_obj, "payload") ) != NULL )
+        {
+            Alert_Return_Struct->payload = Meer_JSON_String(doc, tmp);
+        }
 
-                        json_obj_email = json_tokener_parse(json_object_get_string(tmp));
+    if ( ( tmp = Meer_JSON_Get(json_obj, "icmp_type") ) != NULL )
+        {
+            Alert_Return_Struct->icmp_type = Meer_JSON_String(doc, tmp);
+        }
 
-                        if (json_object_object_get_ex(json_obj_email, "status", &tmp_email))
-                            {
-                                strlcpy(Alert_Return_Struct->email_status, (char *)json_object_get_string(tmp_email), sizeof(Alert_Return_Struct->email_status));
-                            }
+    if ( ( tmp = Meer_JSON_Get(json_obj, "icmp_code") ) != NULL )
+        {
+            Alert_Return_Struct->icmp_code = Meer_JSON_String(doc, tmp);
+        }
 
-                        if (json_object_object_get_ex(json_obj_email, "from", &tmp_email))
-                            {
-                                strlcpy(Alert_Return_Struct->email_from, (char *)json_object_get_string(tmp_email), sizeof(Alert_Return_Struct->email_from));
-                            }
+    if ( ( tmp = Meer_JSON_Get(json_obj, "app_proto") ) != NULL )
+        {
+            strlcpy(Alert_Return_Struct->app_proto, Meer_JSON_String(doc, tmp), sizeof(Alert_Return_Struct->app_proto));
+        }
 
-                        if (json_object_object_get_ex(json_obj_email, "to", &tmp_email))
-                            {
-                                strlcpy(Alert_Return_Struct->email_to, (char *)json_object_get_string(tmp_email), sizeof(Alert_Return_Struct->email_to));
-                            }
+    if ( ( tmp = Meer_JSON_Get(json_obj, "xff") ) != NULL )
+        {
+            Alert_Return_Struct->xff = Meer_JSON_String(doc, tmp);
+        }
 
-                        if (json_object_object_get_ex(json_obj_email, "attachment", &tmp_email))
-                            {
-                                strlcpy(Alert_Return_Struct->email_attachment, (char *)json_object_get_string(tmp_email), sizeof(Alert_Return_Struct->email_attachment));
-                            }
+    if ( ( tmp = Meer_JSON_Get(json_obj, "facility") ) != NULL )
+        {
+            Alert_Return_Struct->facility = Meer_JSON_String(doc, tmp);
+        }
 
-                        json_object_put(json_obj_email);
-                    }
+    if ( ( tmp = Meer_JSON_Get(json_obj, "priority") ) != NULL )
+        {
+            Alert_Return_Struct->priority = Meer_JSON_String(doc, tmp);
+        }
 
+    if ( ( tmp = Meer_JSON_Get(json_obj, "level") ) != NULL )
+        {
+            Alert_Return_Struct->level = Meer_JSON_String(doc, tmp);
         }
 
-    if ( MeerConfig->smtp == true && !strcmp( Alert_Return_Struct->app_proto, "smtp" ))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "program") ) != NULL )
         {
+            Alert_Return_Struct->program = Meer_JSON_String(doc, tmp);
+        }
 
-            Alert_Return_Struct->has_smtp = true;
+    if ( ( tmp = Meer_JSON_Get(json_obj, "normalize") ) != NULL )
+        {
 
-            if ( json_object_object_get_ex(json_obj, "smtp", &tmp))
+            if ( Meer_JSON_Is_Object(tmp) )
+                {
+                    Alert_Return_Struct->has_normalize = true;
+                    Alert_Return_Struct->normalize = Meer_JSON_String(doc, tmp);
+                }
 
-                if ( Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
-                    {
+        }
 
-                        MeerCounters->SMTPCount++;
+    if ( MeerConfig->bluedot == true )
+        {
 
-                        json_obj_smtp = json_tokener_parse(json_object_get_string(tmp));
+            if ( ( tmp = Meer_JSON_Get(json_obj, "bluedot") ) != NULL )
+                {
 
-                        if (json_object_object_get_ex(json_obj_smtp, "helo", &tmp_smtp))
-                            {
-                                strlcpy(Alert_Return_Struct->smtp_helo, (char *)json_object_get_string(tmp_smtp), sizeof(Alert_Return_Struct->smtp_helo));
-                            }
+                    if ( Meer_JSON_Is_Object(tmp) )
+                        {
 
-                        if (json_object_object_get_ex(json_obj_smtp, "mail_from", &tmp_smtp))
-                            {
-                                strlcpy(Alert_Return_Struct->smtp_mail_from, (char *)json_object_get_string(tmp_smtp), sizeof(Alert_Return_Struct->smtp_mail_from));
-                            }
+                            __sync_fetch_and_add(&MeerCounters->BluedotCount, 1);
 
-                        if (json_object_object_get_ex(json_obj_smtp, "rcpt_to", &tmp_smtp))
-                            {
-                                strlcpy(Alert_Return_Struct->smtp_rcpt_to, (char *)json_object_get_string(tmp_smtp), sizeof(Alert_Return_Struct->smtp_rcpt_to));
-                            }
+                            Alert_Return_Struct->has_bluedot = true;
+                            Alert_Return_Struct->bluedot = Meer_JSON_String(doc, tmp);
 
-                        json_object_put(json_obj_smtp);
-                    }
 
+                        }
+                }
 
         }
 
-    if ( MeerConfig->tls == true && !strcmp( Alert_Return_Struct->app_proto, "tls" ))
-        {
-
-            Alert_Return_Struct->has_tls = true;
 
-            if ( json_object_object_get_ex(json_obj, "tls", &tmp))
-                {
-
-                    if ( Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
-                        {
+    /* Extract "alert" information */
 
-                            MeerCounters->TLSCount++;
+    if ( ( tmp = Meer_JSON_Get(json_obj, "alert") ) != NULL )
+        {
 
-                            json_obj_tls = json_tokener_parse(json_object_get_string(tmp));
+            has_alert = true;
 
-                            if (json_object_object_get_ex(json_obj_tls, "session_resumed", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_session_resumed, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_session_resumed));
-                                }
+            json_obj_alert = tmp;
 
-                            if (json_object_object_get_ex(json_obj_tls, "sni", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_sni, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_sni));
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "action") ) != NULL )
+                {
+                    strlcpy(Alert_Return_Struct->alert_action, Meer_JSON_String(doc, tmp_alert), sizeof(Alert_Return_Struct->alert_action));
+                }
 
-                            if (json_object_object_get_ex(json_obj_tls, "version", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_version, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_version));
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "gid") ) != NULL )
+                {
+                    strlcpy(Alert_Return_Struct->alert_gid, Meer_JSON_String(doc, tmp_alert), sizeof(Alert_Return_Struct->alert_action));
+                }
 
-                            if (json_object_object_get_ex(json_obj_tls, "subject", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_subject, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_subject));
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "signature_id") ) != NULL )
+                {
+                    Alert_Return_Struct->alert_signature_id = atol(Meer_JSON_String(doc, tmp_alert));
+                }
 
-                            if (json_object_object_get_ex(json_obj_tls, "issuerdn", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_issuerdn, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_issuerdn));
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "rev") ) != NULL )
+                {
+                    Alert_Return_Struct->alert_rev = atol(Meer_JSON_String(doc, tmp_alert));
+                }
 
-                            if (json_object_object_get_ex(json_obj_tls, "notbefore", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_notbefore, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_notbefore));
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "signature") ) != NULL )
+                {
+                    strlcpy(Alert_Return_Struct->alert_signature, Meer_JSON_String(doc, tmp_alert), sizeof(Alert_Return_Struct->alert_signature));
+                }
 
-                            if (json_object_object_get_ex(json_obj_tls, "notafter", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_notafter, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_notafter));
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "category") ) != NULL )
+                {
+                    strlcpy(Alert_Return_Struct->alert_category, Meer_JSON_String(doc, tmp_alert), sizeof(Alert_Return_Struct->alert_category));
+                }
 
-                            if (json_object_object_get_ex(json_obj_tls, "fingerprint", &tmp_tls))
-                                {
-                                    strlcpy(Alert_Return_Struct->tls_fingerprint, (char *)json_object_get_string(tmp_tls), sizeof(Alert_Return_Struct->tls_fingerprint));
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "severity") ) != NULL )
+                {
+                    strlcpy(Alert_Return_Struct->alert_severity, Meer_JSON_String(doc, tmp_alert), sizeof(Alert_Return_Struct->alert_severity));
+                }
 
-                            if (json_object_object_get_ex(json_obj_tls, "serial", &tmp_tls))
-                                {
-                                    Alert_Return_Struct->tls_serial = atoi( (char *)json_object_get_string(tmp_tls) );
-                                }
+            if ( ( tmp_alert = Meer_JSON_Get(json_obj_alert, "metadata") ) != NULL )
+                {
 
-                            json_object_put(json_obj_tls);
+                    Alert_Return_Struct->alert_metadata = Meer_JSON_String(doc, tmp_alert);
+                    Alert_Return_Struct->alert_has_metadata = true;
+                    Decode_JSON_Alert_Metadata( doc, tmp_alert, Alert_Return_Struct );
+                    __sync_fetch_and_add(&MeerCounters->MetadataCount, 1);
 
-                        }
                 }
 
         }
 
-    if ( MeerConfig->ssh == true && !strcmp( Alert_Return_Struct->app_proto, "ssh" ))
-        {
+    /* Protocol data (flow,  http,  etc),  only what the outputs use */
 
-            if ( json_object_object_get_ex(json_obj, "ssh", &tmp))
-                {
+    for ( i = 0; i < DecodeAlertPlanCount; i++ )
+        {
 
-                    if ( Validate_JSON_String( (char *)json_object_get_string(tmp) ) == 0 )
-                        {
+            Section = DecodeAlertPlan[i];
 
-                            MeerCounters->SSHCount++;
+            if ( Section->app_proto != NULL && strcmp( Alert_Return_Struct->app_proto, Section->app_proto ) )
+                {
+                    continue;
+                }
 
-                            json_obj_ssh_server = json_tokener_parse(json_object_get_string(tmp));
+            has = (bool *)( (char *)Alert_Return_Struct + Section->has );
 
-                            if ( json_object_object_get_ex(json_obj_ssh_server, "server", &tmp_ssh_server))
-                                {
+            if ( Section->has_on_proto == true )
+                {
+                    *has = true;
+                }
 
-                                    Alert_Return_Struct->has_ssh_server = true;
+            if ( ( tmp = Meer_JSON_Get(json_obj, Section->key) ) == NULL )
+                {
+                    continue;
+                }
 
-                                    if ( Validate_JSON_String( (char *)json_object_get_string(tmp_ssh_server) ) == 0 )
-                                        {
+            if ( Section->has_on_proto == false && Section->sub == NULL )
+                {
+                    *has = true;
+                }
 
-                                            tmp_ssh_server_2 = json_tokener_parse(json_object_get_string(tmp_ssh_server));
+            if ( !Meer_JSON_Is_Object(tmp) )
+                {
+                    continue;
+                }
 
-                                            if ( json_object_object_get_ex(tmp_ssh_server_2, "proto_version", &tmp_ssh_server_3))
-                                                {
+            if ( Section->count == true )
+                {
+                    __sync_fetch_and_add( (uint64_t *)( (char *)MeerCounters + Section->counter ), 1);
+                }
 
-                                                    strlcpy(Alert_Return_Struct->ssh_server_proto_version, (char *)json_object_get_string(tmp_ssh_server_3), sizeof(Alert_Return_Struct->ssh_server_proto_version));
-                                                }
+            if ( Section->sub != NULL )
+                {
 
-                                            if ( json_object_object_get_ex(tmp_ssh_server_2, "software_version", &tmp_ssh_server_3))
-                                                {
+                    if ( ( tmp = Meer_JSON_Get(tmp, Section->sub) ) == NULL )
+                        {
+                            continue;
+                        }
 
-                                                    strlcpy(Alert_Return_Struct->ssh_server_software_version, (char *)json_object_get_string(tmp_ssh_server_3), sizeof(Alert_Return_Struct->ssh_server_software_version));
-                                                }
+                    *has = true;
 
-                                            json_object_put(tmp_ssh_server_2);
-                                        }
-                                }
+                    if ( !Meer_JSON_Is_Object(tmp) )
+                        {
+                            continue;
+                        }
+                }
 
-                            if ( json_object_object_get_ex(json_obj_ssh_client, "client", &tmp_ssh_client))
-                                {
+            for ( Field = Section->fields; Field->key != NULL; Field++ )
+                {
 
-                                    Alert_Return_Struct->has_ssh_client = true;
+                    if ( ( tmp_field = Meer_JSON_Get(tmp, Field->key) ) == NULL )
+                        {
+                            continue;
+                        }
 
-                                    if ( Validate_JSON_String( (char *)json_object_get_string(tmp_ssh_client) ) == 0 )
-                                        {
+                    field = (char *)Alert_Return_Struct + Field->offset;
 
-                                            tmp_ssh_client_2 = json_tokener_parse(json_object_get_string(tmp_ssh_client));
+                    switch ( Field->type )
+                        {
 
-                                            if ( json_object_object_get_ex(tmp_ssh_client_2, "proto_version", &tmp_ssh_client_3))
-                                                {
+                        case DECODE_FIELD_STRING:
+                            strlcpy(field, Meer_JSON_String(doc, tmp_field), Field->size);
+                            break;
 
-                                                    strlcpy(Alert_Return_Struct->ssh_client_proto_version, (char *)json_object_get_string(tmp_ssh_client_3), sizeof(Alert_Return_Struct->ssh_client_proto_version));
-                                                }
+                        case DECODE_FIELD_REF:
+                            *(char **)field = Meer_JSON_String(doc, tmp_field);
+                            break;
 
-                                            if ( json_object_object_get_ex(tmp_ssh_client_2, "software_version", &tmp_ssh_client_3))
-                                                {
+                        case DECODE_FIELD_UINT64:
+                            *(uint64_t *)field = atol( Meer_JSON_String(doc, tmp_field) );
+                            break;
 
-                                                    strlcpy(Alert_Return_Struct->ssh_client_software_version, (char *)json_object_get_string(tmp_ssh_client_3), sizeof(Alert_Return_Struct->ssh_client_software_version));
-                                                }
+                        case DECODE_FIELD_UINT32:
+                            *(uint32_t *)field = atoi( Meer_JSON_String(doc, tmp_field) );
+                            break;
 
-                                            json_object_put(tmp_ssh_client_2);
-                                        }
-                                }
+                        case DECODE_FIELD_INT:
+                            *(int *)field = atoi( Meer_JSON_String(doc, tmp_field) );
+                            break;
 
-                            json_object_put(json_obj_ssh_server);
                         }
                 }
         }
 
+    if ( Alert_Return_Struct->flow_start_timestamp[0] != '\0' )
+        {
+            Convert_ISO8601( Alert_Return_Struct->flow_start_timestamp, NULL, NULL, Alert_Return_Struct->flow_start_timestamp_converted, sizeof( Alert_Return_Struct->flow_start_timestamp_converted) );
+        }
+
     /* Check the basic information first */
 
     if ( Alert_Return_Struct->timestamp == NULL )
@@ -739,38 +936,44 @@ struct _DecodeAlert *Decode_JSON_Alert( struct json_object *json_obj, char *json
             Meer_Log(ERROR, "JSON: \"%s\" : No dest_ip found in flowid %s. Abort.", json_string, Alert_Return_Struct->flowid);
         }
 
-    if ( !Is_IP(Alert_Return_Struct->src_ip, IPv4) && !Is_IP(Alert_Return_Struct->src_ip, IPv6 ) )
+    /* Parse the addresses once,  everything after uses the "_bit" copies */
+
+    if ( ( Alert_Return_Struct->ip_version = IP_Parse(Alert_Return_Struct->src_ip, Alert_Return_Struct->src_ip_bit) ) == 0 )
         {
             Meer_Log(WARN, "JSON: \"%s\" : Invalid src_ip found in flowid %s. Attempting to 'fix'.", json_string, Alert_Return_Struct->flowid);
 
             if ( Try_And_Fix_IP( Alert_Return_Struct->src_ip, new_ip, sizeof( new_ip )) == true )
                 {
-                    strlcpy(Alert_Return_Struct->src_ip, new_ip, sizeof( Alert_Return_Struct->src_ip ));
+                    Alert_Return_Struct->src_ip = Arena_Strdup(&Alert_Return_Struct->arena, new_ip);
                 }
             else
                 {
                     Meer_Log(WARN, "Unable to find a usable source IP address for flowid %s. Using %s (BAD_IP) instead.", Alert_Return_Struct->flowid, BAD_IP);
-                    strlcpy(Alert_Return_Struct->src_ip, BAD_IP, sizeof( Alert_Return_Struct->src_ip ));
+                    Alert_Return_Struct->src_ip = Arena_Strdup(&Alert_Return_Struct->arena, BAD_IP);
                 }
 
+            Alert_Return_Struct->ip_version = IP_Parse(Alert_Return_Struct->src_ip, Alert_Return_Struct->src_ip_bit);
+
         }
 
-    if ( !Is_IP(Alert_Return_Struct->dest_ip, IPv4) && !Is_IP(Alert_Return_Struct->dest_ip, IPv6 ) )
+    if ( IP_Parse(Alert_Return_Struct->dest_ip, Alert_Return_Struct->dest_ip_bit) == 0 )
         {
             Meer_Log(WARN, "JSON: \"%s\" : Invalid dest_ip found in flowid %s. Attempting to 'fix'.", json_string, Alert_Return_Struct->flowid);
 
             if ( Try_And_Fix_IP( Alert_Return_Struct->dest_ip, new_ip, sizeof( new_ip )) == true )
                 {
-                    strlcpy(Alert_Return_Struct->dest_ip, new_ip, sizeof( new_ip ));
+                    Alert_Return_Struct->dest_ip = Arena_Strdup(&Alert_Return_Struct->arena, new_ip);
                 }
             else
                 {
 
                     Meer_Log(WARN, "Unable to find a usable destination IP address for flowid %s. Using %s (BAD_IP) instead.", Alert_Return_Struct->flowid, BAD_IP);
-                    strlcpy(Alert_Return_Struct->dest_ip, BAD_IP, sizeof( Alert_Return_Struct->dest_ip ));
+                    Alert_Return_Struct->dest_ip = Arena_Strdup(&Alert_Return_Struct->arena, BAD_IP);
 
                 }
 
+            IP_Parse(Alert_Return_Struct->dest_ip, Alert_Return_Struct->dest_ip_bit);
+
         }
 
     if ( Alert_Return_Struct->proto == NULL )
@@ -781,7 +984,7 @@ struct _DecodeAlert *Decode_JSON_Alert( struct json_object *json_obj, char *json
 
     if ( Alert_Return_Struct->payload[0] == '\0' )
         {
-            strlcpy(Alert_Return_Struct->payload, "No payload recorded by Meer", sizeof(Alert_Return_Struct->payload));
+            Alert_Return_Struct->payload = "No payload recorded by Meer";
         }
 
     /* Do we have all the alert information we'd expect */
@@ -838,8 +1041,7 @@ struct _DecodeAlert *Decode_JSON_Alert( struct json_object *json_obj, char *json
 
             if ( Alert_Return_Struct->src_dns[0] != '\0' )
                 {
-                    json_object *jsrc_dns = json_object_new_string(Alert_Return_Struct->src_dns);
-                    json_object_object_add(json_obj,"src_dns", jsrc_dns);
+                    Decode_JSON_Alert_Add( Alert_Return_Struct, "src_dns", Alert_Return_Struct->src_dns, true );
                 }
 
 
@@ -847,22 +1049,18 @@ struct _DecodeAlert *Decode_JSON_Alert( struct json_object *json_obj, char *json
 
             if ( Alert_Return_Struct->dest_dns[0] != '\0' )
                 {
-                    json_object *jdest_dns = json_object_new_string(Alert_Return_Struct->dest_dns);
-                    json_object_object_add(json_obj,"dest_dns", jdest_dns);
+                    Decode_JSON_Alert_Add( Alert_Return_Struct, "dest_dns", Alert_Return_Struct->dest_dns, true );
                 }
 
         }
 
-    if ( Is_IP(Alert_Return_Struct->src_ip, IPv6) != 0 )
-        {
-            Alert_Return_Struct->ip_version = 6;
-        }
-
-    // Fingerprint enabled?
+    /* Health,  external,  bluedot,  etc.  Only worked out the first time
+       we see a signature */
 
-    /* Decode the JSON (we might have added some fields like DNS, etc */
+    Alert_Return_Struct->Sig = SID_Cache_Get( Alert_Return_Struct );
 
-    strlcpy(Alert_Return_Struct->new_json_string, json_object_to_json_string(json_obj), sizeof(Alert_Return_Struct->new_json_string));
+    /* new_json_string is built by Decode_JSON_Alert_Splice() once
+       everything that wants to add to the event has */
 
     return(Alert_Return_Struct);
 }
@@ -30,8 +30,34 @@
 libjson-c is required for Meer to function!
 #endif
 
+#include "meer-json.h"
+#include "util-arena.h"
+
 #include "meer-def.h"
 
+/* Variable length fields (payload,  metadata,  URLs,  etc) point into the
+   parsed JSON,  so they are only good until Free_JSON().  They are never
+   NULL,  missing ones are "". */
+
+/* A '"key":value' to splice onto the end of the event */
+
+typedef struct _DecodeAlertAdd _DecodeAlertAdd;
+struct _DecodeAlertAdd
+{
+    struct _DecodeAlertAdd *next;
+    size_t len;
+    char data[];
+};
+
+/* One "alert.metadata" value.  "policy": [ "a", "b" ] is two of these */
+
+typedef struct _DecodeAlertMetadata _DecodeAlertMetadata;
+struct _DecodeAlertMetadata
+{
+    const char *key;
+    const char *value;
+};
+
 typedef struct _DecodeAlert _DecodeAlert;
 struct _DecodeAlert
 {
@@ -42,20 +68,24 @@ char *in_iface;
 char *event_type;
 
 char *src_ip;
+unsigned char src_ip_bit[MAXIPBIT];	/* From IP_Parse() */
 char *src_port;
 char src_dns[256];
 
     char converted_timestamp[64];
+    uint64_t epoch;			/* "timestamp" */
+    uint32_t usec;
 
-    char new_json_string[PACKET_BUFFER_SIZE_DEFAULT];
+    char *new_json_string;
 
     char *dest_ip;
+    unsigned char dest_ip_bit[MAXIPBIT];
     char *dest_port;
     char dest_dns[256];
 
     char *proto;
     char app_proto[16];
-    char payload[131072];
+    char *payload;
     char *stream;
     char *packet;
     char *host;
@@ -92,7 +122,11 @@ char src_dns[256];
     char alert_category[128];
     char alert_severity[5];
 
-    char alert_metadata[1024];
+    char *alert_metadata;
+    struct _DecodeAlertMetadata *metadata;	/* Index of alert_metadata */
+    uint32_t metadata_count;
+
+    struct _SID_Cache *Sig;		/* Per-signature decisions (sid-cache.c) */
     bool alert_has_metadata;
 
     /* Bluedot data */
@@ -115,11 +149,11 @@ char src_dns[256];
     bool     has_http;
 
     char http_hostname[256];
-    char http_url[2100];
+    char *http_url;
     char http_content_type[64];
     char http_method[32];
-    char http_user_agent[16384];
-    char http_refer[4096];
+    char *http_user_agent;
+    char *http_refer;
     char http_protocol[32];
     char http_xff[128];
     int  http_status;
@@ -160,20 +194,64 @@ char src_dns[256];
 
     char smtp_helo[255];
     char smtp_mail_from[255];
-    char smtp_rcpt_to[131072];
+    char *smtp_rcpt_to;
 
     /* Email */
 
     bool has_email;
 
     char email_status[32];
-    char email_from[1024];
-    char email_to[10240];
-    char email_cc[10240];
-    char email_attachment[10240];
+    char *email_from;
+    char *email_to;
+    char *email_cc;
+    char *email_attachment;
+
+    /* Fields Meer adds to the event (DNS,  fingerprints).  They are
+       spliced onto the original line by Decode_JSON_Alert_Splice() */
+
+    struct _DecodeAlertAdd *add;
+    struct _DecodeAlertAdd *add_tail;
+    size_t add_len;
+
+    /* Strings Meer builds for this alert (new_json_string,  added
+       fields,  etc).  Kept with the record when it goes back to the
+       pool. */
+
+    struct _MeerArena arena;
+    struct _DecodeAlert *next;		/* Free list */
 
 };
 
 
-struct _DecodeAlert *Decode_JSON_Alert( struct json_object *json_obj, char *json_string );
+/* One field of a protocol section ("http",  "tls",  etc) and where it goes */
+
+typedef struct _DecodeAlertField _DecodeAlertField;
+struct _DecodeAlertField
+{
+    const char *key;
+    size_t offset;			/* In _DecodeAlert */
+    size_t size;
+    unsigned char type;			/* DECODE_FIELD_* */
+};
+
+typedef struct _DecodeAlertSection _DecodeAlertSection;
+struct _DecodeAlertSection
+{
+    const char *key;			/* "http",  "tls",  etc */
+    const char *sub;			/* Object inside "key" ("ssh" -> "server") */
+    const char *app_proto;		/* Only when app_proto is this */
+    size_t has;				/* has_* flag in _DecodeAlert */
+    bool has_on_proto;			/* has_* goes up on app_proto alone */
+    bool count;
+    size_t counter;			/* In _MeerCounters */
+    const struct _DecodeAlertField *fields;
+};
+
+void Decode_JSON_Alert_Init( void );
+void Decode_JSON_Alert_Free( struct _DecodeAlert *DecodeAlert );
+void Decode_JSON_Alert_Add( struct _DecodeAlert *DecodeAlert, const char *key, const char *value, bool quote );
+void Decode_JSON_Alert_Splice( struct _DecodeAlert *DecodeAlert );
+const char *Decode_JSON_Alert_Metadata_Get( struct _DecodeAlert *DecodeAlert, const char *key );
+bool Decode_JSON_Alert_Metadata_Has( struct _DecodeAlert *DecodeAlert, const char *key, const char *value );
+struct _DecodeAlert *Decode_JSON_Alert( struct _MeerJSON *doc, char *json_string );
 
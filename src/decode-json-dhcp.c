@@ -42,20 +42,20 @@ libjson-c is required for Meer to function!
 #include "util.h"
 #include "meer.h"
 #include "meer-def.h"
+#include "meer-json.h"
 
 #include "decode-json-dhcp.h"
 
 struct _MeerCounters *MeerCounters;
 struct _MeerConfig *MeerConfig;
 
-void Decode_JSON_DHCP( struct json_object *json_obj, char *json_string, struct _DecodeDHCP *DecodeDHCP )
+void Decode_JSON_DHCP( struct _MeerJSON *doc, char *json_string, struct _DecodeDHCP *DecodeDHCP )
 {
 
-    struct json_object *tmp = NULL;
-    struct json_object *json_obj_dhcp = NULL;
-    struct json_object *tmp_dhcp = NULL;
-
-    char *dhcp = NULL;
+    struct _MeerJSONVal *json_obj = Meer_JSON_Root(doc);
+    struct _MeerJSONVal *tmp = NULL;
+    struct _MeerJSONVal *json_obj_dhcp = NULL;
+    struct _MeerJSONVal *tmp_dhcp = NULL;
 
     DecodeDHCP->timestamp = NULL;
     DecodeDHCP->flowid = NULL;
@@ -66,75 +66,73 @@ void Decode_JSON_DHCP( struct json_object *json_obj, char *json_string, struct _
     DecodeDHCP->dest_port = NULL;
     DecodeDHCP->proto = NULL;
 
-    if (json_object_object_get_ex(json_obj, "timestamp", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "timestamp") ) != NULL )
         {
-            DecodeDHCP->timestamp = (char *)json_object_get_string(tmp);
+            DecodeDHCP->timestamp = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "flow_id", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "flow_id") ) != NULL )
         {
-            DecodeDHCP->flowid = (char *)json_object_get_string(tmp);
+            DecodeDHCP->flowid = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "in_iface", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "in_iface") ) != NULL )
         {
-            DecodeDHCP->in_iface = (char *)json_object_get_string(tmp);
+            DecodeDHCP->in_iface = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "src_ip", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "src_ip") ) != NULL )
         {
-            DecodeDHCP->src_ip = (char *)json_object_get_string(tmp);
+            DecodeDHCP->src_ip = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "src_port", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "src_port") ) != NULL )
         {
-            DecodeDHCP->src_port = (char *)json_object_get_string(tmp);
+            DecodeDHCP->src_port = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "dest_ip", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "dest_ip") ) != NULL )
         {
-            DecodeDHCP->dest_ip = (char *)json_object_get_string(tmp);
+            DecodeDHCP->dest_ip = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "dest_port", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "dest_port") ) != NULL )
         {
-            DecodeDHCP->dest_port = (char *)json_object_get_string(tmp);
+            DecodeDHCP->dest_port = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "proto", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "proto") ) != NULL )
         {
-            DecodeDHCP->proto = (char *)json_object_get_string(tmp);
+            DecodeDHCP->proto = Meer_JSON_String(doc, tmp);
         }
 
-    if (json_object_object_get_ex(json_obj, "dhcp", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "dhcp") ) != NULL )
         {
 
-            dhcp = (char *)json_object_get_string(tmp);
-
-            if ( Validate_JSON_String( dhcp ) == 0 )
+            if ( Meer_JSON_Is_Object(tmp) )
                 {
 
-                    json_obj_dhcp = json_tokener_parse(dhcp);
+                    json_obj_dhcp = tmp;
 
-                    if (json_object_object_get_ex(json_obj_dhcp, "type", &tmp_dhcp))
+                    if ( ( tmp_dhcp = Meer_JSON_Get(json_obj_dhcp, "type") ) != NULL )
                         {
-                            strlcpy(DecodeDHCP->dhcp_type, (char *)json_object_get_string(tmp_dhcp), sizeof(DecodeDHCP->dhcp_type));
+                            strlcpy(DecodeDHCP->dhcp_type, Meer_JSON_String(doc, tmp_dhcp), sizeof(DecodeDHCP->dhcp_type));
                         }
 
-                    if (json_object_object_get_ex(json_obj_dhcp, "id", &tmp_dhcp))
+                    if ( ( tmp_dhcp = Meer_JSON_Get(json_obj_dhcp, "id") ) != NULL )
                         {
-                            strlcpy(DecodeDHCP->dhcp_id, (char *)json_object_get_string(tmp_dhcp), sizeof(DecodeDHCP->dhcp_id));
+                            strlcpy(DecodeDHCP->dhcp_id, Meer_JSON_String(doc, tmp_dhcp), sizeof(DecodeDHCP->dhcp_id));
                         }
 
-                    if (json_object_object_get_ex(json_obj_dhcp, "client_mac", &tmp_dhcp))
+                    if ( ( tmp_dhcp = Meer_JSON_Get(json_obj_dhcp, "client_mac") ) != NULL )
                         {
-                            strlcpy(DecodeDHCP->dhcp_client_mac, (char *)json_object_get_string(tmp_dhcp), sizeof(DecodeDHCP->dhcp_client_mac));
+                            strlcpy(DecodeDHCP->dhcp_client_mac, Meer_JSON_String(doc, tmp_dhcp), sizeof(DecodeDHCP->dhcp_client_mac));
                         }
 
-                    if (json_object_object_get_ex(json_obj_dhcp, "assigned_ip", &tmp_dhcp))
+                    if ( ( tmp_dhcp = Meer_JSON_Get(json_obj_dhcp, "assigned_ip") ) != NULL )
                         {
 
-                            char *assigned_ip = (char *)json_object_get_string(tmp_dhcp);
+                            char *assigned_ip = Meer_JSON_String(doc, tmp_dhcp);
 
                             /* 0.0.0.0 is no good, try to avoid it */
 
@@ -150,11 +148,9 @@ void Decode_JSON_DHCP( struct json_object *json_obj, char *json_string, struct _
 
         }
 
-    if ( dhcp == NULL )
+    if ( json_obj_dhcp == NULL )
         {
             Meer_Log(WARN, "[%s, line %d] Got event_type: dhcp log without dhcp json: %s", __FILE__, __LINE__, json_string);
         }
 
-    json_object_put(json_obj_dhcp); 	// Good
-
 }
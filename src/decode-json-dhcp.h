@@ -30,6 +30,8 @@
 libjson-c is required for Meer to function!
 #endif
 
+#include "meer-json.h"
+
 #include "meer-def.h"
 
 typedef struct _DecodeDHCP _DecodeDHCP;
@@ -54,5 +56,5 @@ char dhcp_type[16];
 };
 
 
-void Decode_JSON_DHCP( struct json_object *json_obj, char *json_string, struct _DecodeDHCP *DecodeDHCP );
+void Decode_JSON_DHCP( struct _MeerJSON *doc, char *json_string, struct _DecodeDHCP *DecodeDHCP );
 
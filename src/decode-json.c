@@ -39,8 +39,10 @@ libjson-c is required for Meer to function!
 #include <stdbool.h>
 #include <string.h>
 
+#include "meer-json.h"
 #include "decode-json.h"
 #include "decode-json-alert.h"
+#include "sid-cache.h"
 #include "decode-json-dhcp.h"
 
 #include "fingerprints.h"
@@ -49,6 +51,7 @@ libjson-c is required for Meer to function!
 #include "meer.h"
 #include "meer-def.h"
 #include "output.h"
+#include "follow.h"
 
 #ifdef HAVE_LIBHIREDIS
 #include "output-plugins/redis.h"
@@ -62,266 +65,372 @@ struct _MeerCounters *MeerCounters;
 struct _MeerConfig *MeerConfig;
 struct _MeerHealth *MeerHealth;
 
-bool Decode_JSON( char *json_string )
-{
+/****************************************************************************
+ * Decode_JSON_Needs_Tree - Does anything read more than "event_type" from
+ * this kind of event?  If not,  the outputs only pass the line along and it
+ * never has to be parsed.
+ ****************************************************************************/
 
-    struct json_object *json_obj = NULL;
-    struct json_object *tmp = NULL;
+static bool Decode_JSON_Needs_Tree( const char *event_type )
+{
 
-    char tmp_type[32] = { 0 };
-    bool bad_json = false;
-    bool fingerprint_return = false;
+    if ( !strcmp(event_type, "alert") )
+        {
+            return(true);
+        }
 
 #ifdef HAVE_LIBHIREDIS
 
-    char fingerprint_IP_JSON[1024] = { 0 };
-    char fingerprint_EVENT_JSON[PACKET_BUFFER_SIZE_DEFAULT] = { 0 };
-    char fingerprint_DHCP_JSON[2048] = { 0 };
+    if ( MeerOutput->redis_flag == true )
+        {
+
+            if ( !strcmp(event_type, "dhcp") && MeerConfig->fingerprint == true )
+                {
+                    return(true);
+                }
+
+            if ( !strcmp(event_type, "client_stats") && MeerConfig->client_stats == true )
+                {
+                    return(true);
+                }
+        }
 
 #endif
 
-    if ( json_string == NULL )
+    return(false);
+}
+
+/****************************************************************************
+ * Decode_JSON - Parse the EVE line and do everything that doesn't touch an
+ * output (decode the alert,  fingerprints,  etc).  Returns false if the line
+ * isn't usable.
+ ****************************************************************************/
+
+bool Decode_JSON( struct _MeerEvent *Event )
+{
+
+    struct _MeerJSONVal *tmp = NULL;
+
+    Event->valid = false;
+
+    if ( Event->json_string == NULL )
         {
-            MeerCounters->InvalidJSONCount++;
-            return 1;
+            __sync_fetch_and_add(&MeerCounters->InvalidJSONCount, 1);
+            return(false);
         }
 
-    json_obj = json_tokener_parse(json_string);
+    /* Most lines (flow,  dns,  etc) are only routed on "event_type" */
 
-    if ( json_obj == NULL )
+    if ( Meer_JSON_Prescan(Event->json_string, Event->json_len, "event_type", Event->event_type, sizeof(Event->event_type)) == true &&
+            Decode_JSON_Needs_Tree(Event->event_type) == false )
         {
-            MeerCounters->InvalidJSONCount++;
-            Meer_Log(WARN, "Unable t json_tokener_parse: %s", json_string);
-            return 1;
+            __sync_fetch_and_add(&MeerCounters->PrescanCount, 1);
+            Event->valid = true;
+            return(true);
         }
 
-    if (!json_object_object_get_ex(json_obj, "event_type", &tmp))
+    Event->json_obj = Meer_JSON_Parse(Event->json_string, Event->json_len);
+
+    if ( Event->json_obj == NULL )
         {
-            bad_json = true;
+            __sync_fetch_and_add(&MeerCounters->InvalidJSONCount, 1);
+            Meer_Log(WARN, "Unable to parse JSON: %s", Event->json_string);
+            return(false);
         }
 
-    if ( tmp == NULL )
+    if ( ( tmp = Meer_JSON_Get(Meer_JSON_Root(Event->json_obj), "event_type") ) == NULL )
         {
-            bad_json = true;
+            __sync_fetch_and_add(&MeerCounters->InvalidJSONCount, 1);
+            return(false);
         }
 
-    if ( bad_json == false )
+    strlcpy(Event->event_type, Meer_JSON_String(Event->json_obj, tmp), sizeof(Event->event_type));
+    Event->valid = true;
+
+    if ( !strcmp(Event->event_type, "alert") )
         {
 
-            if ( !strcmp(json_object_get_string(tmp), "alert") )
+            Event->DecodeAlert = Decode_JSON_Alert( Event->json_obj, Event->json_string );
+
+#ifdef HAVE_LIBHIREDIS
+
+            /* Add fingerprint */
+
+            if (MeerConfig->fingerprint == true && MeerOutput->redis_flag == true )
                 {
+                    Add_Fingerprint_To_JSON( Event->DecodeAlert );
 
-                    struct _DecodeAlert *DecodeAlert;   /* event_type: alert */
-                    DecodeAlert = Decode_JSON_Alert( json_obj, json_string );
+                    /* Is this a "fingerprint" signature? */
 
-#ifdef HAVE_LIBHIREDIS
+                    Event->FingerprintData = (struct _FingerprintData *) malloc(sizeof(_FingerprintData));
 
-                    /* Add fingerprint */
+                    if ( Event->FingerprintData == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] JSON: \"%s\" Failed to allocate memory for _FingerprintData.  Abort!", __FILE__, __LINE__, Event->json_string);
+                        }
+
+                    memset(Event->FingerprintData, 0, sizeof(_FingerprintData));
+
+                    if ( Event->DecodeAlert->Sig->fingerprint == true )
+                        {
+                            Parse_Fingerprint( Event->DecodeAlert, Event->FingerprintData);
+                        }
 
-                    if (MeerConfig->fingerprint == true && MeerOutput->redis_flag == true )
+                    if ( Event->FingerprintData->ret == true )
                         {
-                            Add_Fingerprint_To_JSON( json_obj, DecodeAlert );
 
-                            /* Is this a "fingerprint" signature? */
+                            Event->fingerprint = true;
 
-                            struct _FingerprintData *FingerprintData;
-                            FingerprintData = (struct _FingerprintData *) malloc(sizeof(_FingerprintData));
+                            Event->fingerprint_IP_JSON = malloc( FINGERPRINT_IP_JSON_SIZE );
+                            Event->fingerprint_EVENT_JSON = malloc( PACKET_BUFFER_SIZE_DEFAULT );
 
-                            if ( FingerprintData == NULL )
+                            if ( Event->fingerprint_IP_JSON == NULL || Event->fingerprint_EVENT_JSON == NULL )
                                 {
-                                    Meer_Log(ERROR, "[%s, line %d] JSON: \"%s\" Failed to allocate memory for _FingerprintData.  Abort!", __FILE__, __LINE__, json_string);
+                                    Meer_Log(ERROR, "[%s, line %d] JSON: \"%s\" Failed to allocate memory for fingerprint JSON.  Abort!", __FILE__, __LINE__, Event->json_string);
                                 }
 
-                            memset(FingerprintData, 0, sizeof(_FingerprintData));
-                            Parse_Fingerprint( DecodeAlert, FingerprintData);
+                            Fingerprint_IP_JSON( Event->DecodeAlert, Event->fingerprint_IP_JSON, FINGERPRINT_IP_JSON_SIZE );
+                            Fingerprint_EVENT_JSON( Event->DecodeAlert, Event->FingerprintData, Event->fingerprint_EVENT_JSON, PACKET_BUFFER_SIZE_DEFAULT );
 
-                            fingerprint_return = false;
+                        }
 
-                            if ( FingerprintData->ret == true )
-                                {
+                }
 
-                                    fingerprint_return = FingerprintData->ret;
+#endif
 
-                                    Fingerprint_IP_JSON( DecodeAlert, fingerprint_IP_JSON, sizeof(fingerprint_IP_JSON));
-                                    Output_Fingerprint_IP( DecodeAlert, fingerprint_IP_JSON);
+            /* Now that everything has been added (DNS,  fingerprints) */
 
-                                    Fingerprint_EVENT_JSON( DecodeAlert, FingerprintData, fingerprint_EVENT_JSON, sizeof(fingerprint_EVENT_JSON));
-                                    Output_Fingerprint_EVENT( DecodeAlert, FingerprintData, fingerprint_EVENT_JSON );
+            Decode_JSON_Alert_Splice( Event->DecodeAlert );
 
-                                }
+        }
 
-                            free(FingerprintData);
+#ifdef HAVE_LIBHIREDIS
 
-                        }
+    else if ( !strcmp(Event->event_type, "dhcp") && MeerOutput->redis_flag == true && MeerConfig->fingerprint == true )
+        {
 
-#endif
+            Event->DecodeDHCP = (struct _DecodeDHCP *) malloc(sizeof(_DecodeDHCP));
+            Event->fingerprint_DHCP_JSON = malloc( FINGERPRINT_DHCP_JSON_SIZE );
 
-#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+            if ( Event->DecodeDHCP == NULL || Event->fingerprint_DHCP_JSON == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] JSON: \"%s\" Failed to allocate memory for _DecodeDHCP.  Abort!", __FILE__, __LINE__, Event->json_string);
+                }
 
-                    if ( MeerOutput->sql_enabled == true && fingerprint_return == false )
-                        {
-                            Output_Alert_SQL( DecodeAlert );
-                        }
-#endif
+            memset(Event->DecodeDHCP, 0, sizeof(_DecodeDHCP));
 
-#ifdef HAVE_LIBHIREDIS
+            Decode_JSON_DHCP( Event->json_obj, Event->json_string, Event->DecodeDHCP );
+            Fingerprint_DHCP_JSON( Event->DecodeDHCP, Event->fingerprint_DHCP_JSON, FINGERPRINT_DHCP_JSON_SIZE );
+
+        }
 
-                    if ( fingerprint_return == false && MeerOutput->redis_flag == true )
-                        {
-                            JSON_To_Redis( DecodeAlert->new_json_string, "alert" );
-                        }
 #endif
 
-                    if ( MeerOutput->external_enabled == true )
-                        {
-                            Output_External( DecodeAlert );
-                        }
+    return(true);
+}
 
-#ifdef WITH_BLUEDOT
+/****************************************************************************
+ * Output_JSON - Hand a decoded event to the outputs in "outputs"
+ * (OUTPUT_* bits).
+ ****************************************************************************/
 
-                    if ( MeerOutput->bluedot_flag == true )
-                        {
-                            Output_Bluedot( DecodeAlert );
-                        }
+void Output_JSON( struct _MeerEvent *Event, int outputs )
+{
+
+    char *json_string = Event->json_string;
+    char *event_type = Event->event_type;
+
+    bool fingerprint_return = false;
+
+    if ( Event->valid == false )
+        {
+            return;
+        }
+
+#ifdef HAVE_LIBHIREDIS
+    fingerprint_return = Event->fingerprint;
 #endif
 
-#ifdef WITH_ELASTICSEARCH
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
 
-                    if ( MeerOutput->elasticsearch_flag == true )
-                        {
-                            Output_HTTP( DecodeAlert->new_json_string, DecodeAlert->event_type );
-                        }
+    /* SQL needs to know which sensor this came from */
+
+    if ( ( outputs & OUTPUT_SQL ) && MeerOutput->sql_enabled == true )
+        {
+            Follow_Activate_SQL( Event->spool );
+        }
 
 #endif
 
-                    free(DecodeAlert);
+    if ( Event->DecodeAlert != NULL )
+        {
 
-                }
+            struct _DecodeAlert *DecodeAlert = Event->DecodeAlert;
 
 #ifdef HAVE_LIBHIREDIS
 
-            if ( MeerOutput->redis_flag == true )
+            if ( ( outputs & OUTPUT_REDIS ) && fingerprint_return == true )
                 {
+                    Output_Fingerprint_IP( DecodeAlert, Event->fingerprint_IP_JSON );
+                    Output_Fingerprint_EVENT( DecodeAlert, Event->FingerprintData, Event->fingerprint_EVENT_JSON );
+                }
 
-                    if ( !strcmp(json_object_get_string(tmp), "dhcp") && MeerConfig->fingerprint == true )
-                        {
+#endif
 
-                            struct _DecodeDHCP *DecodeDHCP;   /* event_type: dhcp */
-                            DecodeDHCP = (struct _DecodeDHCP *) malloc(sizeof(_DecodeDHCP));
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
 
-                            if ( DecodeDHCP == NULL )
-                                {
-                                    Meer_Log(ERROR, "[%s, line %d] JSON: \"%s\" Failed to allocate memory for _DecodeDHCP.  Abort!", __FILE__, __LINE__, json_string);
-                                }
+            if ( ( outputs & OUTPUT_SQL ) && MeerOutput->sql_enabled == true && fingerprint_return == false )
+                {
+                    Output_Alert_SQL( DecodeAlert );
+                }
+#endif
 
-                            memset(DecodeDHCP, 0, sizeof(_DecodeDHCP));
+#ifdef HAVE_LIBHIREDIS
 
-                            Decode_JSON_DHCP( json_obj, json_string, DecodeDHCP );
+            if ( ( outputs & OUTPUT_REDIS ) && fingerprint_return == false && MeerOutput->redis_flag == true )
+                {
+                    JSON_To_Redis( Event, DecodeAlert->new_json_string, "alert" );
+                }
+#endif
 
-                            Fingerprint_DHCP_JSON( DecodeDHCP, fingerprint_DHCP_JSON, sizeof(fingerprint_DHCP_JSON));
-                            Output_Fingerprint_DHCP ( DecodeDHCP, fingerprint_DHCP_JSON );
+            if ( ( outputs & OUTPUT_EXTERNAL ) && MeerOutput->external_enabled == true )
+                {
+                    Output_External( DecodeAlert );
+                }
 
-                            free(DecodeDHCP);
-                        }
+#ifdef WITH_BLUEDOT
 
+            if ( ( outputs & OUTPUT_BLUEDOT ) && MeerOutput->bluedot_flag == true )
+                {
+                    Output_Bluedot( DecodeAlert );
                 }
-
 #endif
 
-            /* Process Suricata / Sagan stats */
+#ifdef WITH_ELASTICSEARCH
 
-            if ( !strcmp(json_object_get_string(tmp), "stats" ) )
+            if ( ( outputs & OUTPUT_ELASTICSEARCH ) && MeerOutput->elasticsearch_flag == true )
                 {
-                    Output_Stats( json_string );
+                    Output_HTTP( DecodeAlert->new_json_string, DecodeAlert->event_type );
                 }
 
-            /* Process client stats data from Sagan */
+#endif
+
+        }
 
 #ifdef HAVE_LIBHIREDIS
 
-            if ( !strcmp(json_object_get_string(tmp), "client_stats") && MeerConfig->client_stats == true )
-                {
-                    Decode_Output_JSON_Client_Stats( json_obj, json_string );
-                }
+    if ( ( outputs & OUTPUT_REDIS ) && Event->DecodeDHCP != NULL )
+        {
+            Output_Fingerprint_DHCP ( Event->DecodeDHCP, Event->fingerprint_DHCP_JSON );
+        }
 
 #endif
 
+    /* Process Suricata / Sagan stats */
 
-            if ( MeerOutput->pipe_enabled == true )
-                {
-                    strlcpy(tmp_type, json_object_get_string(tmp), sizeof(tmp_type));
-                    Output_Pipe(tmp_type, json_string );
-                }
+    if ( ( outputs & OUTPUT_SQL ) && !strcmp(event_type, "stats" ) )
+        {
+            Output_Stats( json_string );
+        }
+
+    /* Process client stats data from Sagan */
 
 #ifdef HAVE_LIBHIREDIS
 
-            if ( MeerOutput->redis_flag == true )
-                {
+    if ( ( outputs & OUTPUT_REDIS ) && !strcmp(event_type, "client_stats") && MeerConfig->client_stats == true )
+        {
+            Decode_Output_JSON_Client_Stats( Event->json_obj, json_string );
+        }
 
-                    if ( !strcmp(json_object_get_string(tmp), "flow") && MeerOutput->redis_flow == true )
-                        {
-                            JSON_To_Redis( json_string, "flow" );
-                        }
+#endif
 
-                    else if ( !strcmp(json_object_get_string(tmp), "dns") && MeerOutput->redis_dns == true )
-                        {
-                            JSON_To_Redis( json_string, "dns" );
-                        }
 
-                    else if ( !strcmp(json_object_get_string(tmp), "http") && MeerOutput->redis_http == true)
-                        {
-                            JSON_To_Redis( json_string, "http" );
-                        }
+    if ( ( outputs & OUTPUT_PIPE ) && MeerOutput->pipe_enabled == true )
+        {
+            Output_Pipe(event_type, json_string, Event->json_len );
+        }
 
-                    else if ( !strcmp(json_object_get_string(tmp), "files" ) && MeerOutput->redis_files == true )
-                        {
-                            JSON_To_Redis( json_string, "files" );
-                        }
+#ifdef HAVE_LIBHIREDIS
 
-                    else if ( !strcmp(json_object_get_string(tmp), "tls" ) && MeerOutput->redis_tls == true)
-                        {
-                            JSON_To_Redis( json_string, "tls" );
-                        }
+    if ( ( outputs & OUTPUT_REDIS ) && MeerOutput->redis_flag == true )
+        {
 
-                    else if ( !strcmp(json_object_get_string(tmp), "ssh" ) && MeerOutput->redis_ssh == true)
-                        {
-                            JSON_To_Redis( json_string, "ssh" );
-                        }
+            if ( !strcmp(event_type, "flow") && MeerOutput->redis_flow == true )
+                {
+                    JSON_To_Redis( Event, json_string, "flow" );
+                }
 
-                    else if ( !strcmp(json_object_get_string(tmp), "smtp" ) && MeerOutput->redis_smtp == true)
-                        {
-                            JSON_To_Redis( json_string, "smtp" );
-                        }
+            else if ( !strcmp(event_type, "dns") && MeerOutput->redis_dns == true )
+                {
+                    JSON_To_Redis( Event, json_string, "dns" );
+                }
 
-                    else if ( !strcmp(json_object_get_string(tmp), "fileinfo" ) && MeerOutput->redis_fileinfo == true)
-                        {
-                            JSON_To_Redis( json_string, "fileinfo" );
-                        }
+            else if ( !strcmp(event_type, "http") && MeerOutput->redis_http == true)
+                {
+                    JSON_To_Redis( Event, json_string, "http" );
+                }
 
-                    else if ( !strcmp(json_object_get_string(tmp), "dhcp" ) && MeerOutput->redis_dhcp == true)
-                        {
-                            JSON_To_Redis( json_string, "dhcp" );
-                        }
+            else if ( !strcmp(event_type, "files" ) && MeerOutput->redis_files == true )
+                {
+                    JSON_To_Redis( Event, json_string, "files" );
+                }
 
-                    else if ( !strcmp(json_object_get_string(tmp), "stats" ) && MeerOutput->redis_stats == true)
-                        {
-                            JSON_To_Redis( json_string, "stats" );
-                        }
+            else if ( !strcmp(event_type, "tls" ) && MeerOutput->redis_tls == true)
+                {
+                    JSON_To_Redis( Event, json_string, "tls" );
+                }
 
+            else if ( !strcmp(event_type, "ssh" ) && MeerOutput->redis_ssh == true)
+                {
+                    JSON_To_Redis( Event, json_string, "ssh" );
                 }
 
-#endif
+            else if ( !strcmp(event_type, "smtp" ) && MeerOutput->redis_smtp == true)
+                {
+                    JSON_To_Redis( Event, json_string, "smtp" );
+                }
+
+            else if ( !strcmp(event_type, "fileinfo" ) && MeerOutput->redis_fileinfo == true)
+                {
+                    JSON_To_Redis( Event, json_string, "fileinfo" );
+                }
+
+            else if ( !strcmp(event_type, "dhcp" ) && MeerOutput->redis_dhcp == true)
+                {
+                    JSON_To_Redis( Event, json_string, "dhcp" );
+                }
+
+            else if ( !strcmp(event_type, "stats" ) && MeerOutput->redis_stats == true)
+                {
+                    JSON_To_Redis( Event, json_string, "stats" );
+                }
 
-        }
-    else
-        {
-            MeerCounters->InvalidJSONCount++;
         }
 
+#endif
 
-    /* Delete json-c _root_ objects */
+}
+
+/****************************************************************************
+ * Free_JSON - Release everything Decode_JSON() allocated.  The line itself
+ * belongs to the caller.
+ ****************************************************************************/
+
+void Free_JSON( struct _MeerEvent *Event )
+{
+
+    Decode_JSON_Alert_Free(Event->DecodeAlert);
+
+#ifdef HAVE_LIBHIREDIS
+
+    free(Event->FingerprintData);
+    free(Event->fingerprint_IP_JSON);
+    free(Event->fingerprint_EVENT_JSON);
+    free(Event->DecodeDHCP);
+    free(Event->fingerprint_DHCP_JSON);
+
+#endif
 
-    json_object_put(json_obj);
+    Meer_JSON_Free(Event->json_obj);
 
-    return 0;
 }
@@ -18,4 +18,40 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-bool Decode_JSON( char *json_string );
+/* One EVE line on its way through decode and output.  Decode_JSON() fills
+   it in,  Output_JSON() hands it to the outputs and Free_JSON() cleans it
+   up.  With "decode_threads",  these run on different threads. */
+
+typedef struct _MeerEvent _MeerEvent;
+struct _MeerEvent
+{
+
+    struct _MeerSpool *spool;
+    uint64_t position;				/* This line's position in the spool */
+
+    char *json_string;
+    size_t json_len;
+
+    struct _MeerJSON *json_obj;
+    char event_type[32];
+    bool valid;
+
+    struct _DecodeAlert *DecodeAlert;
+
+#ifdef HAVE_LIBHIREDIS
+
+    bool fingerprint;				/* A "fingerprint" signature */
+    char *fingerprint_IP_JSON;
+    char *fingerprint_EVENT_JSON;
+    struct _FingerprintData *FingerprintData;
+
+    struct _DecodeDHCP *DecodeDHCP;
+    char *fingerprint_DHCP_JSON;
+
+#endif
+
+};
+
+bool Decode_JSON( struct _MeerEvent *Event );
+void Output_JSON( struct _MeerEvent *Event, int outputs );
+void Free_JSON( struct _MeerEvent *Event );
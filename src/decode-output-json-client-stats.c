@@ -42,10 +42,12 @@ libjson-c is required for Meer to function!
 #include <string.h>
 
 #include "util.h"
+#include "util-dns.h"
 #include "meer.h"
 #include "meer-def.h"
 
 #include "decode-json-alert.h"
+#include "decode-json.h"
 #include "output-plugins/redis.h"
 #include "decode-output-json-client-stats.h"
 
@@ -53,13 +55,14 @@ struct _MeerCounters *MeerCounters;
 struct _MeerOutput *MeerOutput;
 struct _MeerConfig *MeerConfig;
 
-void Decode_Output_JSON_Client_Stats( struct json_object *json_obj, const char *json_string )
+void Decode_Output_JSON_Client_Stats( struct _MeerJSON *doc, const char *json_string )
 {
 
     char redis_prefix[128] = { 0 };
     char dns[255] = { 0 };
 
-    struct json_object *tmp = NULL;
+    struct _MeerJSONVal *json_obj = Meer_JSON_Root(doc);
+    struct _MeerJSONVal *tmp = NULL;
 
     char *cs_timestamp = NULL;
     char *cs_sensor_name = NULL;
@@ -74,9 +77,9 @@ void Decode_Output_JSON_Client_Stats( struct json_object *json_obj, const char *
 
     /* Timestamp */
 
-    if (json_object_object_get_ex(json_obj, "timestamp", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "timestamp") ) != NULL )
         {
-            cs_timestamp = (char *)json_object_get_string(tmp);
+            cs_timestamp = Meer_JSON_String(doc, tmp);
         }
 
     if ( cs_timestamp == NULL )
@@ -88,9 +91,9 @@ void Decode_Output_JSON_Client_Stats( struct json_object *json_obj, const char *
 
     /* Sensor Name */
 
-    if (json_object_object_get_ex(json_obj, "sensor_name", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "sensor_name") ) != NULL )
         {
-            cs_sensor_name = (char *)json_object_get_string(tmp);
+            cs_sensor_name = Meer_JSON_String(doc, tmp);
         }
 
     if ( cs_sensor_name == NULL )
@@ -102,9 +105,9 @@ void Decode_Output_JSON_Client_Stats( struct json_object *json_obj, const char *
 
     /* IP Address */
 
-    if (json_object_object_get_ex(json_obj, "ip_address", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "ip_address") ) != NULL )
         {
-            cs_ipaddr = (char *)json_object_get_string(tmp);
+            cs_ipaddr = Meer_JSON_String(doc, tmp);
         }
 
     if ( cs_ipaddr == NULL )
@@ -116,9 +119,9 @@ void Decode_Output_JSON_Client_Stats( struct json_object *json_obj, const char *
 
     /* Program */
 
-    if (json_object_object_get_ex(json_obj, "program", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "program") ) != NULL )
         {
-            cs_program = (char *)json_object_get_string(tmp);
+            cs_program = Meer_JSON_String(doc, tmp);
         }
 
     if ( cs_program == NULL )
@@ -130,9 +133,9 @@ void Decode_Output_JSON_Client_Stats( struct json_object *json_obj, const char *
 
     /* Message */
 
-    if (json_object_object_get_ex(json_obj, "message", &tmp))
+    if ( ( tmp = Meer_JSON_Get(json_obj, "message") ) != NULL )
         {
-            cs_message = (char *)json_object_get_string(tmp);
+            cs_message = Meer_JSON_String(doc, tmp);
         }
 
     if ( cs_message == NULL )
@@ -30,5 +30,7 @@
 libjson-c is required for Meer to function!
 #endif
 
-void Decode_Output_JSON_Client_Stats ( struct json_object *json_obj, const char *json_string );
+#include "meer-json.h"
+
+void Decode_Output_JSON_Client_Stats ( struct _MeerJSON *doc, const char *json_string );
 
@@ -31,10 +31,12 @@
 #include <hiredis/hiredis.h>
 
 #include "decode-json-alert.h"
+#include "decode-json.h"
 
 #include "meer.h"
 #include "meer-def.h"
 #include "util.h"
+#include "util-cidr.h"
 #include "config-yaml.h"
 #include "fingerprint-to-json.h"
 
@@ -42,32 +44,28 @@
 
 
 
-struct _Fingerprint_Networks *Fingerprint_Networks;
+struct _CIDR_Trie Fingerprint_Networks;
 
 struct _MeerConfig *MeerConfig;
 struct _MeerOutput *MeerOutput;
 struct _MeerCounters *MeerCounters;
 
-
-void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *DecodeAlert )
+void Add_Fingerprint_To_JSON( _DecodeAlert *DecodeAlert )
 {
 
     int key_count = 0;
 
     int i = 0;
     int a = 0;
-    int z = 0;
 
     char fingerprint_tmp[PACKET_BUFFER_SIZE_DEFAULT] = { 0 };
     char tmp_command[PACKET_BUFFER_SIZE_DEFAULT] = { 0 };
-    char tmp_new_alert[PACKET_BUFFER_SIZE_DEFAULT] = { 0 };
-    char tmp_new_new_alert[PACKET_BUFFER_SIZE_DEFAULT] = { 0 };
-
-    unsigned char ip[MAXIPBIT] = { 0 };
+    char tmp_key[64] = { 0 };
+    char tmp_pattern[256] = { 0 };
+    char keys[FINGERPRINT_MAX_KEYS][FINGERPRINT_KEY_SIZE];
 
-    struct json_object *json_obj_fingerprint = NULL;
-    struct json_object *tmp = NULL;
-    bool  event_changed = false;
+    struct _MeerJSON *json_obj_fingerprint = NULL;
+    struct _MeerJSONVal *tmp = NULL;
 
     char *tmp_ip = NULL;
     char *tmp_type = NULL;
@@ -76,9 +74,6 @@ void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode
 
     char tmp_dhcp[1024] = { 0 };
 
-    redisReply *reply;
-
-
     /* Do DHCP */
 
     for (a = 0; a < 2; a++ )
@@ -91,15 +86,7 @@ void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode
                     tmp_ip = DecodeAlert->src_ip;;
                     tmp_type = "src";
 
-                    IP2Bit(DecodeAlert->src_ip, ip);
-
-                    for ( z = 0; z < MeerCounters->fingerprint_network_count; z++ )
-                        {
-                            if ( Is_Inrange( ip, (unsigned char *)&Fingerprint_Networks[z].range, 1) )
-                                {
-                                    valid_fingerprint_net = true;
-                                }
-                        }
+                    valid_fingerprint_net = CIDR_Trie_Match( &Fingerprint_Networks, DecodeAlert->src_ip_bit );
 
                 }
             else
@@ -107,15 +94,7 @@ void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode
                     tmp_ip = DecodeAlert->dest_ip;
                     tmp_type = "dest";
 
-                    IP2Bit(DecodeAlert->dest_ip, ip);
-
-                    for ( z = 0; z < MeerCounters->fingerprint_network_count; z++ )
-                        {
-                            if ( Is_Inrange( ip, (unsigned char *)&Fingerprint_Networks[z].range, 1) )
-                                {
-                                    valid_fingerprint_net = true;
-                                }
-                        }
+                    valid_fingerprint_net = CIDR_Trie_Match( &Fingerprint_Networks, DecodeAlert->dest_ip_bit );
                 }
 
 
@@ -128,14 +107,8 @@ void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode
                     if ( tmp_dhcp[0] != '\0' )
                         {
 
-                            event_changed = true;
-
-                            strlcpy(tmp_new_alert, DecodeAlert->new_json_string, sizeof(tmp_new_alert));
-                            tmp_new_alert[ strlen(tmp_new_alert) - 2 ] = '\0';
-
-                            snprintf(tmp_new_new_alert, sizeof(tmp_new_new_alert), "%s, \"fingerprint_dhcp_%s\": %s", tmp_new_alert, tmp_type, tmp_dhcp);
-
-                            snprintf(DecodeAlert->new_json_string, sizeof(DecodeAlert->new_json_string), "%s }", tmp_new_new_alert);
+                            snprintf(tmp_key, sizeof(tmp_key), "fingerprint_dhcp_%s", tmp_type);
+                            Decode_JSON_Alert_Add( DecodeAlert, tmp_key, tmp_dhcp, false );
                         }
                 }
         }
@@ -152,15 +125,7 @@ void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode
                     tmp_ip = DecodeAlert->src_ip;
                     tmp_type = "src";
 
-                    IP2Bit(DecodeAlert->src_ip, ip);
-
-                    for ( z = 0; z < MeerCounters->fingerprint_network_count; z++ )
-                        {
-                            if ( Is_Inrange( ip, (unsigned char *)&Fingerprint_Networks[z].range, 1) )
-                                {
-                                    valid_fingerprint_net = true;
-                                }
-                        }
+                    valid_fingerprint_net = CIDR_Trie_Match( &Fingerprint_Networks, DecodeAlert->src_ip_bit );
 
                 }
             else
@@ -168,15 +133,7 @@ void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode
                     tmp_ip = DecodeAlert->dest_ip;
                     tmp_type = "dest";
 
-                    IP2Bit(DecodeAlert->dest_ip, ip);
-
-                    for ( z = 0; z < MeerCounters->fingerprint_network_count; z++ )
-                        {
-                            if ( Is_Inrange( ip, (unsigned char *)&Fingerprint_Networks[z].range, 1) )
-                                {
-                                    valid_fingerprint_net = true;
-                                }
-                        }
+                    valid_fingerprint_net = CIDR_Trie_Match( &Fingerprint_Networks, DecodeAlert->dest_ip_bit );
 
                 }
 
@@ -184,52 +141,37 @@ void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode
             if ( valid_fingerprint_net == true )
                 {
 
-                    reply = redisCommand(MeerOutput->c_redis, "SCAN 0 MATCH %s|event|%s|* count 1000000", FINGERPRINT_REDIS_KEY, tmp_ip);
-                    key_count = reply->element[1]->elements;
-
-                    if ( key_count > 0 )
-                        {
-                            event_changed = true;
-                            strlcpy(tmp_new_alert, DecodeAlert->new_json_string, sizeof(tmp_new_alert));
-                            tmp_new_alert[ strlen(tmp_new_alert) - 2 ] = '\0';
-                        }
+                    snprintf(tmp_pattern, sizeof(tmp_pattern), "%s|event|%s|*", FINGERPRINT_REDIS_KEY, tmp_ip);
+                    key_count = Redis_Scan( tmp_pattern, (char *)keys, sizeof(keys[0]), FINGERPRINT_MAX_KEYS );
 
                     for ( i = 0; i < key_count; i++ )
                         {
-                            redisReply *kr = reply->element[1]->element[i];
-                            snprintf(tmp_command, sizeof(tmp_command), "GET %s", kr->str);
+                            snprintf(tmp_command, sizeof(tmp_command), "GET %s", keys[i]);
                             Redis_Reader(tmp_command, fingerprint_tmp, sizeof(fingerprint_tmp));
 
                             if ( Validate_JSON_String( fingerprint_tmp ) == 0 )
                                 {
-                                    json_obj_fingerprint = json_tokener_parse(fingerprint_tmp);
+                                    json_obj_fingerprint = Meer_JSON_Parse(fingerprint_tmp, strlen(fingerprint_tmp));
                                 }
-                            else
+
+                            if ( json_obj_fingerprint == NULL )
                                 {
                                     Meer_Log(WARN, "Incomplete or invalid fingerprint JSON for flow id %s", DecodeAlert->flowid);
                                     continue;
                                 }
 
-                            if ( json_object_object_get_ex(json_obj_fingerprint, "fingerprint", &tmp))
+                            if ( ( tmp = Meer_JSON_Get(Meer_JSON_Root(json_obj_fingerprint), "fingerprint") ) != NULL )
                                 {
-                                    snprintf(tmp_new_new_alert, sizeof(tmp_new_new_alert), "%s, \"fingerprint_%s_%d\": %s", tmp_new_alert, tmp_type, i, json_object_get_string(tmp));
-                                    strlcpy(tmp_new_alert, tmp_new_new_alert, sizeof(tmp_new_alert));
+                                    snprintf(tmp_key, sizeof(tmp_key), "fingerprint_%s_%d", tmp_type, i);
+                                    Decode_JSON_Alert_Add( DecodeAlert, tmp_key, Meer_JSON_String(json_obj_fingerprint, tmp), false );
                                 }
+
+                            Meer_JSON_Free(json_obj_fingerprint);
+                            json_obj_fingerprint = NULL;
                         }
                 }
         }
 
-    /* Copy new JSON over,  if JSON has been updated */
-
-    if ( event_changed == true )
-        {
-            /* Append final } */
-
-            snprintf(DecodeAlert->new_json_string, sizeof(DecodeAlert->new_json_string), "%s }", tmp_new_alert);
-        }
-
-    json_object_put(json_obj_fingerprint);
-
 }
 
 #endif
@@ -1,3 +1,3 @@
 //struct _DecodeAlert *Decode_JSON_Alert( struct json_object *json_obj, char *json_string );
 
-void Add_Fingerprint_To_JSON( struct json_object *json_obj, _DecodeAlert *Decode_JSON_Alert);
+void Add_Fingerprint_To_JSON( _DecodeAlert *Decode_JSON_Alert);
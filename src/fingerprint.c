@@ -20,6 +20,7 @@
 #include "meer.h"
 #include "meer-def.h"
 #include "util.h"
+#include "util-dns.h"
 #include "output.h"
 #include "references.h"
 #include "sid-map.h"
@@ -33,121 +34,44 @@ struct _MeerConfig *MeerConfig;
 void Parse_Fingerprint ( struct _DecodeAlert *DecodeAlert, struct _FingerprintData *FingerprintData )
 {
 
-    struct json_object *json_obj = NULL;
-    struct json_object *tmp = NULL;
-
-    char *fingerprint_d_os = NULL;
-    char *fingerprint_d_type = NULL;
-    char *fingerprint_d_expire = NULL;
-    char *fingerprint_d_source = NULL;
-
-    char *fingerprint_os = "unknown";
-    char *fingerprint_source = "unknown";
-    char *fingerprint_expire = NULL;
-
-    char *ptr1 = NULL;
+    const char *value = NULL;
 
     FingerprintData->expire = FINGERPRINT_REDIS_EXPIRE;
 
-    if ( DecodeAlert->alert_metadata[0] != '\0' )
+    if ( ( value = Decode_JSON_Alert_Metadata_Get( DecodeAlert, "fingerprint_os" ) ) != NULL )
         {
+            FingerprintData->ret = true;
+            strlcpy(FingerprintData->os, value, sizeof(FingerprintData->os));
+        }
 
-            json_obj = json_tokener_parse(DecodeAlert->alert_metadata);
-
-            if ( json_object_object_get_ex(json_obj, "fingerprint_os", &tmp))
-                {
-
-                    FingerprintData->ret = true;
-
-                    fingerprint_d_os =  (char *)json_object_get_string(tmp);
-
-                    strtok_r(fingerprint_d_os, "\"", &ptr1);
-
-                    if ( ptr1 == NULL )
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Failure to decode fingerprint_os from %s", __FILE__, __LINE__, fingerprint_d_os);
-                        }
-
-                    fingerprint_os = strtok_r(NULL, "\"", &ptr1);
-
-                    if ( fingerprint_os == NULL )
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Failure to decode fingerprint_os from %s", __FILE__, __LINE__, fingerprint_d_os);
-                        }
-
-                    strlcpy(FingerprintData->os, fingerprint_os, sizeof(FingerprintData->os));
-                }
-
-            if ( json_object_object_get_ex(json_obj, "fingerprint_source", &tmp))
-                {
-
-                    FingerprintData->ret = true;
-
-                    fingerprint_d_source =  (char *)json_object_get_string(tmp);
-
-                    strtok_r(fingerprint_d_source, "\"", &ptr1);
-
-                    if ( ptr1 == NULL )
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Failure to decode fingerprint_source from %s", __FILE__, __LINE__, fingerprint_d_source);
-                        }
-
-                    fingerprint_source = strtok_r(NULL, "\"", &ptr1);
+    if ( ( value = Decode_JSON_Alert_Metadata_Get( DecodeAlert, "fingerprint_source" ) ) != NULL )
+        {
+            FingerprintData->ret = true;
+            strlcpy(FingerprintData->source, value, sizeof(FingerprintData->source));
+        }
 
-                    if ( fingerprint_source == NULL )
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Failure to decode fingerprint_os from %s", __FILE__, __LINE__, fingerprint_d_source);
-                        }
+    if ( ( value = Decode_JSON_Alert_Metadata_Get( DecodeAlert, "fingerprint_expire" ) ) != NULL )
+        {
+            FingerprintData->ret = true;
+            FingerprintData->expire = atoi( value );
+        }
 
-                    strlcpy(FingerprintData->source, fingerprint_source, sizeof(FingerprintData->source));
-                }
+    if ( ( value = Decode_JSON_Alert_Metadata_Get( DecodeAlert, "fingerprint_type" ) ) != NULL )
+        {
 
+            FingerprintData->ret = true;
 
-            if ( json_object_object_get_ex(json_obj, "fingerprint_expire", &tmp))
+            if ( strcasestr( value, "client") )
                 {
-
-                    FingerprintData->ret = true;
-
-                    fingerprint_d_expire =  (char *)json_object_get_string(tmp);
-
-                    strtok_r(fingerprint_d_expire, "\"", &ptr1);
-
-                    if ( ptr1 == NULL )
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Failure to decode fingerprint_expire from %s", __FILE__, __LINE__, fingerprint_d_expire);
-                        }
-
-                    fingerprint_expire = strtok_r(NULL, "\"", &ptr1);
-
-                    if ( fingerprint_expire == NULL )
-                        {
-                            Meer_Log(WARN, "[%s, line %d] Failure to decode fingerprint_expire from %s", __FILE__, __LINE__, fingerprint_d_expire);
-                        }
-
-                    FingerprintData->expire = atoi( fingerprint_expire );
+                    strlcpy(FingerprintData->type, "client", sizeof(FingerprintData->type));
                 }
 
-            if ( json_object_object_get_ex(json_obj, "fingerprint_type", &tmp))
+            else if ( strcasestr( value, "server") )
                 {
-
-                    FingerprintData->ret = true;
-
-                    fingerprint_d_type =  (char *)json_object_get_string(tmp);
-
-                    if ( strcasestr( fingerprint_d_type, "client") )
-                        {
-                            strlcpy(FingerprintData->type, "client", sizeof(FingerprintData->type));
-                        }
-
-                    else if ( strcasestr( fingerprint_d_type, "server") )
-                        {
-                            strlcpy(FingerprintData->type, "server", sizeof(FingerprintData->type));
-                        }
+                    strlcpy(FingerprintData->type, "server", sizeof(FingerprintData->type));
                 }
         }
 
-    json_object_put(json_obj);
-
 }
 
 void Fingerprint_IP_JSON ( struct _DecodeAlert *DecodeAlert, char *str, size_t size )
@@ -337,6 +261,7 @@ void Fingerprint_DHCP_JSON ( struct _DecodeDHCP *DecodeDHCP, char *str, size_t s
     encode_json = json_object_new_object();
 
     char oui_data[128] = { 0 };
+    uint64_t mac = 0;
 
     json_object_object_add(encode_json, "timestamp", json_object_new_string( DecodeDHCP->timestamp ));
 
@@ -352,7 +277,11 @@ void Fingerprint_DHCP_JSON ( struct _DecodeDHCP *DecodeDHCP, char *str, size_t s
 
     if ( MeerConfig->oui == true )
         {
-            OUI_Lookup( DecodeDHCP->dhcp_client_mac, oui_data, sizeof(oui_data) );
+            if ( MAC_Parse( DecodeDHCP->dhcp_client_mac, &mac ) == 6 )
+                {
+                    OUI_Lookup( mac, oui_data, sizeof(oui_data) );
+                }
+
             json_object_object_add(encode_json, "vendor", json_object_new_string( oui_data ));
         }
 
@@ -0,0 +1,1465 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Spool "follower".  Rather than waking up every second to see if the
+   spool has changed,  we let the kernel tell us via inotify.  The spool
+   file itself is watched for writes,  truncation and it going away.  The
+   directory is watched so we know when a new spool (rotation) shows up.
+   If inotify isn't available (or fails),  we fall back to sleep(1)
+   polling like Meer has always done.
+
+   Spools are tracked by inode,  not by name.  When the spool is rotated
+   we keep reading the old file (Suricata keeps writing to it until it
+   re-opens its logs) and only switch to the new one once the old one
+   has been drained to EOF.
+
+   Data is pulled in with large read()s into one heap buffer and split on
+   newlines with memchr() (vectorized by libc).  Lines are handed to
+   Pipeline_Line() in place as pointer + length.  A partial line at the end
+   of a read is left in the file (we seek back to it) and picked up on the
+   next pass.  The buffer grows if a single line doesn't fit.
+
+   The kernel is told we read spools front to back (POSIX_FADV_SEQUENTIAL)
+   and,  while we're catching up,  to read FOLLOW_READAHEAD bytes ahead of
+   us.  Once every output is done with a stretch of the spool,  it's dropped
+   from the page cache (POSIX_FADV_DONTNEED) so it doesn't push out pages
+   Suricata still needs.  With "spool_punch_holes",  that stretch is also
+   punched out of the file (FALLOC_FL_PUNCH_HOLE),  freeing its disk space.
+   The file keeps its size and offsets,  it just reads back as zeros.
+
+   Several spools can be followed at once ("follow_eve" takes a comma
+   separated list of files and/or globs).  Globs are expanded again when
+   a matching name shows up in their directory (or on a timeout),  so a
+   spool created after we started is picked up.  Each has its own waldo record
+   and can have its own "interface" (for the SQL sensor table) by adding
+   ":interface" to the file name.  All spools share the same decode and
+   output path (pipeline.c).  Each line carries its spool along with it,
+   so the waldo that gets updated and the SQL sensor/cid that get used
+   (Follow_Activate_SQL()) are that spool's.
+
+   Unix sockets (input-socket.c) are registered here as SPOOL_TYPE_SOCKET
+   "spools" so they get the same waldo/interface/sensor handling.  Their
+   descriptors are polled along with inotify in Follow_Wait(). */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <glob.h>
+#include <fnmatch.h>
+#include <libgen.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include "meer.h"
+#include "meer-def.h"
+#include "util.h"
+#include "util-signal.h"
+#include "waldo.h"
+#include "follow.h"
+#include "input-socket.h"
+#include "pipeline.h"
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+#include "decode-json-alert.h"
+#include "output-plugins/sql.h"
+#endif
+
+struct _MeerConfig *MeerConfig;
+struct _MeerOutput *MeerOutput;
+struct _MeerWaldo *MeerWaldo;
+struct _MeerCounters *MeerCounters;
+struct _MeerSpool *MeerSpool;
+
+static struct _MeerSpool *ActiveSpool = NULL;
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+static struct _MeerSpool *SQLSpool = NULL;
+#endif
+
+static int inotify_fd = -1;
+
+/* Globs from "follow_eve".  Spools found after Init_Follow() need their
+   waldo,  cursors and watches set up before the other threads see them. */
+
+typedef struct _FollowGlob _FollowGlob;
+struct _FollowGlob
+{
+    char pattern[256];
+    char dir[256];
+    char name[256];
+    char interface[64];
+    int dir_wd;
+};
+
+static struct _FollowGlob FollowGlob[FOLLOW_MAX_GLOBS];
+static uint32_t FollowGlobCount = 0;
+static time_t FollowGlobTime = 0;
+
+static bool spools_ready = false;
+
+static char *read_buf = NULL;
+static size_t read_buf_size = 0;		/* Usable size,  one extra byte is allocated for a \0 */
+
+static void Follow_Ready_Spool( struct _MeerSpool *Spool );
+
+/* Add one spool to MeerSpool[].  MeerSpool[] never moves,  other threads
+   hold pointers into it. */
+
+static void Follow_Add_Spool( const char *filename, const char *interface, unsigned char type )
+{
+
+    static bool full_flag = false;
+
+    char tmp[256] = { 0 };
+    uint32_t i = 0;
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+            if ( !strcmp( MeerSpool[i].filename, filename ) )
+                {
+                    return;	/* Listed twice (or matched by two globs) */
+                }
+        }
+
+    if ( MeerCounters->SpoolCount >= MAX_SPOOLS )
+        {
+
+            /* A glob found one more after we started.  Once is enough,
+               globs are expanded again and again. */
+
+            if ( spools_ready == true )
+                {
+
+                    if ( full_flag == false )
+                        {
+                            Meer_Log(WARN, "Too many spools.  Max is %d.  Not following %s or anything else new.", MAX_SPOOLS, filename);
+                            full_flag = true;
+                        }
+
+                    return;
+                }
+
+            Meer_Log(ERROR, "[%s, line %d] Too many spools.  Max is %d. Abort!", __FILE__, __LINE__, MAX_SPOOLS);
+        }
+
+    memset(&MeerSpool[MeerCounters->SpoolCount], 0, sizeof(_MeerSpool));
+
+    MeerSpool[MeerCounters->SpoolCount].type = type;
+
+    strlcpy(MeerSpool[MeerCounters->SpoolCount].filename, filename, sizeof(MeerSpool[MeerCounters->SpoolCount].filename));
+    strlcpy(MeerSpool[MeerCounters->SpoolCount].interface, interface, sizeof(MeerSpool[MeerCounters->SpoolCount].interface));
+
+    /* dirname() and basename() may modify what they are handed */
+
+    strlcpy(tmp, filename, sizeof(tmp));
+    strlcpy(MeerSpool[MeerCounters->SpoolCount].dir, dirname(tmp), sizeof(MeerSpool[MeerCounters->SpoolCount].dir));
+
+    strlcpy(tmp, filename, sizeof(tmp));
+    strlcpy(MeerSpool[MeerCounters->SpoolCount].name, basename(tmp), sizeof(MeerSpool[MeerCounters->SpoolCount].name));
+
+    MeerSpool[MeerCounters->SpoolCount].fd = -1;
+    MeerSpool[MeerCounters->SpoolCount].file_wd = -1;
+    MeerSpool[MeerCounters->SpoolCount].dir_wd = -1;
+
+    Meer_Log(NORMAL, "%s %s [interface: %s]", type == SPOOL_TYPE_SOCKET ? "Listening on socket" : "Following spool", filename, interface);
+
+    if ( spools_ready == true )
+        {
+            Follow_Ready_Spool( &MeerSpool[MeerCounters->SpoolCount] );
+        }
+
+    /* Readers in other threads only look at spools below SpoolCount */
+
+    __sync_fetch_and_add(&MeerCounters->SpoolCount, 1);
+
+}
+
+/* Add every file a glob matches.  Returns how many spools were added. */
+
+static uint32_t Follow_Glob( struct _FollowGlob *Glob )
+{
+
+    glob_t globbuf;
+    size_t g = 0;
+    uint32_t count = MeerCounters->SpoolCount;
+
+    if ( glob( Glob->pattern, 0, NULL, &globbuf ) != 0 )
+        {
+            globfree( &globbuf );
+            return(0);
+        }
+
+    for ( g = 0; g < globbuf.gl_pathc; g++ )
+        {
+            Follow_Add_Spool( globbuf.gl_pathv[g], Glob->interface, SPOOL_TYPE_FILE );
+        }
+
+    globfree( &globbuf );
+
+    return( MeerCounters->SpoolCount - count );
+
+}
+
+/* Expand the globs again.  Unless "force" is set (a matching name was
+   created),  at most once a second.  Returns FOLLOW_EVENT_CREATE if a spool
+   was added. */
+
+static int Follow_Glob_All( bool force )
+{
+
+    uint32_t added = 0;
+    uint32_t i = 0;
+
+    if ( FollowGlobCount == 0 || ( force == false && FollowGlobTime == time(NULL) ) )
+        {
+            return(FOLLOW_EVENT_NONE);
+        }
+
+    FollowGlobTime = time(NULL);
+
+    for ( i = 0; i < FollowGlobCount; i++ )
+        {
+            added += Follow_Glob( &FollowGlob[i] );
+        }
+
+    return( added > 0 ? FOLLOW_EVENT_CREATE : FOLLOW_EVENT_NONE );
+
+}
+
+/* Find a spool by name */
+
+struct _MeerSpool *Follow_Get_Spool( const char *filename )
+{
+
+    uint32_t i = 0;
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+            if ( !strcmp( MeerSpool[i].filename, filename ) )
+                {
+                    return( &MeerSpool[i] );
+                }
+        }
+
+    return(NULL);
+}
+
+/* Point everything that cares about "which spool" at this one. */
+
+void Follow_Activate( struct _MeerSpool *Spool )
+{
+
+    if ( ActiveSpool == Spool )
+        {
+            return;
+        }
+
+    MeerWaldo = Spool->waldo;
+
+    ActiveSpool = Spool;
+
+}
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+
+/* Point the SQL sensor/cid (and interface) at this spool.  Only called by
+   whoever is doing the SQL output,  which may not be the thread reading
+   the spools. */
+
+void Follow_Activate_SQL( struct _MeerSpool *Spool )
+{
+
+    if ( SQLSpool == Spool )
+        {
+            return;
+        }
+
+    /* Spools that share an interface share a sensor,  and so must share
+       the CID counter.  It lives in the first spool with that sensor. */
+
+    if ( SQLSpool != NULL )
+        {
+            SQLSpool->sql_owner->sql_last_cid = MeerOutput->sql_last_cid;
+        }
+
+    /* A spool that showed up after we started,  on an interface we hadn't
+       seen.  Its sensor is looked up here,  on the SQL output's connection. */
+
+    if ( Spool->sql_owner->sql_sensor_id == 0 )
+        {
+            strlcpy(MeerConfig->interface, Spool->interface, sizeof(MeerConfig->interface));
+
+            Spool->sql_owner->sql_sensor_id = SQL_Get_Sensor_ID();
+            MeerOutput->sql_sensor_id = Spool->sql_owner->sql_sensor_id;
+            Spool->sql_owner->sql_last_cid = SQL_Get_Last_CID() + 1;
+        }
+
+    MeerOutput->sql_sensor_id = Spool->sql_owner->sql_sensor_id;
+    MeerOutput->sql_last_cid = Spool->sql_owner->sql_last_cid;
+
+    strlcpy(MeerConfig->interface, Spool->interface, sizeof(MeerConfig->interface));
+
+    SQLSpool = Spool;
+
+}
+
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+/* Watch a directory for new files.  Watching the same directory twice hands
+   back the same watch.  If we can't,  everything falls back to polling. */
+
+static int Follow_Watch_Dir( const char *dir )
+{
+
+    int wd = -1;
+
+    if ( inotify_fd == -1 )
+        {
+            return(-1);
+        }
+
+    if (( wd = inotify_add_watch( inotify_fd, dir, IN_CREATE | IN_MOVED_TO ) ) == -1 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot watch directory %s [%s]. Falling back to polling.", __FILE__, __LINE__, dir, strerror(errno));
+            close(inotify_fd);
+            inotify_fd = -1;
+        }
+
+    return(wd);
+
+}
+
+#endif
+
+/* Set up a spool a glob found after Init_Follow().  It isn't in SpoolCount
+   yet,  so no other thread is looking at it. */
+
+static void Follow_Ready_Spool( struct _MeerSpool *Spool )
+{
+
+    uint32_t s = Spool - MeerSpool;
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+    uint32_t i = 0;
+#endif
+
+    Spool->waldo = Waldo_Get( Spool->filename, s == 0 );
+    Spool->cursor = Waldo_Get_Cursors( Spool->waldo );
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+
+    /* A sensor_id of 0 is looked up by Follow_Activate_SQL() */
+
+    if ( MeerOutput->sql_enabled == true )
+        {
+
+            Spool->sql_owner = Spool;
+
+            for ( i = 0; i < s; i++ )
+                {
+                    if ( !strcmp( MeerSpool[i].interface, Spool->interface ) )
+                        {
+                            Spool->sql_owner = MeerSpool[i].sql_owner;
+                            break;
+                        }
+                }
+        }
+
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+    Spool->dir_wd = Follow_Watch_Dir( Spool->dir );
+#endif
+
+    Pipeline_Add_Spool( s );
+
+    /* So Follow_Spool() opens it */
+
+    Spool->events = FOLLOW_EVENT_CREATE;
+
+}
+
+void Init_Follow( void )
+{
+
+    char list[4096] = { 0 };
+    char default_interface[64] = { 0 };
+
+    char *ptr = NULL;
+    char *tok = NULL;
+    char *interface = NULL;
+    char *slash = NULL;
+    char tmp[256] = { 0 };
+
+    uint32_t i = 0;
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+    uint32_t g = 0;
+#endif
+
+    read_buf_size = FOLLOW_READ_SIZE;
+
+    if (( MeerSpool = calloc( MAX_SPOOLS, sizeof(_MeerSpool) ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _MeerSpool. Abort!", __FILE__, __LINE__);
+        }
+
+    if (( read_buf = malloc( read_buf_size + 1 ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for spool read buffer. Abort!", __FILE__, __LINE__);
+        }
+
+    /* Build the spool list.  Entries are "file[:interface]" or "glob[:interface]" */
+
+    strlcpy(default_interface, MeerConfig->interface, sizeof(default_interface));
+    strlcpy(list, MeerConfig->follow_file, sizeof(list));
+
+    ptr = strtok_r(list, ",", &tok);
+
+    while ( ptr != NULL )
+        {
+
+            Remove_Spaces(ptr);
+
+            slash = strrchr(ptr, '/');
+
+            if ( ( interface = strrchr( slash != NULL ? slash : ptr, ':' ) ) != NULL )
+                {
+                    *interface = '\0';
+                    interface++;
+                }
+            else
+                {
+                    interface = default_interface;
+                }
+
+            if ( strpbrk( ptr, "*?[" ) != NULL )
+                {
+
+                    if ( FollowGlobCount >= FOLLOW_MAX_GLOBS )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Too many globs in 'follow_eve'.  Max is %d. Abort!", __FILE__, __LINE__, FOLLOW_MAX_GLOBS);
+                        }
+
+                    strlcpy(FollowGlob[FollowGlobCount].pattern, ptr, sizeof(FollowGlob[FollowGlobCount].pattern));
+                    strlcpy(FollowGlob[FollowGlobCount].interface, interface, sizeof(FollowGlob[FollowGlobCount].interface));
+
+                    strlcpy(tmp, ptr, sizeof(tmp));
+                    strlcpy(FollowGlob[FollowGlobCount].dir, dirname(tmp), sizeof(FollowGlob[FollowGlobCount].dir));
+
+                    strlcpy(tmp, ptr, sizeof(tmp));
+                    strlcpy(FollowGlob[FollowGlobCount].name, basename(tmp), sizeof(FollowGlob[FollowGlobCount].name));
+
+                    FollowGlob[FollowGlobCount].dir_wd = -1;
+
+                    /* Like a spool that doesn't exist yet,  wait for it */
+
+                    if ( Follow_Glob( &FollowGlob[FollowGlobCount] ) == 0 )
+                        {
+                            Meer_Log(WARN, "No spool files match '%s' yet.  Waiting for them.", ptr);
+                        }
+
+                    FollowGlobCount++;
+
+                }
+            else
+                {
+                    Follow_Add_Spool( ptr, interface, SPOOL_TYPE_FILE );
+                }
+
+            ptr = strtok_r(NULL, ",", &tok);
+        }
+
+    /* Data that comes in over a socket while we're behind is written here,
+       and read back like any other spool. */
+
+    if ( MeerConfig->socket_spool[0] != '\0' )
+        {
+            Follow_Add_Spool( MeerConfig->socket_spool, default_interface, SPOOL_TYPE_FILE );
+        }
+
+    if ( MeerConfig->socket_stream[0] != '\0' )
+        {
+            Follow_Add_Spool( MeerConfig->socket_stream, default_interface, SPOOL_TYPE_SOCKET );
+        }
+
+    if ( MeerConfig->socket_dgram[0] != '\0' )
+        {
+            Follow_Add_Spool( MeerConfig->socket_dgram, default_interface, SPOOL_TYPE_SOCKET );
+        }
+
+    if ( MeerCounters->SpoolCount == 0 && FollowGlobCount == 0 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] No spool files to follow. Abort!", __FILE__, __LINE__);
+        }
+
+    /* Free the waldo records of spools we don't follow anymore before
+       handing records out,  or renamed spools would use them all up */
+
+    Waldo_Release_Unused( MeerSpool, MeerCounters->SpoolCount );
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+            MeerSpool[i].waldo = Waldo_Get( MeerSpool[i].filename, i == 0 );
+            MeerSpool[i].cursor = Waldo_Get_Cursors( MeerSpool[i].waldo );
+        }
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+
+    /* Each interface gets its own row in the SQL "sensor" table */
+
+    if ( MeerOutput->sql_enabled == true )
+        {
+
+            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                {
+
+                    MeerSpool[i].sql_owner = &MeerSpool[i];
+
+                    for ( g = 0; g < i; g++ )
+                        {
+                            if ( !strcmp( MeerSpool[g].interface, MeerSpool[i].interface ) )
+                                {
+                                    MeerSpool[i].sql_owner = MeerSpool[g].sql_owner;
+                                    break;
+                                }
+                        }
+
+                    if ( MeerSpool[i].sql_owner != &MeerSpool[i] )
+                        {
+                            continue;
+                        }
+
+                    /* Init_Output() already looked up the default interface */
+
+                    if ( !strcmp( MeerSpool[i].interface, default_interface ) )
+                        {
+                            MeerSpool[i].sql_sensor_id = MeerOutput->sql_sensor_id;
+                            MeerSpool[i].sql_last_cid = MeerOutput->sql_last_cid;
+                            continue;
+                        }
+
+                    strlcpy(MeerConfig->interface, MeerSpool[i].interface, sizeof(MeerConfig->interface));
+
+                    MeerSpool[i].sql_sensor_id = SQL_Get_Sensor_ID();
+                    MeerOutput->sql_sensor_id = MeerSpool[i].sql_sensor_id;
+                    MeerSpool[i].sql_last_cid = SQL_Get_Last_CID() + 1;
+
+                }
+
+        }
+
+#endif
+
+    if ( MeerCounters->SpoolCount > 0 )
+        {
+            Follow_Activate( &MeerSpool[0] );
+        }
+
+    spools_ready = true;
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+    if (( inotify_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC ) ) == -1 )
+        {
+            Meer_Log(WARN, "[%s, line %d] inotify_init1() failed [%s]. Falling back to polling.", __FILE__, __LINE__, strerror(errno));
+            return;
+        }
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+
+            if ( MeerSpool[i].type != SPOOL_TYPE_FILE )
+                {
+                    continue;
+                }
+
+            if (( MeerSpool[i].dir_wd = Follow_Watch_Dir( MeerSpool[i].dir ) ) == -1 )
+                {
+                    return;
+                }
+        }
+
+    for ( i = 0; i < FollowGlobCount; i++ )
+        {
+
+            /* Can't watch a directory with wildcards in it.  Follow_Wait()
+               globs again when it times out. */
+
+            if ( strpbrk( FollowGlob[i].dir, "*?[" ) != NULL )
+                {
+                    Meer_Log(NORMAL, "New matches for '%s' are looked for every %d seconds.", FollowGlob[i].pattern, FOLLOW_TIMEOUT);
+                    continue;
+                }
+
+            if (( FollowGlob[i].dir_wd = Follow_Watch_Dir( FollowGlob[i].dir ) ) == -1 )
+                {
+                    return;
+                }
+        }
+
+    Meer_Log(NORMAL, "Using inotify to follow spools.");
+
+#else
+
+    Meer_Log(NORMAL, "inotify not available. Polling spools.");
+
+#endif
+
+}
+
+/* Called every time a spool is (re)opened.  inotify watches the inode,
+   not the name,  so after a rotation we need to watch the new file. */
+
+static void Follow_Watch_File( struct _MeerSpool *Spool )
+{
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+    if ( inotify_fd == -1 )
+        {
+            return;
+        }
+
+    if ( Spool->file_wd != -1 )
+        {
+            inotify_rm_watch( inotify_fd, Spool->file_wd );	/* Might already be gone, that's okay */
+        }
+
+    if (( Spool->file_wd = inotify_add_watch( inotify_fd, Spool->filename, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF ) ) == -1 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot watch %s [%s]", __FILE__, __LINE__, Spool->filename, strerror(errno));
+        }
+
+#endif
+
+}
+
+/* How spools are opened.  Punching holes needs write access. */
+
+static int Follow_Open_Flags( void )
+{
+    return( MeerConfig->spool_punch_holes == true ? O_RDWR : O_RDONLY );
+}
+
+/* Called every time a spool is (re)opened */
+
+static void Follow_Advise( struct _MeerSpool *Spool )
+{
+
+    Spool->released = 0;
+
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise( Spool->fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+}
+
+/* Let go of the part of a spool that every output is done with.  The first
+   WALDO_HEAD_SIZE bytes are never punched out,  the waldo uses them to
+   recognize the spool. */
+
+static void Follow_Release( struct _MeerSpool *Spool )
+{
+
+    uint64_t consumed = Pipeline_Consumed( Spool );
+    uint64_t start = Spool->released;
+
+    consumed -= consumed % FOLLOW_RELEASE_SIZE;
+
+    if ( consumed <= start )
+        {
+            return;
+        }
+
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise( Spool->fd, (off_t)start, (off_t)( consumed - start ), POSIX_FADV_DONTNEED );
+#endif
+
+#ifdef HAVE_FALLOCATE
+
+    if ( MeerConfig->spool_punch_holes == true )
+        {
+
+            start = start < WALDO_HEAD_SIZE ? WALDO_HEAD_SIZE : start;
+
+            if ( fallocate( Spool->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)start, (off_t)( consumed - start ) ) == 0 )
+                {
+                    MeerCounters->SpoolPunchedBytes += consumed - start;
+                }
+            else
+                {
+                    Meer_Log(WARN, "Cannot punch holes in %s [%s].  Disabling 'spool_punch_holes'.", Spool->filename, strerror(errno));
+                    MeerConfig->spool_punch_holes = false;
+                }
+        }
+
+#endif
+
+    MeerCounters->SpoolReleasedBytes += consumed - Spool->released;
+    Spool->released = consumed;
+
+}
+
+/* Set every file spool's events */
+
+static void Follow_Set_Events( int events )
+{
+
+    uint32_t i = 0;
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+            MeerSpool[i].events = MeerSpool[i].type == SPOOL_TYPE_FILE ? events : FOLLOW_EVENT_NONE;
+        }
+
+}
+
+/* Block until something happens to a spool.  Each spool's "events" is set
+   to a bitmask of FOLLOW_EVENT_* values.  Returns all of them OR'ed.  Any
+   sockets that become readable while we wait are handled here. */
+
+int Follow_Wait( void )
+{
+
+    struct pollfd pfd[1 + SOCKET_MAX_FDS];
+    int nfds = 0;
+    int socket_nfds = 0;
+    int timeout = 1000;
+
+    uint32_t i = 0;
+    int ret = FOLLOW_EVENT_NONE;
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+    bool glob_flag = false;
+
+    char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+
+    ssize_t len = 0;
+    char *ptr = NULL;
+
+    if ( inotify_fd != -1 )
+        {
+            pfd[nfds].fd = inotify_fd;
+            pfd[nfds].events = POLLIN;
+            pfd[nfds].revents = 0;
+            nfds++;
+
+            timeout = FOLLOW_TIMEOUT * 1000;
+        }
+
+#endif
+
+    socket_nfds = Input_Socket_Fds( &pfd[nfds], SOCKET_MAX_FDS );
+
+    /* No inotify and no sockets,  the old fashioned way */
+
+    if ( nfds + socket_nfds == 0 )
+        {
+            sleep(1);
+            Follow_Set_Events( FOLLOW_EVENT_TIMEOUT );
+            Follow_Glob_All( false );
+            return(FOLLOW_EVENT_TIMEOUT);
+        }
+
+    Follow_Set_Events( FOLLOW_EVENT_NONE );
+
+    if ( poll( pfd, nfds + socket_nfds, timeout ) <= 0 )
+        {
+
+            /* Timeout or interrupted by a signal (SIGUSR1, etc).  Let the
+               caller take a look anyways */
+
+            Follow_Set_Events( FOLLOW_EVENT_TIMEOUT );
+            Follow_Glob_All( false );
+            return(FOLLOW_EVENT_TIMEOUT);
+        }
+
+    if ( socket_nfds > 0 )
+        {
+            Input_Socket_Read( &pfd[nfds], socket_nfds );
+        }
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+    if ( inotify_fd != -1 && ( pfd[0].revents & POLLIN ) )
+        {
+
+            while ( ( len = read( inotify_fd, events, sizeof(events) ) ) > 0 )
+                {
+
+                    for ( ptr = events; ptr < events + len; ptr += sizeof(struct inotify_event) + event->len )
+                        {
+
+                            event = (const struct inotify_event *) ptr;
+
+                            /* A new file a glob might match */
+
+                            for ( i = 0; i < FollowGlobCount; i++ )
+                                {
+                                    if ( event->wd == FollowGlob[i].dir_wd && event->len > 0 &&
+                                            ( event->mask & ( IN_CREATE | IN_MOVED_TO ) ) &&
+                                            fnmatch( FollowGlob[i].name, event->name, 0 ) == 0 )
+                                        {
+                                            glob_flag = true;
+                                        }
+                                }
+
+                            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                                {
+
+                                    if ( MeerSpool[i].type != SPOOL_TYPE_FILE )
+                                        {
+                                            continue;
+                                        }
+
+                                    if ( event->wd == MeerSpool[i].file_wd )
+                                        {
+
+                                            if ( event->mask & IN_MODIFY )
+                                                {
+                                                    MeerSpool[i].events |= FOLLOW_EVENT_MODIFY;
+                                                }
+
+                                            if ( event->mask & ( IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED ) )
+                                                {
+                                                    MeerSpool[i].events |= FOLLOW_EVENT_GONE;
+                                                }
+
+                                        }
+
+                                    else if ( event->wd == MeerSpool[i].dir_wd && event->len > 0 && !strcmp( event->name, MeerSpool[i].name ) )
+                                        {
+                                            MeerSpool[i].events |= FOLLOW_EVENT_CREATE;
+                                        }
+
+                                    ret |= MeerSpool[i].events;
+
+                                }
+
+                        }
+                }
+
+            if ( glob_flag == true )
+                {
+                    ret |= Follow_Glob_All( true );
+                }
+
+            /* FOLLOW_EVENT_NONE means the events were for names we don't care about */
+
+            return(ret);
+
+        }
+
+    if ( inotify_fd != -1 )
+        {
+            return(FOLLOW_EVENT_NONE);	/* Only socket activity */
+        }
+
+#endif
+
+    /* Polling,  but we woke up for a socket.  Look at the files anyways. */
+
+    Follow_Set_Events( FOLLOW_EVENT_TIMEOUT );
+    Follow_Glob_All( false );
+    return(FOLLOW_EVENT_TIMEOUT);
+
+}
+
+/* Read and decode every complete line currently available in a spool.
+   Returns the number of bytes consumed.  A trailing partial line is left
+   in the file for next time,  unless "final" is set (the spool has been
+   rotated away and nothing more is coming). */
+
+static uint64_t Follow_Read( struct _MeerSpool *Spool, bool final )
+{
+
+    uint64_t bytes = 0;
+    size_t read_buf_len = 0;
+    ssize_t ret = 0;
+    off_t offset = lseek( Spool->fd, 0, SEEK_CUR );
+
+    char *start = NULL;
+    char *end = NULL;
+    char *nl = NULL;
+
+    Follow_Activate( Spool );
+
+    while ( 1 )
+        {
+
+            /* A single line is larger than our buffer.  Make room rather than
+               splitting it. */
+
+            if ( read_buf_len == read_buf_size )
+                {
+
+                    read_buf_size *= 2;
+
+                    if (( read_buf = realloc( read_buf, read_buf_size + 1 ) ) == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for spool read buffer. Abort!", __FILE__, __LINE__);
+                        }
+
+                    Meer_Log(NORMAL, "Spool read buffer increased to %zu bytes.", read_buf_size);
+                }
+
+            ret = read( Spool->fd, read_buf + read_buf_len, read_buf_size - read_buf_len );
+
+            if ( ret < 0 )
+                {
+
+                    if ( errno == EINTR )
+                        {
+                            continue;
+                        }
+
+                    Meer_Log(WARN, "[%s, line %d] Error reading %s [%s]", __FILE__, __LINE__, Spool->filename, strerror(errno));
+                    break;
+                }
+
+            if ( ret == 0 )
+                {
+                    break;	/* EOF */
+                }
+
+            offset += ret;
+
+#ifdef HAVE_POSIX_FADVISE
+
+            /* Filled the buffer,  so there's likely more.  We're catching up. */
+
+            if ( (size_t)ret == read_buf_size - read_buf_len )
+                {
+                    posix_fadvise( Spool->fd, offset, FOLLOW_READAHEAD, POSIX_FADV_WILLNEED );
+                }
+
+#endif
+
+            read_buf_len += ret;
+
+            start = read_buf;
+            end = read_buf + read_buf_len;
+
+            while ( start < end && ( nl = memchr( start, '\n', end - start ) ) != NULL )
+                {
+                    Pipeline_Line( Spool, start, nl - start, ( nl - start ) + 1 );
+                    bytes += ( nl - start ) + 1;
+                    start = nl + 1;
+                }
+
+            /* Hold on to any partial line until the rest of it shows up */
+
+            read_buf_len = end - start;
+
+            if ( read_buf_len > 0 && start != read_buf )
+                {
+                    memmove( read_buf, start, read_buf_len );
+                }
+
+        }
+
+    if ( read_buf_len > 0 )
+        {
+
+            if ( final == true )
+                {
+
+                    /* Suricata always ends a record with a \n,  but if the old spool
+                       ends with a partial line,  this is our last chance to look at it. */
+
+                    Pipeline_Line( Spool, read_buf, read_buf_len, read_buf_len );
+                    bytes += read_buf_len;
+
+                }
+
+            /* Leave the partial line in the file.  We'll read it again when
+               the rest of it has been written. */
+
+            else if ( lseek( Spool->fd, -(off_t)read_buf_len, SEEK_CUR ) == -1 )
+                {
+                    Meer_Log(ERROR, "Cannot seek in %s [%s]. Abort!", Spool->filename, strerror(errno));
+                }
+
+        }
+
+    Waldo_Update_Head( Spool->fd );
+    Follow_Release( Spool );
+
+    return(bytes);
+}
+
+/* Used when we can't seek by byte offset.  Counts "lines" new lines from the
+   top of the spool,  leaving the file offset (and waldo offset) just after
+   the last one.  Returns the number of lines found. */
+
+static uint64_t Follow_Skip_Lines( struct _MeerSpool *Spool, uint64_t lines )
+{
+
+    uint64_t linecount = 0;
+    ssize_t ret = 0;
+
+    char *start = NULL;
+    char *end = NULL;
+    char *nl = NULL;
+
+    MeerWaldo->offset = 0;
+
+    while ( linecount < lines && ( ret = read( Spool->fd, read_buf, read_buf_size ) ) > 0 )
+        {
+
+            start = read_buf;
+            end = read_buf + ret;
+
+            while ( linecount < lines && ( nl = memchr( start, '\n', end - start ) ) != NULL )
+                {
+                    linecount++;
+                    start = nl + 1;
+                }
+
+            MeerWaldo->offset += ( linecount < lines ) ? (uint64_t)ret : (uint64_t)( start - read_buf );
+
+        }
+
+    if ( lseek( Spool->fd, (off_t)MeerWaldo->offset, SEEK_SET ) == -1 )
+        {
+            Meer_Log(ERROR, "Cannot seek to offset %" PRIu64 " in %s [%s]. Abort!", MeerWaldo->offset, Spool->filename, strerror(errno));
+        }
+
+    return(linecount);
+}
+
+/* Skip to where we left off in a freshly opened spool and read in everything
+   up to its current end. */
+
+static void Follow_Resume_Spool( struct _MeerSpool *Spool )
+{
+
+    struct stat st;
+    uint64_t linecount = 0;
+
+    Follow_Activate( Spool );
+
+    /* If the waldo has a byte offset for this very spool,  jump straight to it.
+       Otherwise (old waldo,  different file) count lines like we used to. */
+
+    if ( Waldo_Check_Spool( Spool->fd ) == true )
+        {
+
+            Meer_Log(NORMAL, "Skipping to record %" PRIu64 " (byte offset %" PRIu64 ") in %s", MeerWaldo->position, MeerWaldo->offset, Spool->filename);
+
+            if ( lseek(Spool->fd, (off_t)MeerWaldo->offset, SEEK_SET) == -1 )
+                {
+                    Meer_Log(ERROR, "Cannot seek to offset %" PRIu64 " in %s [%s]. Abort!", MeerWaldo->offset, Spool->filename, strerror(errno));
+                }
+
+            Meer_Log(NORMAL, "Reached target record of %" PRIu64 ".  Processing new records.", MeerWaldo->position);
+
+        }
+
+    else if ( MeerWaldo->position != 0 )
+        {
+
+            Meer_Log(NORMAL, "Skipping to record %" PRIu64 " in %s", MeerWaldo->position, Spool->filename);
+
+            linecount = Follow_Skip_Lines( Spool, MeerWaldo->position );
+
+            /* If our Waldo is > than our line count,  the file was likely truncated while Meer was
+               "offline".  Reset the Waldo,  and inform the user.  On restart, we'll treat the spool
+               as a new file. */
+
+            if ( MeerWaldo->position > linecount )
+                {
+
+                    Meer_Log(WARN, "Spool might have been truncated!  Resetting Waldo to zero and aborting.");
+                    MeerWaldo->position = 0;
+                    MeerWaldo->offset = 0;
+                    MeerWaldo->inode = 0;
+                    Signal_Handler(SIGTERM);
+
+                }
+
+            Meer_Log(NORMAL, "Reached target record of %" PRIu64 ".  Processing new records.", MeerWaldo->position);
+
+            Waldo_Set_Spool( Spool->fd );
+
+        }
+    else
+        {
+
+            Meer_Log(NORMAL, "Ingesting data from %s. Working........", Spool->filename);
+
+            MeerWaldo->offset = 0;
+            Waldo_Set_Spool( Spool->fd );
+
+        }
+
+    Follow_Read( Spool, false );
+    Pipeline_Flush();
+
+    Meer_Log(NORMAL, "Read in %" PRIu64 " lines from %s", MeerWaldo->position, Spool->filename);
+
+    if (fstat(Spool->fd, &st))
+        {
+            Meer_Log(ERROR, "Cannot 'stat' spool file '%s' [%s]  Abort!", Spool->filename, strerror(errno));
+        }
+
+    Spool->old_size = (uint64_t) st.st_size;
+
+}
+
+/* Try to open a spool that we don't have open yet.  Returns true if we did. */
+
+static bool Follow_Open_Spool( struct _MeerSpool *Spool )
+{
+
+    if (( Spool->fd = open(Spool->filename, Follow_Open_Flags()) ) == -1 )
+        {
+            return(false);
+        }
+
+    Follow_Watch_File( Spool );
+    Follow_Advise( Spool );
+
+    Meer_Log(NORMAL, "Successfully opened %s.", Spool->filename);
+
+    return(true);
+
+}
+
+/* Open the spools.  Wait until at least one of them exists. */
+
+void Follow_Open( void )
+{
+
+    bool wait_flag = false;
+    bool opened = false;
+    bool files = FollowGlobCount > 0;
+    uint32_t i = 0;
+
+    while ( opened == false )
+        {
+
+            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                {
+
+                    if ( MeerSpool[i].type != SPOOL_TYPE_FILE )
+                        {
+                            continue;
+                        }
+
+                    files = true;
+
+                    if ( MeerSpool[i].fd == -1 && Follow_Open_Spool( &MeerSpool[i] ) == true )
+                        {
+                            opened = true;
+                        }
+
+                }
+
+            /* Only sockets,  nothing to wait on */
+
+            if ( files == false )
+                {
+                    return;
+                }
+
+            if ( opened == false )
+                {
+
+                    if ( wait_flag == false )
+                        {
+                            Meer_Log(NORMAL, "Waiting on spool file(s) %s.....", MeerConfig->follow_file);
+                            wait_flag = true;
+                        }
+
+                    Follow_Wait();
+                }
+        }
+
+}
+
+/* Skip to where we left off in every open spool */
+
+void Follow_Resume( void )
+{
+
+    uint32_t i = 0;
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+
+            if ( MeerSpool[i].type != SPOOL_TYPE_FILE )
+                {
+                    continue;
+                }
+
+            if ( MeerSpool[i].fd != -1 )
+                {
+                    Follow_Resume_Spool( &MeerSpool[i] );
+                }
+            else
+                {
+                    Meer_Log(NORMAL, "Waiting on spool file %s.....", MeerSpool[i].filename);
+                }
+        }
+
+}
+
+/* The spool name now points at a new file (new_fd).  Drain what's left of
+   the old one,  then switch over. */
+
+static void Follow_Rotate( struct _MeerSpool *Spool, int new_fd )
+{
+
+    MeerCounters->SpoolDrainBytes += Follow_Read( Spool, true );
+    MeerCounters->SpoolRotations++;
+
+    /* Everything from the old spool has to be checkpointed before the
+       waldo is reset */
+
+    Pipeline_Flush();
+
+    close(Spool->fd);
+
+    Spool->fd = new_fd;
+    Follow_Watch_File( Spool );
+    Follow_Advise( Spool );
+
+    Spool->old_size = 0;
+
+    MeerWaldo->position = 0;
+    MeerWaldo->offset = 0;
+    Waldo_Set_Spool( Spool->fd );
+
+    Meer_Log(NORMAL, "Sucessfully re-opened %s.", Spool->filename);
+
+    /* Anything written before the watch was added won't raise IN_MODIFY */
+
+    Follow_Read( Spool, false );
+
+}
+
+/* Start over at the top of a spool (it's been truncated).  input-socket.c
+   also calls this after it empties socket_spool. */
+
+void Follow_Rewind( struct _MeerSpool *Spool )
+{
+
+    Pipeline_Flush();
+
+    if ( lseek(Spool->fd, 0, SEEK_SET) == -1 )
+        {
+            Meer_Log(ERROR, "Cannot rewind %s. [%s]", Spool->filename, strerror(errno) );
+        }
+
+    Follow_Activate( Spool );
+
+    MeerWaldo->position = 0;
+    MeerWaldo->offset = 0;
+    Waldo_Set_Spool( Spool->fd );
+
+    Spool->old_size = 0;
+    Spool->released = 0;
+
+}
+
+/* Something happened to a spool we have open */
+
+static void Follow_Check_Spool( struct _MeerSpool *Spool )
+{
+
+    struct stat st;
+    struct stat st_new;
+
+    int test_fd = -1;
+    uint64_t bytes = 0;
+
+    if (fstat(Spool->fd, &st))
+        {
+            Meer_Log(ERROR, "Cannot 'stat' spool file '%s' [%s]  Abort!", Spool->filename, strerror(errno));
+        }
+
+    /* If the spool file has _shunk_,  it's been truncated.  Same file, so
+       just start over from the top. */
+
+    if ( (uint64_t) st.st_size < Spool->old_size )
+        {
+            Meer_Log(NORMAL, "Spool file Truncated! Re-reading '%s'!", Spool->filename );
+            Follow_Rewind( Spool );
+        }
+
+    /* Read whatever is new.  Even if the spool has been moved or deleted,
+       Suricata may still be writing to it until it re-opens its log. */
+
+    bytes = Follow_Read( Spool, false );
+
+    if ( Spool->gone == true )
+        {
+            MeerCounters->SpoolDrainBytes += bytes;
+        }
+
+    Spool->old_size = (uint64_t) st.st_size;
+
+    if ( Spool->events == FOLLOW_EVENT_MODIFY )
+        {
+            return;
+        }
+
+    /* If the spool file disappears, then we wait to see if a new one
+       shows up.  Suricata might be rotating the alert.json file.  We use to
+       try and "stat" the file but that didn't work.  We use open as a "test"
+       instead. 2020/10/27 - Champ */
+
+    if (( test_fd = open(Spool->filename, Follow_Open_Flags()) ) == -1 )
+        {
+
+            if ( Spool->gone == false )
+                {
+                    Meer_Log(NORMAL, "Follow JSON File '%s' disappeared [%s].", Spool->filename, strerror(errno) );
+                    Meer_Log(NORMAL, "Waiting for new spool file....");
+                    Spool->gone = true;
+                }
+
+            return;
+        }
+
+    if ( fstat(test_fd, &st_new) == 0 &&
+            ( st_new.st_ino != st.st_ino || st_new.st_dev != st.st_dev ) )
+        {
+
+            /* The name now points to a different file than the one we
+               have open.  Switch once the old one is drained. */
+
+            Follow_Rotate( Spool, test_fd );
+            Spool->gone = false;
+            return;
+
+        }
+
+    /* Same file.  Close the test */
+
+    close(test_fd);
+    Spool->gone = false;
+
+}
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+
+/* On shutdown,  record the last CID of every spool's SQL sensor */
+
+void Follow_Record_Last_CID( void )
+{
+
+    uint32_t i = 0;
+
+    if ( MeerCounters->SpoolCount == 0 )
+        {
+            MeerOutput->sql_last_cid++;
+            SQL_Record_Last_CID();
+            return;
+        }
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+
+            /* Sensors that never got an event were never looked up */
+
+            if ( MeerSpool[i].sql_owner != &MeerSpool[i] || MeerSpool[i].sql_sensor_id == 0 )
+                {
+                    continue;
+                }
+
+            Follow_Activate_SQL( &MeerSpool[i] );
+            MeerOutput->sql_last_cid++;
+            SQL_Record_Last_CID();
+        }
+
+}
+
+#endif
+
+/* Main "tail" loop.  Never returns. */
+
+void Follow_Spool( void )
+{
+
+    uint32_t i = 0;
+
+    Meer_Log(NORMAL, "Waiting for new data......");
+
+    while(1)
+        {
+
+            /* Sleep until the kernel tells us something happened to a spool
+               (or FOLLOW_TIMEOUT passes).  Without inotify,  this is sleep(1). */
+
+            if ( Follow_Wait() == FOLLOW_EVENT_NONE )
+                {
+                    continue;
+                }
+
+            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                {
+
+                    if ( MeerSpool[i].type != SPOOL_TYPE_FILE || MeerSpool[i].events == FOLLOW_EVENT_NONE )
+                        {
+                            continue;
+                        }
+
+                    /* A spool that didn't exist when we started has shown up */
+
+                    if ( MeerSpool[i].fd == -1 )
+                        {
+
+                            if ( Follow_Open_Spool( &MeerSpool[i] ) == true )
+                                {
+                                    Follow_Resume_Spool( &MeerSpool[i] );
+                                }
+
+                            continue;
+                        }
+
+                    Follow_Check_Spool( &MeerSpool[i] );
+
+                }
+
+        }
+
+}
@@ -0,0 +1,33 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+void Init_Follow( void );
+void Follow_Activate( struct _MeerSpool *Spool );
+struct _MeerSpool *Follow_Get_Spool( const char *filename );
+void Follow_Rewind( struct _MeerSpool *Spool );
+int  Follow_Wait( void );
+void Follow_Open( void );
+void Follow_Resume( void );
+void Follow_Spool( void );
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+void Follow_Activate_SQL( struct _MeerSpool *Spool );
+void Follow_Record_Last_CID( void );
+#endif
@@ -0,0 +1,724 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Read EVE straight from Suricata/Sagan over a unix socket rather than
+   having it written to disk and read back.  Both the "unix_stream" and
+   "unix_dgram" EVE outputs are supported.  Stream connections are split on
+   newlines just like a spool file.  Datagrams are pulled in batches with
+   recvmmsg() (one event per datagram).
+
+   If "socket_spool" is set and we can't keep up (the socket still has data
+   after SOCKET_SPOOL_BATCHES reads in a row),  new events are appended to that
+   file instead of being decoded.  It's followed like any other spool.  Once
+   it has been read to the end it is truncated and we go back to decoding
+   straight from the socket.  Events are never decoded out of order.  We also
+   spool while an output is behind (pipeline.c),  since it can only catch up
+   on what's in a file. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "follow.h"
+#include "input-socket.h"
+#include "pipeline.h"
+
+struct _MeerConfig *MeerConfig;
+struct _MeerCounters *MeerCounters;
+
+typedef struct _SocketClient _SocketClient;
+struct _SocketClient
+{
+    int fd;
+    char *buf;
+    size_t size;		/* Usable size,  one extra byte is allocated for a \0 */
+    size_t len;
+};
+
+static struct _SocketClient SocketClient[SOCKET_MAX_CLIENTS];
+
+static int stream_fd = -1;
+static int dgram_fd = -1;
+static int spool_fd = -1;
+
+static struct _MeerSpool *StreamSpool = NULL;
+static struct _MeerSpool *DgramSpool = NULL;
+static struct _MeerSpool *SocketSpool = NULL;
+
+static bool spooling = false;
+static uint64_t spool_size = 0;
+
+static char *dgram_buf = NULL;
+static size_t dgram_len[SOCKET_DGRAM_BATCH];
+
+#ifdef HAVE_RECVMMSG
+static struct mmsghdr dgram_msgs[SOCKET_DGRAM_BATCH];
+static struct iovec dgram_iov[SOCKET_DGRAM_BATCH];
+#endif
+
+/* Create,  bind and (for streams) listen on a unix socket */
+
+static int Input_Socket_Listen( const char *path, int type )
+{
+
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd = -1;
+
+    if ( strlen(path) >= sizeof(addr.sun_path) )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Socket path '%s' is too long. Abort!", __FILE__, __LINE__, path);
+        }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+    /* Left over from the last time we ran.  Don't remove anything that
+       isn't a socket! */
+
+    if ( lstat(path, &st) == 0 )
+        {
+
+            if ( !S_ISSOCK(st.st_mode) )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] '%s' exists and isn't a socket. Abort!", __FILE__, __LINE__, path);
+                }
+
+            unlink(path);
+        }
+
+    if (( fd = socket(AF_UNIX, type, 0) ) == -1 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot create socket for %s [%s]. Abort!", __FILE__, __LINE__, path, strerror(errno));
+        }
+
+    if ( bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot bind to %s [%s]. Abort!", __FILE__, __LINE__, path, strerror(errno));
+        }
+
+    if ( type == SOCK_STREAM && listen(fd, SOCKET_MAX_CLIENTS) == -1 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot listen on %s [%s]. Abort!", __FILE__, __LINE__, path, strerror(errno));
+        }
+
+    if ( fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot set %s non-blocking [%s]. Abort!", __FILE__, __LINE__, path, strerror(errno));
+        }
+
+    return(fd);
+
+}
+
+void Init_Input_Socket( void )
+{
+
+    struct stat st;
+    int size = SOCKET_BUFFER_SIZE;
+    int i = 0;
+
+    for ( i = 0; i < SOCKET_MAX_CLIENTS; i++ )
+        {
+            SocketClient[i].fd = -1;
+        }
+
+    if ( MeerConfig->socket_stream[0] == '\0' && MeerConfig->socket_dgram[0] == '\0' )
+        {
+            return;
+        }
+
+    if ( MeerConfig->socket_stream[0] != '\0' )
+        {
+            StreamSpool = Follow_Get_Spool( MeerConfig->socket_stream );
+            stream_fd = Input_Socket_Listen( MeerConfig->socket_stream, SOCK_STREAM );
+        }
+
+    if ( MeerConfig->socket_dgram[0] != '\0' )
+        {
+
+            DgramSpool = Follow_Get_Spool( MeerConfig->socket_dgram );
+            dgram_fd = Input_Socket_Listen( MeerConfig->socket_dgram, SOCK_DGRAM );
+
+            /* Give bursts somewhere to go.  Datagrams that don't fit are
+               dropped by the kernel. */
+
+            if ( setsockopt(dgram_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == -1 )
+                {
+                    Meer_Log(WARN, "[%s, line %d] Cannot set receive buffer on %s [%s]", __FILE__, __LINE__, MeerConfig->socket_dgram, strerror(errno));
+                }
+
+            if (( dgram_buf = malloc( SOCKET_DGRAM_BATCH * ( SOCKET_DGRAM_SIZE + 1 ) ) ) == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for datagram buffer. Abort!", __FILE__, __LINE__);
+                }
+
+#ifdef HAVE_RECVMMSG
+
+            for ( i = 0; i < SOCKET_DGRAM_BATCH; i++ )
+                {
+                    dgram_iov[i].iov_base = dgram_buf + ( i * ( SOCKET_DGRAM_SIZE + 1 ) );
+                    dgram_iov[i].iov_len = SOCKET_DGRAM_SIZE;
+                    dgram_msgs[i].msg_hdr.msg_iov = &dgram_iov[i];
+                    dgram_msgs[i].msg_hdr.msg_iovlen = 1;
+                }
+
+#endif
+
+        }
+
+    if ( MeerConfig->socket_spool[0] != '\0' )
+        {
+
+            SocketSpool = Follow_Get_Spool( MeerConfig->socket_spool );
+
+            if (( spool_fd = open(MeerConfig->socket_spool, O_WRONLY | O_CREAT | O_APPEND, 0600) ) == -1 )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Cannot open socket_spool %s [%s]. Abort!", __FILE__, __LINE__, MeerConfig->socket_spool, strerror(errno));
+                }
+
+            if ( fstat(spool_fd, &st) == -1 )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Cannot 'stat' socket_spool %s [%s]. Abort!", __FILE__, __LINE__, MeerConfig->socket_spool, strerror(errno));
+                }
+
+            /* Anything left over from last time has to be read before we
+               decode anything new from the sockets. */
+
+            spool_size = (uint64_t) st.st_size;
+            spooling = spool_size > 0 ? true : false;
+
+        }
+
+}
+
+/* Fill in "pfd" with the descriptors that need to be polled.  Returns how
+   many were added. */
+
+int Input_Socket_Fds( struct pollfd *pfd, int max )
+{
+
+    int nfds = 0;
+    int i = 0;
+
+    if ( stream_fd != -1 && nfds < max )
+        {
+            pfd[nfds].fd = stream_fd;
+            pfd[nfds].events = POLLIN;
+            pfd[nfds].revents = 0;
+            nfds++;
+        }
+
+    if ( dgram_fd != -1 && nfds < max )
+        {
+            pfd[nfds].fd = dgram_fd;
+            pfd[nfds].events = POLLIN;
+            pfd[nfds].revents = 0;
+            nfds++;
+        }
+
+    for ( i = 0; i < SOCKET_MAX_CLIENTS && nfds < max; i++ )
+        {
+
+            if ( SocketClient[i].fd != -1 )
+                {
+                    pfd[nfds].fd = SocketClient[i].fd;
+                    pfd[nfds].events = POLLIN;
+                    pfd[nfds].revents = 0;
+                    nfds++;
+                }
+        }
+
+    return(nfds);
+
+}
+
+/* We've fallen behind.  Returns false if there is nowhere to spool to. */
+
+static bool Input_Socket_Start_Spool( void )
+{
+
+    if ( spool_fd == -1 )
+        {
+            return(false);
+        }
+
+    if ( spooling == false )
+        {
+            Meer_Log(NORMAL, "Falling behind on sockets.  Spooling to %s.", MeerConfig->socket_spool);
+            MeerCounters->SocketSpools++;
+            spooling = true;
+        }
+
+    return(true);
+
+}
+
+/* Once socket_spool has been read to the end,  empty it and go back to
+   decoding straight from the sockets. */
+
+static void Input_Socket_Check_Spool( void )
+{
+
+    if ( spooling == false || SocketSpool->fd == -1 || SocketSpool->waldo->offset < spool_size || Pipeline_Lagging() == true )
+        {
+            return;
+        }
+
+    if ( ftruncate(spool_fd, 0) == -1 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot truncate %s [%s]", __FILE__, __LINE__, MeerConfig->socket_spool, strerror(errno));
+            return;
+        }
+
+    Follow_Rewind( SocketSpool );
+
+    spool_size = 0;
+    spooling = false;
+
+    Meer_Log(NORMAL, "Caught up on %s.  Reading sockets directly.", MeerConfig->socket_spool);
+
+}
+
+/* Append to socket_spool.  It's a regular file,  so a short write means
+   the disk is full or something worse. */
+
+static void Input_Socket_Spool( struct iovec *iov, int iovcnt, size_t bytes )
+{
+
+    ssize_t ret = 0;
+
+    while ( ( ret = writev( spool_fd, iov, iovcnt ) ) == -1 && errno == EINTR );
+
+    if ( ret != (ssize_t) bytes )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot write to %s [%s]. Abort!", __FILE__, __LINE__, MeerConfig->socket_spool, ret == -1 ? strerror(errno) : "short write");
+        }
+
+    spool_size += bytes;
+    MeerCounters->SocketSpooled += bytes;
+
+}
+
+/* Decode one event from a socket */
+
+static void Input_Socket_Line( struct _MeerSpool *Spool, char *line, size_t len )
+{
+
+    Pipeline_Line( Spool, line, len, len + 1 );
+
+}
+
+/* Handle the complete lines in a stream connection's buffer.  With "final"
+   (connection closed),  whatever is left over is treated as a line. */
+
+static void Input_Socket_Client_Lines( struct _SocketClient *Client, bool final )
+{
+
+    struct iovec iov[2];
+
+    char *start = Client->buf;
+    char *end = Client->buf + Client->len;
+    char *nl = NULL;
+
+    if ( spooling == true )
+        {
+
+            /* Everything up to the last \n goes out in one write */
+
+            if (( nl = memrchr( start, '\n', end - start ) ) != NULL )
+                {
+                    iov[0].iov_base = start;
+                    iov[0].iov_len = ( nl - start ) + 1;
+                    Input_Socket_Spool( iov, 1, iov[0].iov_len );
+                    start = nl + 1;
+                }
+
+            if ( final == true && start < end )
+                {
+                    iov[0].iov_base = start;
+                    iov[0].iov_len = end - start;
+                    iov[1].iov_base = "\n";
+                    iov[1].iov_len = 1;
+                    Input_Socket_Spool( iov, 2, iov[0].iov_len + 1 );
+                    start = end;
+                }
+
+        }
+
+    else
+        {
+
+            while ( start < end && ( nl = memchr( start, '\n', end - start ) ) != NULL )
+                {
+                    Input_Socket_Line( StreamSpool, start, nl - start );
+                    start = nl + 1;
+                }
+
+            if ( final == true && start < end )
+                {
+                    Input_Socket_Line( StreamSpool, start, end - start );
+                    start = end;
+                }
+
+        }
+
+    /* Hold on to any partial line until the rest of it shows up */
+
+    Client->len = end - start;
+
+    if ( Client->len > 0 && start != Client->buf )
+        {
+            memmove( Client->buf, start, Client->len );
+        }
+
+}
+
+static void Input_Socket_Close( struct _SocketClient *Client )
+{
+
+    Input_Socket_Client_Lines( Client, true );
+
+    close( Client->fd );
+    free( Client->buf );
+
+    Client->fd = -1;
+    Client->buf = NULL;
+
+}
+
+static void Input_Socket_Accept( void )
+{
+
+    int fd = -1;
+    int i = 0;
+
+    while ( ( fd = accept( stream_fd, NULL, NULL ) ) != -1 )
+        {
+
+            for ( i = 0; i < SOCKET_MAX_CLIENTS; i++ )
+                {
+                    if ( SocketClient[i].fd == -1 )
+                        {
+                            break;
+                        }
+                }
+
+            if ( i == SOCKET_MAX_CLIENTS )
+                {
+                    Meer_Log(WARN, "[%s, line %d] Too many connections on %s.  Max is %d.", __FILE__, __LINE__, MeerConfig->socket_stream, SOCKET_MAX_CLIENTS);
+                    close(fd);
+                    continue;
+                }
+
+            if ( fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1 )
+                {
+                    Meer_Log(WARN, "[%s, line %d] Cannot set connection non-blocking [%s]", __FILE__, __LINE__, strerror(errno));
+                    close(fd);
+                    continue;
+                }
+
+            SocketClient[i].size = SOCKET_BUFFER_SIZE;
+            SocketClient[i].len = 0;
+
+            if (( SocketClient[i].buf = malloc( SocketClient[i].size + 1 ) ) == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for socket buffer. Abort!", __FILE__, __LINE__);
+                }
+
+            SocketClient[i].fd = fd;
+
+            Meer_Log(NORMAL, "New connection on %s.", MeerConfig->socket_stream);
+
+        }
+
+}
+
+/* Read from a stream connection until it's empty.  If it still isn't
+   empty after SOCKET_SPOOL_BATCHES reads,  we're behind. */
+
+static void Input_Socket_Client( struct _SocketClient *Client )
+{
+
+    ssize_t ret = 0;
+    int batches = 0;
+
+    for ( batches = 0; batches < SOCKET_SPOOL_BATCHES * 2; batches++ )
+        {
+
+            if ( batches == SOCKET_SPOOL_BATCHES && Input_Socket_Start_Spool() == false )
+                {
+                    break;	/* Nowhere to put it.  Give the spools a turn. */
+                }
+
+            /* A single line is larger than our buffer */
+
+            if ( Client->len == Client->size )
+                {
+
+                    Client->size *= 2;
+
+                    if (( Client->buf = realloc( Client->buf, Client->size + 1 ) ) == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for socket buffer. Abort!", __FILE__, __LINE__);
+                        }
+
+                }
+
+            ret = read( Client->fd, Client->buf + Client->len, Client->size - Client->len );
+
+            if ( ret < 0 )
+                {
+
+                    if ( errno == EINTR )
+                        {
+                            continue;
+                        }
+
+                    if ( errno == EAGAIN || errno == EWOULDBLOCK )
+                        {
+                            break;
+                        }
+
+                    Meer_Log(WARN, "[%s, line %d] Error reading from %s [%s]", __FILE__, __LINE__, MeerConfig->socket_stream, strerror(errno));
+                    Input_Socket_Close( Client );
+                    break;
+                }
+
+            if ( ret == 0 )
+                {
+                    Meer_Log(NORMAL, "Connection on %s closed.", MeerConfig->socket_stream);
+                    Input_Socket_Close( Client );
+                    break;
+                }
+
+            Client->len += ret;
+            Input_Socket_Client_Lines( Client, false );
+
+        }
+
+}
+
+/* Pull in up to SOCKET_DGRAM_BATCH datagrams.  Returns how many. */
+
+static int Input_Socket_Recv( void )
+{
+
+    int n = 0;
+
+#ifdef HAVE_RECVMMSG
+
+    int i = 0;
+
+    for ( i = 0; i < SOCKET_DGRAM_BATCH; i++ )
+        {
+            dgram_msgs[i].msg_hdr.msg_flags = 0;
+        }
+
+    while ( ( n = recvmmsg( dgram_fd, dgram_msgs, SOCKET_DGRAM_BATCH, MSG_DONTWAIT, NULL ) ) == -1 && errno == EINTR );
+
+    for ( i = 0; i < n; i++ )
+        {
+
+            dgram_len[i] = dgram_msgs[i].msg_len;
+
+            if ( dgram_msgs[i].msg_hdr.msg_flags & MSG_TRUNC )
+                {
+                    Meer_Log(WARN, "[%s, line %d] Datagram on %s larger than %d bytes. Skipping.", __FILE__, __LINE__, MeerConfig->socket_dgram, SOCKET_DGRAM_SIZE);
+                    dgram_len[i] = 0;
+                }
+        }
+
+#else
+
+    ssize_t ret = 0;
+
+    for ( n = 0; n < SOCKET_DGRAM_BATCH; n++ )
+        {
+
+            while ( ( ret = recv( dgram_fd, dgram_buf + ( n * ( SOCKET_DGRAM_SIZE + 1 ) ), SOCKET_DGRAM_SIZE, MSG_DONTWAIT ) ) == -1 && errno == EINTR );
+
+            if ( ret < 0 )
+                {
+                    break;
+                }
+
+            dgram_len[n] = ret;
+        }
+
+#endif
+
+    if ( n < 0 && errno != EAGAIN && errno != EWOULDBLOCK )
+        {
+            Meer_Log(WARN, "[%s, line %d] Error reading from %s [%s]", __FILE__, __LINE__, MeerConfig->socket_dgram, strerror(errno));
+        }
+
+    return( n < 0 ? 0 : n );
+
+}
+
+static void Input_Socket_Dgram( void )
+{
+
+    struct iovec iov[SOCKET_DGRAM_BATCH * 2];
+    size_t bytes = 0;
+    int iovcnt = 0;
+
+    char *start = NULL;
+    char *end = NULL;
+    char *nl = NULL;
+
+    int batches = 0;
+    int n = 0;
+    int i = 0;
+
+    for ( batches = 0; batches < SOCKET_SPOOL_BATCHES * 2; batches++ )
+        {
+
+            if ( batches == SOCKET_SPOOL_BATCHES && Input_Socket_Start_Spool() == false )
+                {
+                    break;	/* Nowhere to put it.  Give the spools a turn. */
+                }
+
+            if ( ( n = Input_Socket_Recv() ) == 0 )
+                {
+                    break;
+                }
+
+            bytes = 0;
+            iovcnt = 0;
+
+            for ( i = 0; i < n; i++ )
+                {
+
+                    start = dgram_buf + ( i * ( SOCKET_DGRAM_SIZE + 1 ) );
+                    end = start + dgram_len[i];
+
+                    if ( start < end && end[-1] == '\n' )
+                        {
+                            end--;
+                        }
+
+                    if ( start == end )
+                        {
+                            continue;
+                        }
+
+                    if ( spooling == true )
+                        {
+                            iov[iovcnt].iov_base = start;
+                            iov[iovcnt++].iov_len = end - start;
+                            iov[iovcnt].iov_base = "\n";
+                            iov[iovcnt++].iov_len = 1;
+                            bytes += ( end - start ) + 1;
+                            continue;
+                        }
+
+                    /* Normally one event per datagram,  but be safe */
+
+                    while ( start < end && ( nl = memchr( start, '\n', end - start ) ) != NULL )
+                        {
+                            Input_Socket_Line( DgramSpool, start, nl - start );
+                            start = nl + 1;
+                        }
+
+                    if ( start < end )
+                        {
+                            Input_Socket_Line( DgramSpool, start, end - start );
+                        }
+
+                }
+
+            if ( iovcnt > 0 )
+                {
+                    Input_Socket_Spool( iov, iovcnt, bytes );
+                }
+
+        }
+
+}
+
+/* Called from Follow_Wait() after poll() with the descriptors from
+   Input_Socket_Fds() */
+
+void Input_Socket_Read( struct pollfd *pfd, int nfds )
+{
+
+    int i = 0;
+    int c = 0;
+
+    /* An output that is behind can only catch up on what's in a file */
+
+    if ( Pipeline_Lagging() == true )
+        {
+            Input_Socket_Start_Spool();
+        }
+
+    Input_Socket_Check_Spool();
+
+    for ( i = 0; i < nfds; i++ )
+        {
+
+            if ( pfd[i].revents == 0 )
+                {
+                    continue;
+                }
+
+            if ( pfd[i].fd == stream_fd )
+                {
+                    Input_Socket_Accept();
+                    continue;
+                }
+
+            if ( pfd[i].fd == dgram_fd )
+                {
+                    Input_Socket_Dgram();
+                    continue;
+                }
+
+            for ( c = 0; c < SOCKET_MAX_CLIENTS; c++ )
+                {
+                    if ( SocketClient[c].fd == pfd[i].fd )
+                        {
+                            Input_Socket_Client( &SocketClient[c] );
+                            break;
+                        }
+                }
+
+        }
+
+}
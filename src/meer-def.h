@@ -49,6 +49,29 @@
 #define IPv6		6
 
 #define DNS_CACHE_DEFAULT	900
+#define DNS_CACHE_SIZE_DEFAULT	65536		/* Entries */
+#define DNS_NEGATIVE_CACHE_DEFAULT 60		/* Seconds */
+#define DNS_CACHE_NONE		0xffffffff
+#define DNS_THREADS_DEFAULT	4
+#define DNS_MAX_THREADS		64
+#define DNS_WAIT_DEFAULT	0		/* ms to hold an event for its PTR.  0 == don't */
+#define DNS_QUEUE_SIZE		4096		/* Lookups waiting for a resolver thread */
+#define DNS_SNAPSHOT_MAGIC	0x4d444e53	/* "MDNS" */
+#define DNS_SNAPSHOT_VERSION	1
+#define DNS_SNAPSHOT_INTERVAL_DEFAULT 300	/* Seconds */
+#define DNS_SNAPSHOT_LOCK_TRIES	100		/* 10ms apart */
+
+#define CIDR_COVERED		0xffffffff	/* CIDR trie slot inside a network */
+
+#define OUI_MAGIC		0x4d4f5549	/* "MOUI" */
+#define OUI_VERSION		1
+#define OUI_NONE		0xffffffff
+#define OUI_HAS_SUBRANGE	0x01		/* /24 has /28 or /36 blocks */
+
+#define DNS_CACHE_MISS		0
+#define DNS_CACHE_HIT		1
+#define DNS_CACHE_PENDING	2
+
 #define PACKET_BUFFER_SIZE_DEFAULT 1024000		/* Any larger seems to cause problems without malloc */
 
 #define SQL_RECONNECT_TIME 10
@@ -79,6 +102,82 @@
 
 #define 	FINGERPRINT_REDIS_KEY			"fingerprint"
 #define		FINGERPRINT_REDIS_EXPIRE		3600
+#define		FINGERPRINT_MAX_KEYS			128		/* Fingerprint events we'll look at per IP */
+#define		FINGERPRINT_KEY_SIZE			256
 #define		FINGERPRINT_DHCP_REDIS_EXPIRE		86400
 #define         FINGERPRINT_IP_REDIS_EXPIRE             86400
-
+#define		FINGERPRINT_IP_JSON_SIZE		1024
+#define		FINGERPRINT_DHCP_JSON_SIZE		2048
+
+
+#define		FOLLOW_TIMEOUT				60		/* Seconds between "safety" checks when using inotify */
+
+#define		FOLLOW_EVENT_NONE			0
+#define		FOLLOW_EVENT_MODIFY			1		/* Spool was written to or truncated */
+#define		FOLLOW_EVENT_GONE			2		/* Spool was moved/deleted */
+#define		FOLLOW_EVENT_CREATE			4		/* Something with our name showed up */
+#define		FOLLOW_EVENT_TIMEOUT			8		/* Nothing happened, poll anyways */
+
+#define		WALDO_MAGIC				0x4d574c44	/* "MWLD" */
+#define		WALDO_VERSION				1
+#define		WALDO_HEAD_SIZE				4096		/* Bytes of the spool hashed to identify it */
+
+#define		FOLLOW_READ_SIZE			4194304		/* Initial spool read() buffer,  grows for long lines */
+#define		FOLLOW_READAHEAD			16777216	/* Bytes we ask the kernel to read ahead while catching up */
+#define		FOLLOW_RELEASE_SIZE			8388608		/* Consumed spool data is dropped from the page cache in chunks this big */
+
+#define		MAX_SPOOLS				64		/* Max spools followed (and waldo records) */
+#define		FOLLOW_MAX_GLOBS			16		/* Globs in "follow_eve",  re-expanded as files show up */
+
+#define		SPOOL_TYPE_FILE				0
+#define		SPOOL_TYPE_SOCKET			1
+
+#define		SOCKET_MAX_CLIENTS			16		/* Stream socket connections */
+#define		SOCKET_BUFFER_SIZE			1048576		/* Per stream connection,  grows for long lines */
+#define		SOCKET_DGRAM_BATCH			16		/* Datagrams per recvmmsg() */
+#define		SOCKET_DGRAM_SIZE			262144		/* Largest datagram we accept */
+#define		SOCKET_SPOOL_BATCHES			4		/* Reads in a row with data before spooling to disk */
+#define		SOCKET_MAX_FDS				( SOCKET_MAX_CLIENTS + 2 )
+
+#define		PIPELINE_DEPTH				4096		/* Events in flight when "decode_threads" is set */
+#define		PIPELINE_MAX_THREADS			64
+#define		PIPELINE_BATCH				256		/* Events an output thread takes at once */
+#define		PIPELINE_STACK_SIZE			67108864	/* Meer keeps large buffers on the stack */
+#define		PIPELINE_STOP_TIMEOUT			5		/* Seconds to wait on outputs at shutdown */
+#define		PIPELINE_LAG_TIMEOUT			5		/* Seconds the ring can be full before a slow output is left behind */
+#define		PIPELINE_CATCHUP_BUFFER			1048576		/* Read size for an output catching up */
+#define		PIPELINE_CATCHUP_SLEEP			100000		/* Microseconds to wait when catching up can't make progress */
+
+#define		SPILL_MAGIC				0x4d53504c	/* "MSPL" */
+#define		SPILL_SEGMENT_SIZE			67108864	/* Start a new segment file after this many bytes */
+#define		SPILL_SYNC_EVENTS			1024		/* fdatasync() at least this often (or once a second) */
+#define		SPILL_COMMIT_EVENTS			1024		/* Save the read position this often */
+#define		SPILL_MAX_RECORD			16777216
+
+/* How Decode_JSON_Alert() stores a protocol field */
+
+#define		DECODE_FIELD_STRING			1
+#define		DECODE_FIELD_UINT64			2
+#define		DECODE_FIELD_UINT32			3
+#define		DECODE_FIELD_INT			4
+#define		DECODE_FIELD_REF			5		/* Pointer into the parsed JSON */
+
+#define		DECODE_ALERT_POOL_MAX			1024		/* _DecodeAlert records kept for reuse */
+#define		DECODE_ALERT_ARENA_SIZE			16384		/* First arena block of each record */
+
+/* Per-signature decisions (sid-cache.c) */
+
+#define		SID_CACHE_BUCKETS			65536
+#define		SID_CACHE_BLUEDOT_SOURCE		1
+#define		SID_CACHE_BLUEDOT_DESTINATION		2
+
+/* Outputs.  With "decode_threads",  each enabled output gets its own thread */
+
+#define		OUTPUT_SQL				0x01
+#define		OUTPUT_REDIS				0x02
+#define		OUTPUT_PIPE				0x04
+#define		OUTPUT_EXTERNAL				0x08
+#define		OUTPUT_BLUEDOT				0x10
+#define		OUTPUT_ELASTICSEARCH			0x20
+#define		OUTPUT_MAX				6		/* Outputs above,  for per-output cursors */
+#define		OUTPUT_ALL				0xff
@@ -0,0 +1,558 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Parsing EVE for the decoders.  With json-c,  every value is its own heap
+   object.  With yyjson (--enable-yyjson),  a line is parsed into a single
+   allocation and read in place,  which is a good deal quicker.  Numbers
+   are kept "raw" so they come back exactly as Suricata/Sagan wrote them,
+   same as json-c hands them back. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#ifdef HAVE_LIBJSON_C
+#include <json-c/json.h>
+#endif
+
+#ifndef HAVE_LIBJSON_C
+libjson-c is required for Meer to function!
+#endif
+
+#ifdef HAVE_LIBYYJSON
+#include <yyjson.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "meer-json.h"
+
+/* Pre-scan.  Finds one value in a line without building a tree,  so
+   lines that are only passed along verbatim never get parsed.  Anything
+   it isn't sure about (escapes,  true/false,  broken JSON) is a miss and
+   the caller parses the line the normal way. */
+
+static const char *Prescan_Skip_WS( const char *p, const char *end )
+{
+
+    while ( p < end && ( *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' ) )
+        {
+            p++;
+        }
+
+    return(p);
+}
+
+/* "p" is on the opening quote.  Returns just past the closing one */
+
+static const char *Prescan_Skip_String( const char *p, const char *end )
+{
+
+    for ( p++; p < end; p++ )
+        {
+
+            if ( *p == '\\' )
+                {
+                    p++;
+                }
+
+            else if ( *p == '"' )
+                {
+                    return(p + 1);
+                }
+        }
+
+    return(NULL);
+}
+
+/* Returns just past the value "p" is on */
+
+static const char *Prescan_Skip_Value( const char *p, const char *end )
+{
+
+    int depth = 0;
+
+    while ( p < end )
+        {
+
+            switch ( *p )
+                {
+
+                case '"':
+
+                    p = Prescan_Skip_String(p, end);
+
+                    if ( p == NULL || depth == 0 )
+                        {
+                            return(p);
+                        }
+
+                    continue;
+
+                case '{':
+                case '[':
+                    depth++;
+                    break;
+
+                case '}':
+                case ']':
+
+                    if ( depth == 0 )
+                        {
+                            return(p);
+                        }
+
+                    if ( --depth == 0 )
+                        {
+                            return(p + 1);
+                        }
+
+                    break;
+
+                case ',':
+
+                    if ( depth == 0 )
+                        {
+                            return(p);
+                        }
+
+                    break;
+                }
+
+            p++;
+        }
+
+    return(NULL);
+}
+
+/* "p" is on an object.  Returns the start of the value of "key" in it */
+
+static const char *Prescan_Find( const char *p, const char *end, const char *key, size_t key_len )
+{
+
+    const char *k = NULL;
+    bool match = false;
+
+    p = Prescan_Skip_WS(p, end);
+
+    if ( p >= end || *p != '{' )
+        {
+            return(NULL);
+        }
+
+    p++;
+
+    while ( true )
+        {
+
+            p = Prescan_Skip_WS(p, end);
+
+            if ( p >= end || *p != '"' )
+                {
+                    return(NULL);
+                }
+
+            k = p + 1;
+            p = Prescan_Skip_String(p, end);
+
+            if ( p == NULL )
+                {
+                    return(NULL);
+                }
+
+            match = ( (size_t)( p - 1 - k ) == key_len && !memcmp(k, key, key_len) );
+
+            p = Prescan_Skip_WS(p, end);
+
+            if ( p >= end || *p != ':' )
+                {
+                    return(NULL);
+                }
+
+            p = Prescan_Skip_WS(p + 1, end);
+
+            if ( p >= end )
+                {
+                    return(NULL);
+                }
+
+            if ( match == true )
+                {
+                    return(p);
+                }
+
+            p = Prescan_Skip_Value(p, end);
+
+            if ( p == NULL )
+                {
+                    return(NULL);
+                }
+
+            p = Prescan_Skip_WS(p, end);
+
+            if ( p >= end || *p != ',' )
+                {
+                    return(NULL);
+                }
+
+            p++;
+        }
+
+}
+
+/* "path" is a key,  or keys separated by '.' ("alert.signature_id").  The
+   value has to be a plain string or a number */
+
+bool Meer_JSON_Prescan( const char *json, size_t len, const char *path, char *str, size_t size )
+{
+
+    const char *end = json + len;
+    const char *p = json;
+    const char *q = NULL;
+    const char *dot = NULL;
+
+    while ( ( dot = strchr(path, '.') ) != NULL )
+        {
+
+            p = Prescan_Find(p, end, path, dot - path);
+
+            if ( p == NULL )
+                {
+                    return(false);
+                }
+
+            path = dot + 1;
+        }
+
+    p = Prescan_Find(p, end, path, strlen(path));
+
+    if ( p == NULL )
+        {
+            return(false);
+        }
+
+    if ( *p == '"' )
+        {
+
+            for ( q = ++p; q < end && *q != '"'; q++ )
+                {
+
+                    if ( *q == '\\' )
+                        {
+                            return(false);
+                        }
+                }
+
+            if ( q >= end )
+                {
+                    return(false);
+                }
+        }
+    else
+        {
+
+            q = p;
+
+            while ( q < end && ( ( *q >= '0' && *q <= '9' ) || *q == '-' || *q == '+' || *q == '.' || *q == 'e' || *q == 'E' ) )
+                {
+                    q++;
+                }
+
+            if ( q == p )
+                {
+                    return(false);
+                }
+        }
+
+    if ( (size_t)( q - p ) >= size )
+        {
+            return(false);
+        }
+
+    memcpy(str, p, q - p);
+    str[q - p] = '\0';
+
+    return(true);
+}
+
+#ifdef HAVE_LIBYYJSON
+
+/* Containers read as strings (metadata,  normalize,  etc) are written out
+   on demand and kept here until the document is freed */
+
+typedef struct _MeerJSONString _MeerJSONString;
+struct _MeerJSONString
+{
+    char *string;
+    struct _MeerJSONString *next;
+};
+
+struct _MeerJSON
+{
+    yyjson_doc *doc;
+    struct _MeerJSONString *strings;
+};
+
+struct _MeerJSON *Meer_JSON_Parse( const char *string, size_t len )
+{
+
+    struct _MeerJSON *doc = NULL;
+    yyjson_doc *yy = NULL;
+
+    yy = yyjson_read_opts( (char *)string, len, YYJSON_READ_NUMBER_AS_RAW, NULL, NULL );
+
+    if ( yy == NULL )
+        {
+            return(NULL);
+        }
+
+    doc = (struct _MeerJSON *) malloc(sizeof(struct _MeerJSON));
+
+    if ( doc == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _MeerJSON. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(doc, 0, sizeof(struct _MeerJSON));
+    doc->doc = yy;
+
+    return(doc);
+}
+
+void Meer_JSON_Free( struct _MeerJSON *doc )
+{
+
+    struct _MeerJSONString *s = NULL;
+
+    if ( doc == NULL )
+        {
+            return;
+        }
+
+    while ( doc->strings != NULL )
+        {
+            s = doc->strings;
+            doc->strings = s->next;
+            free(s->string);
+            free(s);
+        }
+
+    yyjson_doc_free(doc->doc);
+    free(doc);
+}
+
+struct _MeerJSONVal *Meer_JSON_Root( struct _MeerJSON *doc )
+{
+    return( (struct _MeerJSONVal *)yyjson_doc_get_root(doc->doc) );
+}
+
+struct _MeerJSONVal *Meer_JSON_Get( struct _MeerJSONVal *obj, const char *key )
+{
+
+    yyjson_val *val = NULL;
+
+    if ( obj == NULL )
+        {
+            return(NULL);
+        }
+
+    val = yyjson_obj_get( (yyjson_val *)obj, key );
+
+    if ( val == NULL || yyjson_is_null(val) )
+        {
+            return(NULL);
+        }
+
+    return( (struct _MeerJSONVal *)val );
+}
+
+bool Meer_JSON_Is_Object( struct _MeerJSONVal *val )
+{
+    return( val != NULL && yyjson_is_obj( (yyjson_val *)val ) );
+}
+
+bool Meer_JSON_Is_Array( struct _MeerJSONVal *val )
+{
+    return( val != NULL && yyjson_is_arr( (yyjson_val *)val ) );
+}
+
+char *Meer_JSON_String( struct _MeerJSON *doc, struct _MeerJSONVal *val )
+{
+
+    yyjson_val *v = (yyjson_val *)val;
+    struct _MeerJSONString *s = NULL;
+
+    if ( v == NULL || yyjson_is_null(v) )
+        {
+            return(NULL);
+        }
+
+    if ( yyjson_is_str(v) )
+        {
+            return( (char *)yyjson_get_str(v) );
+        }
+
+    if ( yyjson_is_raw(v) )
+        {
+            return( (char *)yyjson_get_raw(v) );
+        }
+
+    if ( yyjson_is_bool(v) )
+        {
+            return( yyjson_is_true(v) ? "true" : "false" );
+        }
+
+    /* Object or array */
+
+    s = (struct _MeerJSONString *) malloc(sizeof(struct _MeerJSONString));
+
+    if ( s == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _MeerJSONString. Abort!", __FILE__, __LINE__);
+        }
+
+    s->string = yyjson_val_write( v, YYJSON_WRITE_NOFLAG, NULL );
+
+    if ( s->string == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] yyjson_val_write() failed. Abort!", __FILE__, __LINE__);
+        }
+
+    s->next = doc->strings;
+    doc->strings = s;
+
+    return(s->string);
+}
+
+void Meer_JSON_Foreach( struct _MeerJSONVal *val, Meer_JSON_Foreach_Func func, void *data )
+{
+
+    yyjson_val *v = (yyjson_val *)val;
+    yyjson_val *key = NULL;
+    yyjson_val *item = NULL;
+    size_t idx = 0;
+    size_t max = 0;
+
+    if ( yyjson_is_obj(v) )
+        {
+            yyjson_obj_foreach(v, idx, max, key, item)
+            {
+                func( yyjson_get_str(key), (struct _MeerJSONVal *)item, data );
+            }
+        }
+
+    else if ( yyjson_is_arr(v) )
+        {
+            yyjson_arr_foreach(v, idx, max, item)
+            {
+                func( NULL, (struct _MeerJSONVal *)item, data );
+            }
+        }
+
+}
+
+#else
+
+/* json-c.  A document is just its root object */
+
+struct _MeerJSON *Meer_JSON_Parse( const char *string, size_t len )
+{
+    return( (struct _MeerJSON *)json_tokener_parse(string) );
+}
+
+void Meer_JSON_Free( struct _MeerJSON *doc )
+{
+
+    if ( doc != NULL )
+        {
+            json_object_put( (struct json_object *)doc );
+        }
+
+}
+
+struct _MeerJSONVal *Meer_JSON_Root( struct _MeerJSON *doc )
+{
+    return( (struct _MeerJSONVal *)doc );
+}
+
+struct _MeerJSONVal *Meer_JSON_Get( struct _MeerJSONVal *obj, const char *key )
+{
+
+    struct json_object *tmp = NULL;
+
+    if ( obj == NULL || !json_object_object_get_ex( (struct json_object *)obj, key, &tmp ) )
+        {
+            return(NULL);
+        }
+
+    return( (struct _MeerJSONVal *)tmp );
+}
+
+bool Meer_JSON_Is_Object( struct _MeerJSONVal *val )
+{
+    return( val != NULL && json_object_is_type( (struct json_object *)val, json_type_object ) );
+}
+
+bool Meer_JSON_Is_Array( struct _MeerJSONVal *val )
+{
+    return( val != NULL && json_object_is_type( (struct json_object *)val, json_type_array ) );
+}
+
+char *Meer_JSON_String( struct _MeerJSON *doc, struct _MeerJSONVal *val )
+{
+
+    if ( val == NULL )
+        {
+            return(NULL);
+        }
+
+    return( (char *)json_object_get_string( (struct json_object *)val ) );
+}
+
+void Meer_JSON_Foreach( struct _MeerJSONVal *val, Meer_JSON_Foreach_Func func, void *data )
+{
+
+    struct json_object *obj = (struct json_object *)val;
+    size_t i = 0;
+
+    if ( json_object_is_type(obj, json_type_object) )
+        {
+            json_object_object_foreach(obj, key, item)
+            {
+                func( key, (struct _MeerJSONVal *)item, data );
+            }
+        }
+
+    else if ( json_object_is_type(obj, json_type_array) )
+        {
+
+            for ( i = 0; i < json_object_array_length(obj); i++ )
+                {
+                    func( NULL, (struct _MeerJSONVal *)json_object_array_get_idx(obj, i), data );
+                }
+        }
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* What the decoders use to read a parsed EVE line.  The parser behind it
+   is json-c,  or yyjson with --enable-yyjson.  Both types are opaque.  A
+   _MeerJSON is one parsed line,  a _MeerJSONVal is something inside it.
+   Every string handed out lives until Meer_JSON_Free(). */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct _MeerJSON;
+struct _MeerJSONVal;
+
+struct _MeerJSON *Meer_JSON_Parse( const char *string, size_t len );
+void Meer_JSON_Free( struct _MeerJSON *doc );
+
+struct _MeerJSONVal *Meer_JSON_Root( struct _MeerJSON *doc );
+struct _MeerJSONVal *Meer_JSON_Get( struct _MeerJSONVal *obj, const char *key );
+bool Meer_JSON_Is_Object( struct _MeerJSONVal *val );
+bool Meer_JSON_Is_Array( struct _MeerJSONVal *val );
+char *Meer_JSON_String( struct _MeerJSON *doc, struct _MeerJSONVal *val );
+
+/* Calls "func" for each member of an object (with its key) or each item of
+   an array (key is NULL).  Anything else is ignored. */
+
+typedef void (*Meer_JSON_Foreach_Func)( const char *key, struct _MeerJSONVal *val, void *data );
+void Meer_JSON_Foreach( struct _MeerJSONVal *val, Meer_JSON_Foreach_Func func, void *data );
+
+bool Meer_JSON_Prescan( const char *json, size_t len, const char *path, char *str, size_t size );
+
@@ -49,6 +49,7 @@
 #include "decode-json-alert.h"
 
 #include "util.h"
+#include "util-dns.h"
 #include "util-signal.h"
 #include "config-yaml.h"
 #include "lockfile.h"
@@ -59,6 +60,9 @@
 #include "sid-map.h"
 #include "usage.h"
 #include "oui.h"
+#include "follow.h"
+#include "input-socket.h"
+#include "pipeline.h"
 
 struct _MeerConfig *MeerConfig;
 struct _MeerOutput *MeerOutput;
@@ -99,21 +103,6 @@ int main (int argc, char *argv[])
     signed char c;
     int option_index = 0;
 
-    int fd_int;
-    FILE *fd_file;
-
-    struct stat st;
-
-    bool skip_flag = 0;
-    bool wait_flag = false;
-
-    char buf[BUFFER_SIZE + PACKET_BUFFER_SIZE_DEFAULT] = { 0 };
-
-    uint64_t linecount = 0;
-    uint64_t old_size = 0;
-
-    FILE *meer_log_fd_test;
-
     MeerConfig = (struct _MeerConfig *) malloc(sizeof(_MeerConfig));
 
     if ( MeerConfig == NULL )
@@ -222,22 +211,15 @@ int main (int argc, char *argv[])
 
     Init_Output();
 
-    /* Open the follow_file or wait for the file to be created! */
+    Decode_JSON_Alert_Init();
 
-    while (( fd_file = fopen(MeerConfig->follow_file, "r" )) == NULL )
-        {
+    DNS_Cache_Init();
 
-            if ( wait_flag == false )
-                {
-                    Meer_Log(NORMAL, "Waiting on %s spool file [%s].....", MeerConfig->follow_file, strerror(errno));
-                    wait_flag = true;
-                }
-            sleep(1);
-        }
+    Init_Follow();
 
-    fd_int = fileno(fd_file);
+    Init_Input_Socket();
 
-    Meer_Log(NORMAL, "Successfully opened %s.", MeerConfig->follow_file);
+    Follow_Open();
 
     /* Become a daemon if requested */
 
@@ -326,166 +308,15 @@ int main (int argc, char *argv[])
                 }
         }
 
+    /* Threads don't survive a fork(),  so this comes after becoming a daemon */
 
+    Init_Pipeline();
 
-    if ( MeerWaldo->position != 0 )
-        {
-
-            Meer_Log(NORMAL, "Skipping to record %" PRIu64 " in %s", MeerWaldo->position, MeerConfig->follow_file);
-
-            while( (fgets(buf, sizeof(buf), fd_file) != NULL ) && linecount < MeerWaldo->position )
-                {
-
-                    linecount++;
-                }
-
-            /* If our Waldo is > than our line count,  the file was likely truncated while Meer was
-               "offline".  Reset the Waldo,  and inform the user.  On restart, we'll treat the spool
-               as a new file. */
-
-            if ( MeerWaldo->position > linecount )
-                {
-
-                    Meer_Log(WARN, "Spool might have been truncated!  Resetting Waldo to zero and aborting.");
-                    MeerWaldo->position = 0;
-                    Signal_Handler(SIGTERM);
-
-                }
-
-            Meer_Log(NORMAL, "Reached target record of %" PRIu64 ".  Processing new records.", MeerWaldo->position);
-
-
-        }
-    else
-        {
-
-            Meer_Log(NORMAL, "Ingesting data. Working........");
-
-        }
-
-    while(fgets(buf, sizeof(buf), fd_file) != NULL)
-        {
-
-            if ( Validate_JSON_String( (char*)buf ) == 0 )
-                {
-                    Decode_JSON( (char*)buf );
-                }
-
-            MeerWaldo->position++;
-
-        }
-
-    Meer_Log(NORMAL, "Read in %" PRIu64 " lines",MeerWaldo->position);
-
-    if (fstat(fd_int, &st))
-        {
-            Meer_Log(ERROR, "Cannot 'stat' spool file '%s' [%s]  Abort!", MeerConfig->follow_file, strerror(errno));
-        }
-
-    old_size = (uint64_t) st.st_size;
-
-    Meer_Log(NORMAL, "Waiting for new data......");
-
-    while(1)
-        {
-
-            /* If the spool file disappears, then we wait to see if a new one
-               shows up.  Suricata might be rotating the alert.json file.  We use to
-               try and "stat" the file but that didn't work.  We use fopen as a "test"
-               instead. 2020/10/27 - Champ */
-
-            if (( meer_log_fd_test = fopen(MeerConfig->follow_file, "r" )) == NULL )
-                {
-
-                    fclose(fd_file);
+    DNS_Resolver_Init();
 
-                    old_size = 0;
-                    linecount = 0;
-
-                    MeerWaldo->position = 0;
-
-                    Meer_Log(NORMAL, "Follow JSON File '%s' disappeared [%s].", MeerConfig->follow_file, strerror(errno) );
-                    Meer_Log(NORMAL, "Waiting for new spool file....");
-
-                    while (( fd_file = fopen(MeerConfig->follow_file, "r" )) == NULL )
-                        {
-                            sleep(1);
-                        }
-
-                    fd_int = fileno(fd_file);
-
-                    Meer_Log(NORMAL, "Sucessfully re-opened %s. Waiting for new data.", MeerConfig->follow_file);
-
-                }
-            else
-                {
-
-                    /* Test succeeded.  Close test file */
-
-                    fclose(meer_log_fd_test);
-
-                }
-
-            /* Check spool file.  If it's grown,  read in the new data.  For some reason,  around Debian 10
-               the call for fgets() stop functioning.  We've replaced that with a read() and parsing of the
-               read_buf. */
-
-            if (fstat(fd_int, &st))
-                {
-                    Meer_Log(ERROR, "Cannot 'stat' spool file '%s' [%s]  Abort!", MeerConfig->follow_file, strerror(errno));
-                }
-
-            if ( (uint64_t) st.st_size > old_size )
-                {
-
-                    /* Clear any previous EOF */
-
-                    clearerr( fd_file );
-
-                    while(fgets(buf, sizeof(buf), fd_file) != NULL)
-                        {
-
-                            skip_flag = Validate_JSON_String( (char*)buf );
-
-                            if ( skip_flag == 0 )
-                                {
-                                    Decode_JSON( (char*)buf);
-                                }
-
-                            MeerWaldo->position++;
-
-                        }
-
-                    old_size = (uint64_t) st.st_size;
-
-                }
-
-            /* If the spool file has _shunk_,  it's been truncated.  We need to
-                   re-open it! */
-
-            else if ( (uint64_t) st.st_size < old_size )
-                {
-                    Meer_Log(NORMAL, "Spool file Truncated! Re-opening '%s'!", MeerConfig->follow_file );
-
-                    fclose(fd_file);
-
-                    if (( fd_file = fopen(MeerConfig->follow_file, "r" )) == NULL )
-                        {
-                            Meer_Log(ERROR, "Cannot re-open %s. [%s]", MeerConfig->follow_file, strerror(errno) );
-                        }
-
-                    fd_int = fileno(fd_file);
-
-                    old_size = 0;
-                    linecount = 0;
-
-                    MeerWaldo->position = 0;
-
-                }
-
-            sleep(1);
-        }
+    Follow_Resume();
 
+    Follow_Spool();
 
     return(0);
 
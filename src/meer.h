@@ -67,7 +67,14 @@ struct _MeerConfig
 
     char lock_file[256];
     char waldo_file[256];
-    char follow_file[256];
+    char follow_file[4096];		/* Comma separated list of spools/globs */
+    char socket_stream[256];		/* Unix stream socket to receive EVE on */
+    char socket_dgram[256];		/* Unix datagram socket to receive EVE on */
+    char socket_spool[256];		/* Where socket data goes when we fall behind */
+
+    uint32_t decode_threads;		/* 0 == decode/output inline (no pipeline) */
+    char spill_dir[256];		/* Where outputs that are behind queue socket events */
+    bool spool_punch_holes;		/* Free the disk space of consumed spool data */
 
     char meer_log[256];
     FILE *meer_log_fd;
@@ -80,9 +87,16 @@ struct _MeerConfig
 
     bool dns;
     uint32_t dns_cache;
+    uint32_t dns_cache_size;		/* Entries */
+    uint32_t dns_negative_cache;	/* Seconds to remember a failed lookup */
+    uint32_t dns_threads;		/* Resolver threads.  0 == look up inline */
+    uint32_t dns_wait;			/* ms to wait on a resolver */
+    char dns_snapshot[256];		/* "" == no snapshot */
+    uint32_t dns_snapshot_interval;	/* Seconds.  0 == only at shutdown */
 
     bool oui;
     char oui_filename[256];
+    char oui_database[256];		/* Compiled manuf,  "" == don't save */
 
     bool health;
     bool fingerprint;
@@ -247,8 +261,62 @@ struct _MeerOutput
 
 typedef struct _MeerWaldo _MeerWaldo;
 struct _MeerWaldo
+{
+    uint64_t position;		/* Line count.  Must be first,  old waldo files are only this */
+    uint32_t magic;		/* WALDO_MAGIC if the fields below are valid */
+    uint32_t version;
+    uint64_t offset;		/* Byte offset of the next line to read */
+    uint64_t inode;		/* Identity of the spool "offset" belongs to */
+    uint64_t dev;
+    uint64_t head_hash;		/* Hash of the first "head_len" bytes of the spool */
+    uint64_t head_len;
+    char spool[256];		/* Spool this record belongs to */
+};
+
+/* Where one output is in one spool,  kept in the waldo file after the
+   _MeerWaldo records.  Only used while that output is "behind" (catching
+   up on its own).  Otherwise the output is where the spool's waldo is. */
+
+typedef struct _MeerCursor _MeerCursor;
+struct _MeerCursor
 {
     uint64_t position;
+    uint64_t offset;
+    uint64_t inode;		/* Spool "offset" belongs to */
+    uint64_t behind;
+};
+
+/* One spool (EVE file) being followed */
+
+typedef struct _MeerSpool _MeerSpool;
+struct _MeerSpool
+{
+    unsigned char type;			/* SPOOL_TYPE_FILE or SPOOL_TYPE_SOCKET */
+    char filename[256];
+    char dir[256];
+    char name[256];
+    char interface[64];
+
+    int fd;
+    int file_wd;
+    int dir_wd;
+    int events;
+
+    bool gone;
+    uint64_t old_size;
+    uint64_t released;			/* Everything before this is out of the page cache (and punched out) */
+
+    struct _MeerWaldo *waldo;
+    struct _MeerCursor *cursor;		/* One per output (OUTPUT_MAX) */
+    uint64_t in_flight;			/* Lines in the pipeline,  not yet in the waldo */
+    uint64_t in_flight_bytes;
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+    uint32_t sql_sensor_id;
+    uint64_t sql_last_cid;
+    struct _MeerSpool *sql_owner;	/* First spool with our sensor,  it holds the CID */
+#endif
+
 };
 
 /* Counters */
@@ -290,6 +358,10 @@ struct _MeerCounters
     uint64_t ExternalMissCount;
 
     uint64_t InvalidJSONCount;
+    uint64_t PrescanCount;		/* Routed on "event_type" without a parse */
+
+    uint64_t SIDCacheHitCount;		/* Signature decisions (sid-cache.c) */
+    uint64_t SIDCacheMissCount;
     uint64_t FlowCount;
     uint64_t HTTPCount;
     uint64_t TLSCount;
@@ -301,9 +373,21 @@ struct _MeerCounters
 
     uint64_t DNSCount;
     uint64_t DNSCacheCount;
+    uint64_t DNSFailCount;
+    uint64_t DNSCacheExpired;
+    uint64_t DNSCacheEvictions;
+    uint64_t DNSLate;			/* Events sent without waiting (long enough) for the PTR */
+    uint64_t DNSQueueDropped;
     uint64_t BluedotCount;
 
+    uint32_t SpoolCount;		/* Array count */
+    uint64_t SpoolRotations;
+    uint64_t SpoolDrainBytes;		/* Read from old spools after rotation */
+    uint64_t SocketSpooled;		/* Socket events written to socket_spool */
+    uint64_t SocketSpools;		/* Times we fell behind and started spooling */
+    uint64_t SpoolReleasedBytes;	/* Consumed spool data dropped from the page cache */
+    uint64_t SpoolPunchedBytes;		/* Consumed spool data punched out of the file */
+
 };
 
 
-bool Decode_JSON( char * );
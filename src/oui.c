@@ -18,8 +18,16 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
+/* Lookup routines for MAC address / vender.
 
-/* Lookup routines for MAC address / vender */
+   The Wireshark manuf file is compiled into an "image": a _OUI_Header,  a
+   hash table of _OUI_Slot keyed on the prefix (24 bit OUIs and the /28 and
+   /36 blocks the IEEE hands out under some of them),  then the vendor
+   strings.  With "oui_database" set the image is saved,  and mmap()ed on
+   the next start as long as the manuf file hasn't changed.
+
+   A lookup is one probe for the /24.  Only if that /24 has been split up
+   do we also probe for the /36 and /28. */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"             /* From autoconf */
@@ -28,7 +36,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "meer.h"
 #include "meer-def.h"
@@ -37,7 +51,179 @@
 
 struct _MeerCounters *MeerCounters;
 struct _MeerConfig *MeerConfig;
-struct _Manfact_Struct *MF_Struct;
+
+static const _OUI_Slot *OUI_Slots = NULL;
+static const char *OUI_Strings = NULL;
+static uint32_t OUI_Mask = 0;
+
+#define OUI_KEY(mac, bits)	( ( ( (uint64_t)(mac) >> ( 48 - (bits) ) ) << 8 ) | (bits) )
+
+/* Slot holding "key",  or the empty slot where it would go.  OUI_NONE if
+   the table is full and it isn't there (only a broken image can be full) */
+
+static uint32_t OUI_Find( const _OUI_Slot *slot, uint32_t mask, uint64_t key )
+{
+
+    uint32_t i = (uint32_t)( ( key * 0x9E3779B97F4A7C15ULL ) >> 32 ) & mask;
+    uint32_t probes = 0;
+
+    while ( slot[i].key != 0 && slot[i].key != key )
+        {
+
+            if ( probes++ == mask )
+                {
+                    return(OUI_NONE);
+                }
+
+            i = ( i + 1 ) & mask;
+        }
+
+    return(i);
+}
+
+/* Use "image" as the OUI database if it looks sane */
+
+static bool OUI_Use_Image( const unsigned char *image, size_t size )
+{
+
+    const _OUI_Header *header = (const _OUI_Header *)image;
+    const _OUI_Slot *slot = NULL;
+    const char *strings = NULL;
+    uint32_t empty = 0;
+    uint32_t i = 0;
+
+    if ( size < sizeof(_OUI_Header) || header->magic != OUI_MAGIC || header->version != OUI_VERSION )
+        {
+            return(false);
+        }
+
+    if ( header->slots == 0 || ( header->slots & ( header->slots - 1 ) ) != 0 ||
+            header->strings_size == 0 ||
+            size != sizeof(_OUI_Header) + (size_t)header->slots * sizeof(_OUI_Slot) + header->strings_size )
+        {
+            return(false);
+        }
+
+    slot = (const _OUI_Slot *)( image + sizeof(_OUI_Header) );
+    strings = (const char *)( slot + header->slots );
+
+    if ( strings[ header->strings_size - 1 ] != '\0' )
+        {
+            return(false);
+        }
+
+    /* Every vendor has to be inside the strings,  and there has to be an
+       empty slot for lookups of unknown OUIs to stop at */
+
+    for ( i = 0; i < header->slots; i++ )
+        {
+
+            if ( slot[i].key == 0 )
+                {
+                    empty++;
+                }
+
+            else if ( slot[i].vendor != OUI_NONE && slot[i].vendor >= header->strings_size )
+                {
+                    return(false);
+                }
+        }
+
+    if ( empty == 0 )
+        {
+            return(false);
+        }
+
+    OUI_Slots = slot;
+    OUI_Strings = strings;
+    OUI_Mask = header->slots - 1;
+
+    MeerCounters->OUICount = header->count;
+
+    return(true);
+}
+
+/* Try the saved image.  It's only used if it was built from the manuf file
+   as it is now (or if there is no manuf file at all) */
+
+static bool OUI_Load_Image( const struct stat *manuf )
+{
+
+    const _OUI_Header *header = NULL;
+    unsigned char *image = NULL;
+    struct stat st;
+    int fd = 0;
+
+    if ( ( fd = open(MeerConfig->oui_database, O_RDONLY) ) < 0 )
+        {
+            return(false);
+        }
+
+    if ( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(_OUI_Header) )
+        {
+            close(fd);
+            return(false);
+        }
+
+    if ( ( image = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0) ) == MAP_FAILED )
+        {
+            close(fd);
+            return(false);
+        }
+
+    close(fd);
+
+    header = (const _OUI_Header *)image;
+
+    if ( manuf != NULL && ( header->src_mtime != (uint64_t)manuf->st_mtime || header->src_size != (uint64_t)manuf->st_size ) )
+        {
+            munmap(image, st.st_size);
+            return(false);
+        }
+
+    if ( OUI_Use_Image( image, st.st_size ) == false )
+        {
+            Meer_Log(WARN, "OUI database '%s' is damaged.  Rebuilding it.", MeerConfig->oui_database);
+            munmap(image, st.st_size);
+            return(false);
+        }
+
+    return(true);
+}
+
+/* Write the image for next time.  Not being able to isn't fatal */
+
+static void OUI_Save_Image( const unsigned char *image, size_t size )
+{
+
+    char tmp[sizeof(MeerConfig->oui_database) + 8] = { 0 };
+    int fd = 0;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", MeerConfig->oui_database);
+
+    if ( ( fd = open(tmp, (O_CREAT | O_TRUNC | O_WRONLY), (S_IREAD | S_IWRITE)) ) < 0 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot open() OUI database '%s' [%s]", __FILE__, __LINE__, tmp, strerror(errno));
+            return;
+        }
+
+    if ( write(fd, image, size) != (ssize_t)size )
+        {
+            Meer_Log(WARN, "[%s, line %d] Failed writing OUI database '%s' [%s]", __FILE__, __LINE__, tmp, strerror(errno));
+            close(fd);
+            unlink(tmp);
+            return;
+        }
+
+    close(fd);
+
+    if ( rename(tmp, MeerConfig->oui_database) != 0 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot rename OUI database '%s' to '%s' [%s]", __FILE__, __LINE__, tmp, MeerConfig->oui_database, strerror(errno));
+            unlink(tmp);
+        }
+
+}
 
 /*****************************************************************************/
 /* Load MAC/Vendor information into memory.  This list is from the Wireshark */
@@ -49,17 +235,53 @@ struct _Manfact_Struct *MF_Struct;
 void Load_OUI( void )
 {
 
+    struct stat st;
+    bool have_manuf = false;
+
     char buf[1024] = { 0 };
     char *saveptr = NULL;
 
     char *mac = NULL;
     char *short_manfact = NULL;
     char *long_manfact = NULL;
+    char *vendor = NULL;
+    char *bits_s = NULL;
+
+    uint64_t *keys = NULL;
+    uint32_t *vendors = NULL;
+    uint32_t count = 0;
+    uint32_t subs = 0;
+    uint32_t alloc = 0;
+
+    char *strings = NULL;
+    uint32_t strings_size = 0;
+    uint32_t strings_alloc = 0;
+
+    unsigned char *image = NULL;
+    _OUI_Header *header = NULL;
+    _OUI_Slot *slot = NULL;
+    size_t image_size = 0;
+    uint32_t slots = 16;
+    uint32_t mask = 0;
+    uint32_t i = 0;
+    uint32_t s = 0;
+    uint64_t value = 0;
+    int octets = 0;
+    int bits = 0;
+    size_t len = 0;
 
     int linecount = 0;
 
     FILE *mf;
 
+    have_manuf = stat(MeerConfig->oui_filename, &st) == 0;
+
+    if ( MeerConfig->oui_database[0] != '\0' && OUI_Load_Image( have_manuf ? &st : NULL ) == true )
+        {
+            Meer_Log(NORMAL, "Loaded %d entries from OUI database [%s].",  MeerCounters->OUICount,  MeerConfig->oui_database);
+            return;
+        }
+
     if (( mf = fopen(MeerConfig->oui_filename, "r" )) == NULL )
         {
             Meer_Log(ERROR, "[%s, line %d] Cannot open rule file %s. [%s]", __FILE__,  __LINE__, MeerConfig->oui_filename, strerror(errno) );
@@ -72,12 +294,12 @@ void Load_OUI( void )
 
             /* Skip comments, etc */
 
-            if (buf[0] == '#' || buf[0] == 10 || buf[0] == ';' || buf[0] == 32)
+            if (buf[0] == '#' || buf[0] == 10 || buf[0] == 13 || buf[0] == ';' || buf[0] == 32)
                 {
                     continue;
                 }
 
-            buf[ strlen(buf) - 1 ] = '\0';		/* Remove return */
+            buf[ strcspn(buf, "\r\n") ] = '\0';		/* Remove return */
 
             /* Pull in all values */
 
@@ -93,101 +315,198 @@ void Load_OUI( void )
                     Meer_Log(ERROR, "[%s, line %d] %s incorrectly formated at line %d", __FILE__,  __LINE__, MeerConfig->oui_filename, linecount );
                 }
 
-            /* if no long_manfact is present */
+            /* By default, return the long_manfact information.  If that
+               isn't present,  then return the short_manfact data */
+
+            vendor = long_manfact != NULL ? long_manfact : short_manfact;
 
-            if ( long_manfact == NULL )
+            /* "00:1B:C5" is a /24.  Blocks under it look like
+               "00:1B:C5:00:00:00/36".  Other sizes don't show up in manuf,
+               and we don't look for them. */
+
+            if ( ( octets = MAC_Parse( mac, &value ) ) == 0 )
                 {
-                    long_manfact = "0";
+                    Meer_Log(ERROR, "[%s, line %d] %s incorrectly formated at line %d", __FILE__,  __LINE__, MeerConfig->oui_filename, linecount );
                 }
 
-            /* Allocate memory for classifications,  but not comments */
+            bits = ( bits_s = strchr(mac, '/') ) != NULL ? atoi(bits_s + 1) : 24;
 
-            MF_Struct = (_Manfact_Struct *) realloc(MF_Struct, (MeerCounters->OUICount+1) * sizeof(_Manfact_Struct));
-
-            if ( MF_Struct == NULL )
+            if ( ( bits != 24 && bits != 28 && bits != 36 ) || bits > octets * 8 )
                 {
-                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for _Manfact_Struct. Abort!", __FILE__, __LINE__);
+                    continue;
                 }
 
-            memset(&MF_Struct[MeerCounters->OUICount], 0, sizeof(struct _Manfact_Struct));
+            if ( count == alloc )
+                {
 
+                    alloc = alloc == 0 ? 1024 : alloc * 2;
 
-            /* Store into memory the values */
+                    keys = (uint64_t *) realloc(keys, alloc * sizeof(uint64_t));
+                    vendors = (uint32_t *) realloc(vendors, alloc * sizeof(uint32_t));
 
-            strlcpy(MF_Struct[MeerCounters->OUICount].mac, mac, sizeof(MF_Struct[MeerCounters->OUICount].mac));
-            strlcpy(MF_Struct[MeerCounters->OUICount].short_manfact, short_manfact, sizeof(MF_Struct[MeerCounters->OUICount].short_manfact));
-            strlcpy(MF_Struct[MeerCounters->OUICount].long_manfact, long_manfact, sizeof(MF_Struct[MeerCounters->OUICount].long_manfact));
+                    if ( keys == NULL || vendors == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for OUI entries. Abort!", __FILE__, __LINE__);
+                        }
+                }
 
-            MeerCounters->OUICount++;
+            len = strlen(vendor) + 1;
 
-        }
+            while ( strings_size + len > strings_alloc )
+                {
 
-    Meer_Log(NORMAL, "Loaded %d entries from OUI database [%s].",  MeerCounters->OUICount,  MeerConfig->oui_filename);
+                    strings_alloc = strings_alloc == 0 ? 65536 : strings_alloc * 2;
 
-}
+                    if ( ( strings = (char *) realloc(strings, strings_alloc) ) == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for OUI vendors. Abort!", __FILE__, __LINE__);
+                        }
+                }
 
+            memcpy(strings + strings_size, vendor, len);
 
-/**************************************************************/
-/* OUI_Lookup - looks up a MAC address and returns the vender */
-/**************************************************************/
+            keys[count] = OUI_KEY( value << ( 8 * ( 6 - octets ) ), bits );
+            vendors[count] = strings_size;
 
-void OUI_Lookup ( char *mac, char *str, size_t size )
-{
+            strings_size += len;
+            subs += bits != 24;
+            count++;
 
-    char *s1 = NULL;
-    char *s2 = NULL;
-    char *s3 = NULL;
-    char *saveptr = NULL;
+        }
 
-    int i = 0;
+    fclose(mf);
 
-    char new_mac[32] = { 0 };
-    char search_string[9] = { 0 };
+    if ( strings_size == 0 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] No entries found in %s. Abort!", __FILE__,  __LINE__, MeerConfig->oui_filename);
+        }
 
-    /* Convert the MAC to upper case */
+    /* Every entry plus possibly a /24 for each /28 and /36,  at most half
+       full */
 
-    strlcpy(new_mac, mac, sizeof(new_mac));
-    To_UpperC(new_mac);
+    while ( slots < ( count + subs ) * 2 )
+        {
+            slots <<= 1;
+        }
 
-    /* Break up the MAC ( 00:00:00 ) */
+    mask = slots - 1;
+    image_size = sizeof(_OUI_Header) + (size_t)slots * sizeof(_OUI_Slot) + strings_size;
 
-    s1 = strtok_r(new_mac, ":", &saveptr);
-    s2 = strtok_r(NULL, ":", &saveptr);
-    s3 = strtok_r(NULL, ":", &saveptr);
+    if ( ( image = calloc( 1, image_size ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for the OUI database. Abort!", __FILE__, __LINE__);
+        }
 
-    /* Our new search string */
+    header = (_OUI_Header *)image;
+    slot = (_OUI_Slot *)( image + sizeof(_OUI_Header) );
 
-    snprintf(search_string, sizeof(search_string), "%s:%s:%s", s1, s2, s3);
+    for ( i = 0; i < count; i++ )
+        {
 
-    /* See if we can find the MAC address */
+            s = OUI_Find( slot, mask, keys[i] );
 
-    for ( i = 0; i < MeerCounters->OUICount; i++ )
-        {
+            /* First one wins,  like the old linear search.  A /24 we put in
+               for a sub-block below gets its vendor when it shows up. */
 
-            if ( !strncmp(search_string,  MF_Struct[i].mac, 8) )
+            if ( slot[s].key == 0 )
                 {
+                    slot[s].key = keys[i];
+                    slot[s].vendor = vendors[i];
+                    MeerCounters->OUICount++;
+                }
 
-                    /* By default, return the long_manfact information.  If that
-                       isn't present,  then return the short_manfact data */
+            else if ( slot[s].vendor == OUI_NONE )
+                {
+                    slot[s].vendor = vendors[i];
+                    MeerCounters->OUICount++;
+                }
 
-                    if ( MF_Struct[i].long_manfact[0] != '0' )
-                        {
-                            snprintf(str, size, "%s", MF_Struct[i].long_manfact);
-                            return;
-                        }
-                    else
+            if ( ( keys[i] & 0xff ) != 24 )
+                {
+
+                    s = OUI_Find( slot, mask, OUI_KEY( ( keys[i] >> 8 ) << ( 48 - ( keys[i] & 0xff ) ), 24 ) );
+
+                    if ( slot[s].key == 0 )
                         {
-                            snprintf(str, size, "%s", MF_Struct[i].short_manfact);
-                            return;
+                            slot[s].key = OUI_KEY( ( keys[i] >> 8 ) << ( 48 - ( keys[i] & 0xff ) ), 24 );
+                            slot[s].vendor = OUI_NONE;
                         }
 
+                    slot[s].flags |= OUI_HAS_SUBRANGE;
                 }
+        }
+
+    memcpy(image + image_size - strings_size, strings, strings_size);
 
+    header->magic = OUI_MAGIC;
+    header->version = OUI_VERSION;
+    header->src_mtime = (uint64_t)st.st_mtime;
+    header->src_size = (uint64_t)st.st_size;
+    header->slots = slots;
+    header->count = MeerCounters->OUICount;
+    header->strings_size = strings_size;
+
+    free(keys);
+    free(vendors);
+    free(strings);
+
+    if ( MeerConfig->oui_database[0] != '\0' )
+        {
+            OUI_Save_Image( image, image_size );
         }
 
-    /* Unknown / not found */
+    OUI_Use_Image( image, image_size );
+
+    Meer_Log(NORMAL, "Loaded %d entries from OUI database [%s].",  MeerCounters->OUICount,  MeerConfig->oui_filename);
+
+}
+
+
+/**************************************************************/
+/* OUI_Lookup - looks up a MAC address and returns the vender */
+/* "mac" is from MAC_Parse()                                  */
+/**************************************************************/
+
+void OUI_Lookup ( uint64_t mac, char *str, size_t size )
+{
+
+    uint32_t s = 0;
+    uint32_t sub = 0;
 
-    snprintf(str, size, "");
+    str[0] = '\0';
+
+    if ( OUI_Slots == NULL )
+        {
+            return;
+        }
+
+    s = OUI_Find( OUI_Slots, OUI_Mask, OUI_KEY( mac, 24 ) );
+
+    if ( s == OUI_NONE || OUI_Slots[s].key == 0 )
+        {
+            return;		/* Unknown / not found */
+        }
+
+    if ( OUI_Slots[s].flags & OUI_HAS_SUBRANGE )
+        {
+
+            sub = OUI_Find( OUI_Slots, OUI_Mask, OUI_KEY( mac, 36 ) );
+
+            if ( sub == OUI_NONE || OUI_Slots[sub].key == 0 )
+                {
+                    sub = OUI_Find( OUI_Slots, OUI_Mask, OUI_KEY( mac, 28 ) );
+                }
+
+            if ( sub != OUI_NONE && OUI_Slots[sub].key != 0 )
+                {
+                    s = sub;
+                }
+        }
+
+    if ( OUI_Slots[s].vendor != OUI_NONE )
+        {
+            snprintf(str, size, "%s", OUI_Strings + OUI_Slots[s].vendor);
+        }
 
 }
 
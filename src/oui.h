@@ -18,16 +18,28 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-typedef struct _Manfact_Struct _Manfact_Struct;
-struct _Manfact_Struct
+/* OUI database image.  See oui.c */
+
+typedef struct _OUI_Header _OUI_Header;
+struct _OUI_Header
 {
-    char mac[22];
-    char short_manfact[9];
-    char long_manfact[128];
+    uint32_t magic;			/* OUI_MAGIC */
+    uint32_t version;
+    uint64_t src_mtime;			/* manuf file it was built from */
+    uint64_t src_size;
+    uint32_t slots;			/* Power of two */
+    uint32_t count;			/* Vendors */
+    uint32_t strings_size;
+    uint32_t reserved;
 };
 
+typedef struct _OUI_Slot _OUI_Slot;
+struct _OUI_Slot
+{
+    uint64_t key;			/* prefix << 8 | prefix bits.  0 == empty */
+    uint32_t vendor;			/* Offset into the strings,  OUI_NONE if unknown */
+    uint32_t flags;			/* OUI_HAS_SUBRANGE */
+};
 
 void Load_OUI( void );
-void OUI_Lookup ( char *mac, char *str, size_t size );
-
-
+void OUI_Lookup ( uint64_t mac, char *str, size_t size );
@@ -44,17 +44,19 @@
 #include <string.h>
 
 #include "decode-json-alert.h"
+#include "sid-cache.h"
 
 #include "meer.h"
 #include "meer-def.h"
 #include "util.h"
+#include "util-cidr.h"
 #include "util-http.h"
 
 #include "output-plugins/bluedot.h"
 
 struct _MeerOutput *MeerOutput;
 struct _MeerCounters *MeerCounters;
-struct _Bluedot_Skip *Bluedot_Skip;
+struct _CIDR_Trie Bluedot_Skip;
 
 extern char rfc3986[256];
 extern char html5[256];
@@ -69,39 +71,27 @@ bool Bluedot( struct _DecodeAlert *DecodeAlert )
     char buff[2048] = { 0 };
     char url_encoded[MAX_BUFFER*3] = { 0 };
 
-    struct json_object *json_obj = NULL;
-    struct json_object *tmp = NULL;
-
-    const char *bluedot = NULL;
-
     char ip[MAXIP] = { 0 };
-    unsigned char ip_convert[MAXIPBIT] = { 0 };
+    unsigned char *ip_convert = NULL;
 
     char source_encoded[MAX_SOURCE] = { 0 };
     char comments_encoded[MAX_SOURCE*3] = { 0 };
 
     int sockfd;
     struct sockaddr_in servaddr;
-    uint_fast16_t i = 0;
-
-    json_obj = json_tokener_parse(DecodeAlert->alert_metadata);
 
     /* Which IP are we adding to Bluedot? */
 
-    if (json_object_object_get_ex(json_obj, "bluedot", &tmp))
+    if ( DecodeAlert->Sig->bluedot_by == SID_CACHE_BLUEDOT_SOURCE )
         {
-            bluedot = (char *)json_object_get_string(tmp);
-
-            if ( strstr( bluedot, "by_source" ) )
-                {
-                    strlcpy(ip, DecodeAlert->src_ip, sizeof(ip));
-                }
-
-            else if ( strstr ( bluedot, "by_destination" ) )
-                {
-                    strlcpy(ip, DecodeAlert->dest_ip, sizeof(ip));
-                }
+            strlcpy(ip, DecodeAlert->src_ip, sizeof(ip));
+            ip_convert = DecodeAlert->src_ip_bit;
+        }
 
+    else if ( DecodeAlert->Sig->bluedot_by == SID_CACHE_BLUEDOT_DESTINATION )
+        {
+            strlcpy(ip, DecodeAlert->dest_ip, sizeof(ip));
+            ip_convert = DecodeAlert->dest_ip_bit;
         }
 
     /* Didn't find either.  Warn the user but continue on */
@@ -112,8 +102,6 @@ bool Bluedot( struct _DecodeAlert *DecodeAlert )
             return(0);
         }
 
-    IP2Bit( ip, ip_convert );
-
     /* Is the IP address "routable?" */
 
     if ( Is_Notroutable(ip_convert) )
@@ -129,20 +117,15 @@ bool Bluedot( struct _DecodeAlert *DecodeAlert )
 
     /* Is the IP within the "skip_networks"?  Is so,  skip it! */
 
-    for ( i = 0; i < MeerCounters->bluedot_skip_count; i++ )
+    if ( CIDR_Trie_Match( &Bluedot_Skip, ip_convert ) )
         {
 
-            if ( Is_Inrange(ip_convert, (unsigned char *)&Bluedot_Skip[i].range, 1) )
+            if ( MeerOutput->bluedot_debug == true )
                 {
-
-                    if ( MeerOutput->bluedot_debug == true )
-                        {
-                            Meer_Log(DEBUG, "IP address %s is in the 'skip_network' range.  Skipping!", ip);
-                        }
-
-                    return(false);
+                    Meer_Log(DEBUG, "IP address %s is in the 'skip_network' range.  Skipping!", ip);
                 }
 
+            return(false);
         }
 
 
@@ -198,8 +181,6 @@ bool Bluedot( struct _DecodeAlert *DecodeAlert )
             printf("Response:\n%s", buff);
         }
 
-    json_object_put(json_obj);
-
     return(true);
 }
 
@@ -17,6 +17,7 @@
 #include <sys/types.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <curl/curl.h>
 
@@ -187,7 +188,8 @@ void Elasticsearch_Get_Index ( char *str, size_t size, const char *event_type )
     uint8_t pos=0;
 
     time_t t = time(NULL);
-    struct tm tm = *localtime(&t);
+    struct tm tm;
+    localtime_r(&t, &tm);
 
     //printf("now: %d-%02d-%02d %02d:%02d:%02d\n", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
 
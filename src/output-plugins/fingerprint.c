@@ -35,6 +35,7 @@
 #include "util.h"
 
 #include "decode-json-alert.h"
+#include "decode-json.h"
 #include "decode-json-dhcp.h"
 
 #include "fingerprints.h"
@@ -46,8 +47,6 @@ struct _MeerOutput *MeerOutput;
 struct _MeerCounters *MeerCounters;
 struct _MeerConfig *MeerConfig;
 
-struct _Fingerprint_Networks *Fingerprint_Networks;
-
 void Output_Fingerprint_IP ( struct _DecodeAlert *DecodeAlert, char *fingerprint_IP_JSON )
 {
 
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #include "meer.h"
 #include "meer-def.h"
@@ -38,11 +39,21 @@
 struct _MeerOutput *MeerOutput;
 struct _MeerCounters *MeerCounters;
 
-void Pipe_Write ( char *json_string )
+/* The line handed to us doesn't include the \n,  so add it back with the
+   same write.  writev() to a pipe is atomic just like write(). */
+
+void Pipe_Write ( char *json_string, size_t json_len )
 {
-    uint32_t ret = 0;
+    ssize_t ret = 0;
+
+    struct iovec iov[2];
+
+    iov[0].iov_base = json_string;
+    iov[0].iov_len = json_len;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len = 1;
 
-    ret = write(MeerOutput->pipe_fd, json_string, strlen(json_string));
+    ret = writev(MeerOutput->pipe_fd, iov, 2);
 
     if ( ret < 0 )
         {
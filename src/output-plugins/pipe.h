@@ -18,5 +18,5 @@
 ** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 */
 
-void Pipe_Write( char *json_string );
+void Pipe_Write( char *json_string, size_t json_len );
 
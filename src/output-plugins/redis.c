@@ -31,6 +31,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <hiredis/hiredis.h>
 
 #include "meer.h"
@@ -39,10 +40,10 @@
 #include "config-yaml.h"
 #include "decode-output-json-client-stats.h"
 #include "decode-json-alert.h"
+#include "decode-json.h"
 
 struct _MeerOutput *MeerOutput;
 struct _MeerConfig *MeerConfig;
-struct _MeerWaldo *MeerWaldo;
 struct _MeerCounters *MeerCounters;
 struct _MeerHealth *MeerHealth;
 
@@ -50,7 +51,12 @@ struct _MeerHealth *MeerHealth;
 uint16_t redis_batch_count = 0;
 
 char redis_batch[MAX_REDIS_BATCH][10240 + PACKET_BUFFER_SIZE_DEFAULT];
-char redis_batch_key[MAX_REDIS_BATCH][128] = {{ 0 }};
+char redis_batch_key[MAX_REDIS_BATCH][131] = {{ 0 }};
+
+/* With "decode_threads",  fingerprint lookups (decode threads) and writes
+   (the Redis output thread) share the one connection */
+
+static pthread_mutex_t RedisMutex = PTHREAD_MUTEX_INITIALIZER;
 
 void Redis_Connect( void )
 {
@@ -120,6 +126,8 @@ void Redis_Reader ( char *redis_command, char *str, size_t size )
 
     redisReply *reply;
 
+    pthread_mutex_lock(&RedisMutex);
+
     while ( MeerOutput->redis_error == true )
         {
             Redis_Connect();
@@ -160,6 +168,7 @@ void Redis_Reader ( char *redis_command, char *str, size_t size )
 
     freeReplyObject(reply);
 
+    pthread_mutex_unlock(&RedisMutex);
 
 }
 
@@ -168,114 +177,184 @@ bool Redis_Writer ( char *command, char *key, char *value, int expire )
 
     redisReply *reply;
 
-    if ( expire == 0 )
-        {
-            reply = redisCommand(MeerOutput->c_redis, "%s %s %s", command, key, value);
+    pthread_mutex_lock(&RedisMutex);
 
-            if ( MeerOutput->redis_debug )
-                {
-                    Meer_Log(DEBUG, "Sent to Redis: %s %s %s", command, key, value);
-                }
-        }
-    else
+    while ( 1 )
         {
-            reply = redisCommand(MeerOutput->c_redis, "%s %s %s EX %d", command, key, value, expire);
 
-            if ( MeerOutput->redis_debug )
+            if ( expire == 0 )
                 {
-                    Meer_Log(DEBUG, "Sent to Redis: %s %s %s EX %d", command, key, value, expire);
-                }
-        }
+                    reply = redisCommand(MeerOutput->c_redis, "%s %s %s", command, key, value);
 
-    if ( reply != NULL )
-        {
-
-            if ( MeerOutput->redis_debug )
-                {
-                    Meer_Log(DEBUG, "Write reply-str: '%s'", reply->str);
+                    if ( MeerOutput->redis_debug )
+                        {
+                            Meer_Log(DEBUG, "Sent to Redis: %s %s %s", command, key, value);
+                        }
                 }
+            else
+                {
+                    reply = redisCommand(MeerOutput->c_redis, "%s %s %s EX %d", command, key, value, expire);
 
-            /* If we get something other than "OK" from the server, abort! */
+                    if ( MeerOutput->redis_debug )
+                        {
+                            Meer_Log(DEBUG, "Sent to Redis: %s %s %s EX %d", command, key, value, expire);
+                        }
+                }
 
-            if ( strcmp(reply->str, "OK") )
+            if ( reply != NULL )
                 {
-                    Meer_Log(ERROR, "Got something other than 'OK' from server (%s).  Abort!", reply->str);
+                    break;
                 }
 
-            freeReplyObject(reply);
-        }
-    else
-        {
-
             /* Returning null likely means we got disconnected.  We throw and error
                and attempt to reconnect.  Once reconnected,  we redo out last Redis
                write so we don't drop the event! */
 
             MeerOutput->redis_error = true;
             Redis_Connect();
-            Redis_Writer ( command, key, value, expire );
 
         }
 
+    if ( MeerOutput->redis_debug )
+        {
+            Meer_Log(DEBUG, "Write reply-str: '%s'", reply->str);
+        }
+
+    /* If we get something other than "OK" from the server, abort! */
+
+    if ( strcmp(reply->str, "OK") )
+        {
+            Meer_Log(ERROR, "Got something other than 'OK' from server (%s).  Abort!", reply->str);
+        }
+
+    freeReplyObject(reply);
+
+    pthread_mutex_unlock(&RedisMutex);
+
     return(true);
 }
 
 
-void JSON_To_Redis ( const char *json_string, const char *key )
+/* SCAN for keys matching "pattern" and copy up to "max" of them into
+   "keys" (each "key_size" bytes).  The keys are copied out so the caller
+   can look them up with Redis_Reader() after we let go of the connection.
+   Returns the number of keys. */
+
+int Redis_Scan ( const char *pattern, char *keys, size_t key_size, int max )
 {
 
-    uint16_t i = 0;
+    redisReply *reply;
+    int count = 0;
+    size_t i = 0;
 
-    /* Write request to Redis queue */
+    pthread_mutex_lock(&RedisMutex);
 
-    strlcpy(redis_batch[redis_batch_count], json_string, sizeof(redis_batch[redis_batch_count]));
-    strlcpy(redis_batch_key[redis_batch_count], key, sizeof(redis_batch_key[redis_batch_count]));
+    while ( 1 )
+        {
 
-    redis_batch_count++;
+            while ( MeerOutput->redis_error == true )
+                {
+                    Redis_Connect();
+                }
 
-    /* See if Redis queue needs to be written */
+            reply = redisCommand(MeerOutput->c_redis, "SCAN 0 MATCH %s count 1000000", pattern);
 
-    if ( redis_batch_count == MeerOutput->redis_batch )
+            if ( reply != NULL )
+                {
+                    break;
+                }
+
+            /* Likely disconnected.  Reconnect and try again */
+
+            MeerOutput->redis_error = true;
+        }
+
+    if ( MeerOutput->redis_debug )
         {
+            Meer_Log(DEBUG, "[%s, line %d] Redis Command: \"SCAN 0 MATCH %s\"", __FILE__, __LINE__, pattern);
+        }
 
-            for ( i = 0; i < MeerOutput->redis_batch; i++ )
-                {
+    /* Reply is [ cursor, [ key, key, ... ] ] */
 
-                    char tk1[128] = { 0 };
-                    char tk2[131] = { 0 };
+    if ( reply->type == REDIS_REPLY_ARRAY && reply->elements == 2 &&
+            reply->element[1]->type == REDIS_REPLY_ARRAY )
+        {
 
-                    if ( MeerOutput->redis_key[0] != '\0' )
-                        {
-                            strlcpy(tk1, MeerOutput->redis_key, sizeof(tk1));
-                        }
-                    else
+            for ( i = 0; i < reply->element[1]->elements && count < max; i++ )
+                {
+
+                    if ( reply->element[1]->element[i]->type == REDIS_REPLY_STRING )
                         {
-                            strlcpy(tk1, redis_batch_key[i], sizeof(tk1));
+                            strlcpy(keys + count * key_size, reply->element[1]->element[i]->str, key_size);
+                            count++;
                         }
+                }
+        }
+    else
+        {
+            Meer_Log(WARN, "[%s, line %d] Unexpected reply to Redis SCAN for '%s'", __FILE__, __LINE__, pattern);
+        }
 
-                    strlcpy(tk2, tk1, sizeof(tk2));
+    freeReplyObject(reply);
 
-                    if ( MeerOutput->redis_append_id == true )
-                        {
+    pthread_mutex_unlock(&RedisMutex);
 
-                            snprintf(tk2, sizeof(tk2), "%s|%s|%s|%" PRIu64 "", tk1, MeerConfig->hostname, MeerConfig->interface, MeerWaldo->position);
+    return(count);
+}
+
+/* The key is built when the event is queued,  so each event in a batch
+   gets its own spool and position */
+
+void JSON_To_Redis ( struct _MeerEvent *Event, const char *json_string, const char *key )
+{
+
+    uint16_t i = 0;
+    char tk1[128] = { 0 };
+
+    if ( MeerOutput->redis_key[0] != '\0' )
+        {
+            strlcpy(tk1, MeerOutput->redis_key, sizeof(tk1));
+        }
+    else
+        {
+            strlcpy(tk1, key, sizeof(tk1));
+        }
+
+    strlcpy(redis_batch_key[redis_batch_count], tk1, sizeof(redis_batch_key[redis_batch_count]));
+
+    if ( MeerOutput->redis_append_id == true )
+        {
+
+            snprintf(redis_batch_key[redis_batch_count], sizeof(redis_batch_key[redis_batch_count]), "%s|%s|%s|%" PRIu64 "", tk1, MeerConfig->hostname, Event->spool->interface, Event->position);
 
 #ifdef BLUEDOT
 
-                            /* The "MeerOutput->sql_last_cid - 1" is an UGLY temp kludge.
-                            SQL takes place _before redis_.  This means the CID++ before
-                               the Redis insert can happen.   So we "roll" back the CID++
-                               for our Redis insert  - bleh */
+            /* The "MeerOutput->sql_last_cid - 1" is an UGLY temp kludge.
+            SQL takes place _before redis_.  This means the CID++ before
+               the Redis insert can happen.   So we "roll" back the CID++
+               for our Redis insert  - bleh */
 
-                            if ( MeerOutput->sql_enabled == true )
-                                {
-                                    snprintf(tk2, sizeof(tk2), "%s:%d:% " PRIu64 "", tk1, MeerOutput->sql_sensor_id, MeerOutput->sql_last_cid - 1 );
-                                }
+            if ( MeerOutput->sql_enabled == true )
+                {
+                    snprintf(redis_batch_key[redis_batch_count], sizeof(redis_batch_key[redis_batch_count]), "%s:%d:% " PRIu64 "", tk1, MeerOutput->sql_sensor_id, MeerOutput->sql_last_cid - 1 );
+                }
 #endif
-                        }
+        }
+
+    /* Write request to Redis queue */
 
-                    Redis_Writer ( MeerOutput->redis_command, tk2, redis_batch[i], 0 );
+    strlcpy(redis_batch[redis_batch_count], json_string, sizeof(redis_batch[redis_batch_count]));
 
+    redis_batch_count++;
+
+    /* See if Redis queue needs to be written */
+
+    if ( redis_batch_count == MeerOutput->redis_batch )
+        {
+
+            for ( i = 0; i < MeerOutput->redis_batch; i++ )
+                {
+                    Redis_Writer ( MeerOutput->redis_command, redis_batch_key[i], redis_batch[i], 0 );
                 }
 
             redis_batch_count = 0;
@@ -19,8 +19,9 @@
 
 void Redis_Connect( void );
 void Redis_Reader ( char *redis_command, char *str, size_t size );
+int Redis_Scan ( const char *pattern, char *keys, size_t key_size, int max );
 bool Redis_Writer ( const char *command, const char *key, const char *value, int expire );
-void JSON_To_Redis ( char *json_string, char *key );
+void JSON_To_Redis ( struct _MeerEvent *Event, const char *json_string, const char *key );
 void Alert_To_Redis ( struct _DecodeAlert *DecodeAlert );
 
 
@@ -44,6 +44,7 @@
 #include "output-plugins/sql.h"
 #include "lockfile.h"
 #include "sid-map.h"
+#include "sid-cache.h"
 
 #ifdef HAVE_LIBPQ
 #include <postgresql/libpq-fe.h>
@@ -364,14 +365,8 @@ void SQL_Insert_Header ( struct _DecodeAlert *DecodeAlert )
     char tmp[MAX_SQL_QUERY];
     unsigned char proto = 0;
 
-    unsigned char ip_src_bit[16];
-    uint32_t *src_ip_u32 = (uint32_t *)&ip_src_bit[0];
-
-    unsigned char ip_dst_bit[16];
-    uint32_t *dst_ip_u32 = (uint32_t *)&ip_dst_bit[0];
-
-    IP2Bit(DecodeAlert->src_ip, ip_src_bit);
-    IP2Bit(DecodeAlert->dest_ip, ip_dst_bit);
+    uint32_t *src_ip_u32 = (uint32_t *)&DecodeAlert->src_ip_bit[0];
+    uint32_t *dst_ip_u32 = (uint32_t *)&DecodeAlert->dest_ip_bit[0];
 
     if (!strcmp(DecodeAlert->proto, "TCP" ))
         {
@@ -824,7 +819,7 @@ void SQL_Insert_Metadata ( struct _DecodeAlert *DecodeAlert )
 {
 
     char tmp[MAX_SQL_QUERY] = { 0 };
-    char e_alert_metadata[1024] = { 0 };
+    char e_alert_metadata[MAX_SQL_QUERY] = { 0 };
 
     SQL_Escape_String( DecodeAlert->alert_metadata, e_alert_metadata, sizeof(e_alert_metadata));
 
@@ -1025,90 +1020,91 @@ int SQL_Legacy_Reference_Handler ( struct _DecodeAlert *DecodeAlert )
 
     char sid_map_tmp[1024] = { 0 };
 
+    uint32_t n = 0;
     int i = 0;
 
-    for (i = 0; i <  MeerCounters->SIDMapCount; i++ )
+    /* SID_Cache_Get() already found this signature's SID_Map[] entries */
+
+    for (n = 0; n < DecodeAlert->Sig->sid_map_count; n++ )
         {
 
-            if ( DecodeAlert->alert_signature_id == SID_Map[i].sid )
-                {
+            i = DecodeAlert->Sig->sid_map[n];
+
+            SQL_Escape_String( SID_Map[i].type, sid_map_tmp, sizeof(sid_map_tmp) );
+
+            snprintf(tmp, sizeof(tmp),
+                     "SELECT ref_system_id FROM reference_system WHERE ref_system_name='%s'",
+                     sid_map_tmp);
+
+            results=SQL_DB_Query(tmp);
+
+            MeerCounters->SELECTCount++;
 
-                    SQL_Escape_String( SID_Map[i].type, sid_map_tmp, sizeof(sid_map_tmp) );
+            if ( results == NULL )
+                {
 
                     snprintf(tmp, sizeof(tmp),
-                             "SELECT ref_system_id FROM reference_system WHERE ref_system_name='%s'",
+                             "INSERT INTO reference_system (ref_system_name) VALUES ('%s')",
                              sid_map_tmp);
 
-                    results=SQL_DB_Query(tmp);
-
-                    MeerCounters->SELECTCount++;
+                    (void)SQL_DB_Query(tmp);
+                    MeerCounters->INSERTCount++;
 
-                    if ( results == NULL )
-                        {
+                    results = SQL_Get_Last_ID();
 
-                            snprintf(tmp, sizeof(tmp),
-                                     "INSERT INTO reference_system (ref_system_name) VALUES ('%s')",
-                                     sid_map_tmp);
+                }
 
-                            (void)SQL_DB_Query(tmp);
-                            MeerCounters->INSERTCount++;
+            ref_system_id = atoi(results);
 
-                            results = SQL_Get_Last_ID();
+            SQL_Escape_String( SID_Map[i].location, sid_map_tmp, sizeof(sid_map_tmp) );
 
-                        }
+            snprintf(tmp, sizeof(tmp),
+                     "SELECT ref_id FROM reference WHERE ref_system_id=%d AND ref_tag='%s'",
+                     ref_system_id, sid_map_tmp);
 
-                    ref_system_id = atoi(results);
+            results=SQL_DB_Query(tmp);
+            MeerCounters->SELECTCount++;
 
-                    SQL_Escape_String( SID_Map[i].location, sid_map_tmp, sizeof(sid_map_tmp) );
+            if ( results == NULL )
+                {
 
                     snprintf(tmp, sizeof(tmp),
-                             "SELECT ref_id FROM reference WHERE ref_system_id=%d AND ref_tag='%s'",
+                             "INSERT INTO reference (ref_system_id,ref_tag) VALUES (%d, '%s')",
                              ref_system_id, sid_map_tmp);
 
-                    results=SQL_DB_Query(tmp);
-                    MeerCounters->SELECTCount++;
+                    (void)SQL_DB_Query(tmp);
+                    MeerCounters->INSERTCount++;
 
-                    if ( results == NULL )
-                        {
+                    results = SQL_Get_Last_ID();
 
-                            snprintf(tmp, sizeof(tmp),
-                                     "INSERT INTO reference (ref_system_id,ref_tag) VALUES (%d, '%s')",
-                                     ref_system_id, sid_map_tmp);
+                }
 
-                            (void)SQL_DB_Query(tmp);
-                            MeerCounters->INSERTCount++;
+            ref_id = atoi(results);
 
-                            results = SQL_Get_Last_ID();
+            sig_id = SQL_Get_Sig_ID( DecodeAlert );
 
-                        }
+            snprintf(tmp, sizeof(tmp),
+                     "SELECT sig_id FROM sig_reference WHERE sig_id=%d AND ref_id=%d",
+                     sig_id, ref_id);
 
-                    ref_id = atoi(results);
+            results=SQL_DB_Query(tmp);
+            MeerCounters->SELECTCount++;
 
-                    sig_id = SQL_Get_Sig_ID( DecodeAlert );
+            if ( results == NULL )
+                {
 
                     snprintf(tmp, sizeof(tmp),
-                             "SELECT sig_id FROM sig_reference WHERE sig_id=%d AND ref_id=%d",
-                             sig_id, ref_id);
+                             "INSERT INTO sig_reference (sig_id,ref_seq,ref_id) VALUES (%d,%d,%d)",
+                             sig_id, i, ref_id);
 
-                    results=SQL_DB_Query(tmp);
-                    MeerCounters->SELECTCount++;
-
-                    if ( results == NULL )
-                        {
-
-                            snprintf(tmp, sizeof(tmp),
-                                     "INSERT INTO sig_reference (sig_id,ref_seq,ref_id) VALUES (%d,%d,%d)",
-                                     sig_id, i, ref_id);
-
-                            (void)SQL_DB_Query(tmp);
-                            MeerCounters->INSERTCount++;
-
-                            results = SQL_Get_Last_ID();
+                    (void)SQL_DB_Query(tmp);
+                    MeerCounters->INSERTCount++;
 
-                        }
+                    results = SQL_Get_Last_ID();
 
                 }
 
+
         }
 
     return(sig_id);	/* DEBUG: Is this return right? */
@@ -36,6 +36,7 @@
 #include <unistd.h>
 
 #include "decode-json-alert.h"
+#include "decode-json.h"
 #include "decode-json-dhcp.h"
 #include "fingerprints.h"
 
@@ -45,6 +46,7 @@
 #include "output.h"
 #include "references.h"
 #include "sid-map.h"
+#include "sid-cache.h"
 #include "config-yaml.h"
 
 #include "output-plugins/sql.h"
@@ -342,60 +344,60 @@ void Init_Output( void )
  * Output_Pipe - Determines what data/JSON should be sent to the named pipe
  ****************************************************************************/
 
-bool Output_Pipe ( char *type, char *json_string )
+bool Output_Pipe ( char *type, char *json_string, size_t json_len )
 {
 
     if ( !strcmp(type, "flow" ) && MeerOutput->pipe_flow == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "http" ) && MeerOutput->pipe_http == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "smtp" ) && MeerOutput->pipe_smtp == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "ssh" ) && MeerOutput->pipe_ssh == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "tls" ) && MeerOutput->pipe_tls == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "dns" ) && MeerOutput->pipe_dns == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "alert" ) && MeerOutput->pipe_alert == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "fileinfo" ) && MeerOutput->pipe_fileinfo == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
     else if ( !strcmp(type, "dhcp" ) && MeerOutput->pipe_dhcp == true )
         {
-            Pipe_Write( json_string );
+            Pipe_Write( json_string, json_len );
             return 0;
         }
 
@@ -416,11 +418,8 @@ bool Output_Alert_SQL ( struct _DecodeAlert *DecodeAlert )
 {
 
     char tmp[MAX_SQL_QUERY] = { 0 };
-    char convert_time[16] = { 0 };
-    struct tm tm_;
 
     bool health_flag = 0;
-    int i = 0;
 
     if ( MeerOutput->sql_enabled )
         {
@@ -428,31 +427,33 @@ bool Output_Alert_SQL ( struct _DecodeAlert *DecodeAlert )
             int signature_id = 0;
             int class_id = 0;
 
-            if ( MeerConfig->health == true )
-                {
-
-                    for (i = 0 ; i < MeerCounters->HealthCount; i++ )
-                        {
-
-                            if ( MeerHealth[i].health_signature == DecodeAlert->alert_signature_id )
-                                {
-                                    health_flag = 1;
-                                    break;
-                                }
-                        }
-
-                }
+            struct _SID_Cache *Sig = DecodeAlert->Sig;
 
+            health_flag = Sig->health;
 
             if ( health_flag == 0 )
                 {
 
-                    class_id = SQL_Get_Class_ID( DecodeAlert );
+                    /* Seen this signature before?  Then we already have its ids */
+
+                    if ( Sig->sql_signature_id != 0 )
+                        {
+                            class_id = Sig->sql_class_id;
+                        }
+                    else
+                        {
+                            class_id = SQL_Get_Class_ID( DecodeAlert );
+                        }
 
                     SQL_DB_Query("START TRANSACTION");
                     MeerOutput->sql_transaction = true;
 
-                    if ( MeerOutput->sql_reference_system == true )
+                    if ( Sig->sql_signature_id != 0 )
+                        {
+                            signature_id = Sig->sql_signature_id;
+                        }
+
+                    else if ( MeerOutput->sql_reference_system == true )
                         {
 
                             signature_id = SQL_Legacy_Reference_Handler ( DecodeAlert );
@@ -473,6 +474,9 @@ bool Output_Alert_SQL ( struct _DecodeAlert *DecodeAlert )
 
                         }
 
+                    Sig->sql_signature_id = signature_id;
+                    Sig->sql_class_id = class_id;
+
                     SQL_Insert_Event( DecodeAlert, signature_id );
 
                     SQL_Insert_Header( DecodeAlert );
@@ -582,12 +586,9 @@ bool Output_Alert_SQL ( struct _DecodeAlert *DecodeAlert )
 
                     SQL_DB_Quadrant( DecodeAlert, signature_id );
 
-                    /* Convert timestamp from event to epoch */
-
-                    strptime(DecodeAlert->timestamp,"%FT%T",&tm_);
-                    strftime(convert_time, sizeof(convert_time),"%F %T",&tm_);
+                    /* Epoch was worked out when the event was decoded */
 
-                    snprintf(tmp, sizeof(tmp), "UPDATE sensor SET last_event=%d WHERE sid=%d", (int)mktime(&tm_), MeerOutput->sql_sensor_id);
+                    snprintf(tmp, sizeof(tmp), "UPDATE sensor SET last_event=%d WHERE sid=%d", (int)DecodeAlert->epoch, MeerOutput->sql_sensor_id);
 
                     SQL_DB_Query( (char*)tmp );
 
@@ -604,12 +605,9 @@ bool Output_Alert_SQL ( struct _DecodeAlert *DecodeAlert )
             else
                 {
 
-                    /* Convert timestamp from event to epoch */
-
-                    strptime(DecodeAlert->timestamp,"%FT%T",&tm_);
-                    strftime(convert_time, sizeof(convert_time),"%F %T",&tm_);
+                    /* Epoch was worked out when the event was decoded */
 
-                    snprintf(tmp, sizeof(tmp), "UPDATE sensor SET health=%d WHERE sid=%d", (int)mktime(&tm_), MeerOutput->sql_sensor_id);
+                    snprintf(tmp, sizeof(tmp), "UPDATE sensor SET health=%d WHERE sid=%d", (int)DecodeAlert->epoch, MeerOutput->sql_sensor_id);
 
                     SQL_DB_Query( (char*)tmp );
 
@@ -635,70 +633,22 @@ bool Output_Alert_SQL ( struct _DecodeAlert *DecodeAlert )
 bool Output_External ( struct _DecodeAlert *DecodeAlert )
 {
 
-    struct json_object *json_obj = NULL;
-    struct json_object *tmp = NULL;
-
-    char *policy = NULL;
-    char *meer = NULL;
-
     /* If we are executing on "all", no reason to check policies, etc */
 
     if ( MeerOutput->external_execute_on_all == true )
         {
             External( DecodeAlert );
-            json_object_put(json_obj);
             return(0);
         }
 
-    if ( DecodeAlert->alert_metadata[0] != '\0' )
-        {
-            json_obj = json_tokener_parse(DecodeAlert->alert_metadata);
-
-            if (json_object_object_get_ex(json_obj, "meer", &tmp))
-                {
-
-                    meer = (char *)json_object_get_string(tmp);
-
-                    if ( strstr( meer, "external" ) )
-                        {
-                            External( DecodeAlert );
-                            json_object_put(json_obj);
-
-
-                            /* We can return now.  We don't need to check
-                               policies, etc */
-
-                            return(0);
-                        }
-
-                }
-
-            if ( MeerOutput->external_metadata_security_ips == true ||
-                    MeerOutput->external_metadata_max_detect_ips == true ||
-                    MeerOutput->external_metadata_connectivity_ips == true ||
-                    MeerOutput->external_metadata_balanced_ips == true )
-                {
-
-                    if (json_object_object_get_ex(json_obj, "policy", &tmp))
-                        {
-
-                            policy = (char *)json_object_get_string(tmp);
-
-                            if ( ( strstr( policy, "security-ips drop" ) && MeerOutput->external_metadata_security_ips == true ) ||
-                                    ( strstr( policy, "max-detect-ips drop" ) && MeerOutput->external_metadata_max_detect_ips == true ) ||
-                                    ( strstr( policy, "balanced-ips drop" ) && MeerOutput->external_metadata_balanced_ips == true ) ||
-                                    ( strstr( policy, "connectivity-ips" ) && MeerOutput->external_metadata_connectivity_ips == true ) )
-                                {
-                                    External( DecodeAlert );
-                                }
+    /* "meer: external" or a policy we're watching.  Worked out once per
+       signature by SID_Cache_Get() */
 
-                        }
-
-                }
+    if ( DecodeAlert->Sig->external == true )
+        {
+            External( DecodeAlert );
         }
 
-    json_object_put(json_obj);
-
     return(0);
 
 }
@@ -721,7 +671,7 @@ void Output_Stats ( char *json_string )
 
     if ( json_string == NULL )
         {
-            MeerCounters->InvalidJSONCount++;
+            __sync_fetch_and_add(&MeerCounters->InvalidJSONCount, 1);
             Meer_Log(WARN, "Got invalid 'stats' JSON string: %s", json_string);
             json_object_put(json_obj);
             return;
@@ -739,7 +689,7 @@ void Output_Stats ( char *json_string )
 
     if ( timestamp == NULL )
         {
-            MeerCounters->InvalidJSONCount++;
+            __sync_fetch_and_add(&MeerCounters->InvalidJSONCount, 1);
             Meer_Log(WARN, "Warning.  Stats line lacked any 'timestamp'. Skipping. JSON: %s", json_string);
             return;
         }
@@ -763,34 +713,12 @@ void Output_Stats ( char *json_string )
 bool Output_Bluedot ( struct _DecodeAlert *DecodeAlert )
 {
 
-    struct json_object *json_obj = NULL;
-    struct json_object *tmp = NULL;
-
-    const char *meer = NULL;
-
-    if ( DecodeAlert->alert_metadata[0] != '\0' )
+    if ( DecodeAlert->Sig->bluedot == true )
         {
-            json_obj = json_tokener_parse(DecodeAlert->alert_metadata);
-
-            if (json_object_object_get_ex(json_obj, "meer", &tmp))
-                {
-
-                    meer = (char *)json_object_get_string(tmp);
-
-                    if ( strstr( meer, "bluedot" ) )
-                        {
-                            Bluedot( DecodeAlert );
-
-                            json_object_put(json_obj);
-                            return(0);
-                        }
-
-                }
-
+            Bluedot( DecodeAlert );
         }
 
-
-    json_object_put(json_obj);
+    return(0);
 
 }
 
@@ -20,7 +20,7 @@
 
 void Init_Output( void );
 bool Output_Alert_SQL ( struct _DecodeAlert *DecodeAlert );
-bool Output_Pipe ( char *type, char *json_string );
+bool Output_Pipe ( char *type, char *json_string, size_t json_len );
 bool Output_External ( struct _DecodeAlert *DecodeAlert );
 void Output_Stats ( char *json_string );
 bool Output_Bluedot ( struct _DecodeAlert *DecodeAlert );
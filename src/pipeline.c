@@ -0,0 +1,1526 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Every line read from a spool or socket comes through Pipeline_Line().
+
+   By default ("decode_threads" not set) the line is decoded and sent to the
+   outputs right there,  on the thread that read it,  like Meer always has.
+
+   With "decode_threads" set,  lines are copied into a ring of PIPELINE_DEPTH
+   slots and handed off:
+
+   reader (main thread) -> decode threads -> one thread per output -> retire
+
+   - The reader frames the line and drops it in the next slot.  If the ring
+     is full,  it waits.
+   - Decode threads (Decode_JSON()) take slots in any order.
+   - Each output thread (Output_JSON()) walks the ring in order,  so every
+     output sees events in the order they were written.  Outputs don't
+     wait on each other,  only on the slowest one once the ring is full.
+   - The retire thread walks the ring in order and,  once a slot has been
+     decoded and handled by every output,  updates that spool's waldo and
+     frees the slot.  The waldo never gets ahead of an event that hasn't
+     been completely handled,  so on a restart nothing is lost (events that
+     were in flight are handled again).
+
+   If the ring stays full for PIPELINE_LAG_TIMEOUT seconds because of one
+   output (SQL reconnecting,  Elasticsearch down,  etc),  that output is
+   left "behind".  The ring stops waiting on it and it gets its own cursor
+   in each spool (_MeerCursor,  in the waldo file).  When it recovers,  it
+   reads the spools itself from its cursors (Pipeline_Catch_Up()) and
+   rejoins the ring once it has caught up.  The other outputs carry on in
+   the meantime.  Sockets can't be re-read,  so while an output is behind
+   socket events are written to its spill queue (spill.c) in "spill_dir" and
+   it reads them back once it's done with the spools.  Without "spill_dir",
+   socket input goes to "socket_spool" (if set) instead.
+
+   All the hand-offs are done under one mutex.  The work (decoding and
+   outputs) is done outside of it. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LIBJSON_C
+#include <json-c/json.h>
+#endif
+
+#include "meer.h"
+#include "meer-def.h"
+#include "util.h"
+#include "decode-json.h"
+#include "pipeline.h"
+#include "spill.h"
+
+struct _MeerConfig *MeerConfig;
+struct _MeerOutput *MeerOutput;
+struct _MeerCounters *MeerCounters;
+struct _MeerSpool *MeerSpool;
+
+/* An event and the line it came from,  in one allocation.  The ring holds
+   a reference.  An output that is left behind in the middle of a batch
+   holds one on each event in that batch,  so the ring can move on. */
+
+typedef struct _PipelineEvent _PipelineEvent;
+struct _PipelineEvent
+{
+    struct _MeerEvent Event;
+    size_t consumed;		/* Bytes in the spool,  for the waldo */
+    uint8_t refs;
+};
+
+typedef struct _PipelineSlot _PipelineSlot;
+struct _PipelineSlot
+{
+    struct _PipelineEvent *Event;
+    bool framed;		/* Looked like JSON */
+    bool decoded;
+    uint8_t outputs_left;
+};
+
+typedef struct _PipelineOutput _PipelineOutput;
+struct _PipelineOutput
+{
+    const char *name;
+    int output;			/* OUTPUT_* */
+    int index;			/* Into _MeerSpool->cursor */
+    uint64_t seq;		/* Next event to hand to this output */
+    uint64_t end;		/* End of the batch being handled */
+    bool behind;		/* Catching up from its own cursors */
+    pthread_mutex_t busy;	/* Held while handling an event */
+    pthread_t thread;
+
+    int *fd;			/* Per spool,  while catching up */
+    char *buf;
+    size_t buf_size;
+
+    struct _MeerSpill *Spill;	/* NULL == no "spill_dir" */
+    pthread_mutex_t spill_lock;	/* Held from deciding to spill a socket event to writing it */
+    struct _PipelineEvent **spill_pending;	/* Set aside when it was left behind,  not written yet */
+    uint32_t spill_count;
+
+    uint64_t behind_count;	/* Times it was left behind */
+    uint64_t replayed;		/* Events handled while catching up */
+    uint64_t missed;		/* Socket events it never saw */
+    uint64_t spilled;		/* Socket events written to its spill queue */
+};
+
+static struct _PipelineSlot *PipelineSlot = NULL;	/* NULL == no pipeline,  work inline */
+
+static struct _PipelineOutput PipelineOutput[8];
+static uint8_t PipelineOutputCount = 0;
+static uint8_t PipelineLive = 0;		/* Outputs that aren't behind */
+
+static pthread_mutex_t PipelineMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t PipelineDecodeCond = PTHREAD_COND_INITIALIZER;	/* New lines */
+static pthread_cond_t PipelineOutputCond = PTHREAD_COND_INITIALIZER;	/* Newly decoded events */
+static pthread_cond_t PipelineRetireCond = PTHREAD_COND_INITIALIZER;	/* An output finished some events */
+static pthread_cond_t PipelineSpaceCond = PTHREAD_COND_INITIALIZER;	/* Slots were retired */
+
+static uint64_t submit_seq = 0;		/* Next slot the reader fills */
+static uint64_t decode_seq = 0;		/* Next slot a decode thread takes */
+static uint64_t checkpoint_seq = 0;	/* Oldest slot not yet in the waldo */
+static uint64_t retire_seq = 0;		/* Oldest slot still in use */
+
+#define PIPELINE_SLOT(seq)	(&PipelineSlot[(seq) % PIPELINE_DEPTH])
+
+static void *Pipeline_Decode_Thread( void *arg )
+{
+
+    struct _PipelineSlot *Slot = NULL;
+    uint64_t seq = 0;
+
+    Block_Signals();
+
+    while ( 1 )
+        {
+
+            pthread_mutex_lock(&PipelineMutex);
+
+            while ( decode_seq == submit_seq )
+                {
+                    pthread_cond_wait(&PipelineDecodeCond, &PipelineMutex);
+                }
+
+            seq = decode_seq++;
+
+            pthread_mutex_unlock(&PipelineMutex);
+
+            Slot = PIPELINE_SLOT(seq);
+
+            if ( Slot->framed == true )
+                {
+                    Decode_JSON( &Slot->Event->Event );
+                }
+
+            pthread_mutex_lock(&PipelineMutex);
+
+            Slot->decoded = true;
+
+            pthread_cond_broadcast(&PipelineOutputCond);
+
+            if ( Slot->outputs_left == 0 )
+                {
+                    pthread_cond_signal(&PipelineRetireCond);
+                }
+
+            pthread_mutex_unlock(&PipelineMutex);
+
+        }
+
+    return(NULL);
+
+}
+
+/* Check the framing of one line.  The line doesn't include the \n,  and must
+   have room for a \0 after it. */
+
+static bool Pipeline_Check_Line( char *line, size_t *len, bool warn )
+{
+
+    if ( *len > 0 && line[*len - 1] == '\r' )
+        {
+            (*len)--;
+        }
+
+    line[*len] = '\0';
+
+    if ( *len == 0 )
+        {
+            return(false);	/* Blank line, nothing to do */
+        }
+
+    if ( line[0] != '{' )
+        {
+
+            if ( warn == true )
+                {
+                    Meer_Log(WARN, "JSON \"%s\".  Doesn't appear to start as a valid JSON/EVE string. Skipping line.", line);
+                }
+
+            return(false);
+        }
+
+    if ( line[*len - 1] != '}' )
+        {
+
+            if ( warn == true )
+                {
+                    Meer_Log(WARN, "JSON: \"%s\". JSON might be truncated.  Consider increasing 'payload-buffer-size' in Suricata or Sagan. Skipping line.", line);
+                }
+
+            return(false);
+        }
+
+    return(true);
+
+}
+
+/* Leave an output behind.  Called with PipelineMutex held.  Its cursor in
+   each spool is the waldo plus whatever it has handled past the waldo.
+   The batch it's in the middle of (seq to end) is added when it finishes.
+   Nothing in the ring is waiting on it after this.  Socket events for its
+   spill queue are only set aside here,  the caller writes them with
+   Pipeline_Spill_Pending() once it lets go of PipelineMutex. */
+
+static void Pipeline_Leave_Behind( struct _PipelineOutput *Output )
+{
+
+    struct _PipelineSlot *Slot = NULL;
+    struct _MeerCursor *Cursor = NULL;
+    struct stat st;
+    uint64_t seq = 0;
+    uint32_t i = 0;
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+
+            Cursor = &MeerSpool[i].cursor[Output->index];
+
+            Cursor->position = MeerSpool[i].waldo->position;
+            Cursor->offset = MeerSpool[i].waldo->offset;
+            Cursor->inode = MeerSpool[i].waldo->inode;
+            Cursor->behind = 1;
+
+            /* Open the spool now,  so if it's rotated before the output gets
+               going again it can still finish the old one */
+
+            if ( MeerSpool[i].type == SPOOL_TYPE_FILE && Output->fd[i] == -1 &&
+                    ( Output->fd[i] = open( MeerSpool[i].filename, O_RDONLY ) ) != -1 &&
+                    ( fstat( Output->fd[i], &st ) != 0 || (uint64_t)st.st_ino != Cursor->inode ) )
+                {
+                    close( Output->fd[i] );
+                    Output->fd[i] = -1;
+                }
+
+        }
+
+    for ( seq = checkpoint_seq; seq < Output->seq; seq++ )
+        {
+            Slot = PIPELINE_SLOT(seq);
+            Slot->Event->Event.spool->cursor[Output->index].position++;
+            Slot->Event->Event.spool->cursor[Output->index].offset += Slot->Event->consumed;
+        }
+
+    /* The batch it's working on.  It keeps these events,  not the slots */
+
+    for ( seq = Output->seq; seq < Output->end; seq++ )
+        {
+            Slot = PIPELINE_SLOT(seq);
+            Slot->Event->refs++;
+            Slot->outputs_left--;
+        }
+
+    for ( seq = Output->end; seq < submit_seq; seq++ )
+        {
+            PIPELINE_SLOT(seq)->outputs_left--;
+        }
+
+    /* Socket events it hasn't finished with can't be read again.  Those in
+       its batch are spilled too,  in case it never gets through them. */
+
+    for ( seq = Output->seq; seq < submit_seq; seq++ )
+        {
+
+            Slot = PIPELINE_SLOT(seq);
+
+            if ( Slot->Event->Event.spool->type != SPOOL_TYPE_SOCKET || Slot->framed == false )
+                {
+                    continue;
+                }
+
+            if ( Output->Spill != NULL )
+                {
+                    Slot->Event->refs++;
+                    Output->spill_pending[Output->spill_count++] = Slot->Event;
+                }
+            else if ( seq >= Output->end )
+                {
+                    Output->missed++;
+                }
+        }
+
+    Output->behind = true;
+    Output->behind_count++;
+    PipelineLive--;
+
+    Meer_Log(WARN, "The '%s' output is falling behind.  Leaving it to catch up on its own.", Output->name);
+
+    pthread_cond_signal(&PipelineRetireCond);
+    pthread_cond_broadcast(&PipelineOutputCond);
+
+}
+
+/* Move an output's cursor.  Pipeline_Consumed() reads it under
+   PipelineMutex and has to see the inode and offset change together,  or
+   the follower could drop spool data the output hasn't read yet. */
+
+static void Pipeline_Cursor_Set( struct _MeerCursor *Cursor, uint64_t position, uint64_t offset, uint64_t inode )
+{
+
+    pthread_mutex_lock(&PipelineMutex);
+
+    Cursor->position = position;
+    Cursor->offset = offset;
+    Cursor->inode = inode;
+
+    pthread_mutex_unlock(&PipelineMutex);
+
+}
+
+/* Decode and output one line read by an output that's catching up */
+
+static void Pipeline_Catch_Up_Line( struct _PipelineOutput *Output, struct _MeerSpool *Spool, uint64_t position, char *line, size_t len )
+{
+
+    struct _MeerEvent Event;
+
+    if ( Pipeline_Check_Line( line, &len, false ) == true )
+        {
+
+            memset(&Event, 0, sizeof(_MeerEvent));
+
+            Event.spool = Spool;
+            Event.position = position;
+            Event.json_string = line;
+            Event.json_len = len;
+
+            Decode_JSON( &Event );
+
+            pthread_mutex_lock(&Output->busy);
+            Output_JSON( &Event, Output->output );
+            pthread_mutex_unlock(&Output->busy);
+
+            Free_JSON( &Event );
+
+            Output->replayed++;
+        }
+
+}
+
+/* Read one spool from this output's cursor up to where the reader is.
+   Returns true if the cursor is there. */
+
+static bool Pipeline_Catch_Up_Spool( struct _PipelineOutput *Output, uint32_t s )
+{
+
+    struct _MeerSpool *Spool = &MeerSpool[s];
+    struct _MeerCursor *Cursor = &Spool->cursor[Output->index];
+    struct stat st;
+
+    uint64_t target = 0;
+    uint64_t inode = 0;
+    uint64_t end = 0;
+    uint64_t position = 0;
+    uint64_t offset = 0;
+    uint64_t cursor_inode = 0;
+    size_t want = 0;
+    ssize_t got = 0;
+    char *start = NULL;
+    char *nl = NULL;
+
+    pthread_mutex_lock(&PipelineMutex);
+    target = Spool->waldo->offset + Spool->in_flight_bytes;
+    inode = Spool->waldo->inode;
+    position = Cursor->position;
+    offset = Cursor->offset;
+    cursor_inode = Cursor->inode;
+    pthread_mutex_unlock(&PipelineMutex);
+
+    /* We're the only one moving the cursor while the output is behind,  so
+       work on copies and publish them with Pipeline_Cursor_Set() */
+
+    if ( Output->fd[s] == -1 )
+        {
+
+            if ( ( Output->fd[s] = open( Spool->filename, O_RDONLY ) ) == -1 )
+                {
+                    return(false);
+                }
+
+#ifdef HAVE_POSIX_FADVISE
+            posix_fadvise( Output->fd[s], 0, 0, POSIX_FADV_SEQUENTIAL );
+#endif
+
+            if ( fstat( Output->fd[s], &st ) == 0 )
+                {
+
+                    /* The spool we were in was replaced before we got back to it */
+
+                    if ( cursor_inode != 0 && cursor_inode != (uint64_t)st.st_ino )
+                        {
+                            Meer_Log(WARN, "%s was rotated before the '%s' output caught up.  Events past position %" PRIu64 " in the old file were missed.", Spool->filename, Output->name, position);
+                            position = 0;
+                            offset = 0;
+                        }
+
+                    cursor_inode = (uint64_t)st.st_ino;
+                    Pipeline_Cursor_Set( Cursor, position, offset, cursor_inode );
+                }
+
+        }
+
+    /* Still in the spool the reader was in before a rotation?  Read it to the
+       end.  Otherwise read up to the reader. */
+
+    end = ( inode == 0 || cursor_inode == inode ) ? target : UINT64_MAX;
+
+    if ( end != UINT64_MAX && offset > end )
+        {
+            Meer_Log(WARN, "%s was truncated before the '%s' output caught up.", Spool->filename, Output->name);
+            position = 0;
+            offset = 0;
+            Pipeline_Cursor_Set( Cursor, position, offset, cursor_inode );
+        }
+
+    while ( offset < end )
+        {
+
+            want = end - offset < Output->buf_size ? end - offset : Output->buf_size;
+
+            if ( ( got = pread( Output->fd[s], Output->buf, want, offset ) ) <= 0 )
+                {
+                    break;
+                }
+
+            start = Output->buf;
+
+            while ( ( nl = memchr( start, '\n', Output->buf + got - start ) ) != NULL )
+                {
+                    Pipeline_Catch_Up_Line( Output, Spool, position, start, nl - start );
+                    position++;
+                    offset += ( nl - start ) + 1;
+                    start = nl + 1;
+                }
+
+            if ( start == Output->buf )
+                {
+
+                    if ( (size_t)got < Output->buf_size )
+                        {
+                            break;		/* Partial line at the end of the file */
+                        }
+
+                    /* Line is longer than the buffer */
+
+                    Output->buf_size *= 2;
+
+                    if (( Output->buf = realloc( Output->buf, Output->buf_size + 1 ) ) == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for catch up buffer. Abort!", __FILE__, __LINE__);
+                        }
+                }
+            else
+                {
+                    Pipeline_Cursor_Set( Cursor, position, offset, cursor_inode );
+                }
+
+        }
+
+    if ( end != UINT64_MAX )
+        {
+            return( offset == target );
+        }
+
+    /* The end of the old spool.  The reader treats what's left as a line
+       when it drains a rotated spool,  so we do too. */
+
+    if ( ( got = pread( Output->fd[s], Output->buf, Output->buf_size, offset ) ) > 0 )
+        {
+            Pipeline_Catch_Up_Line( Output, Spool, position, Output->buf, got );
+        }
+
+    close( Output->fd[s] );
+    Output->fd[s] = -1;
+
+    Pipeline_Cursor_Set( Cursor, 0, 0, inode );
+
+    return(false);
+
+}
+
+/* Replay what was spilled while the output was behind */
+
+static void Pipeline_Catch_Up_Spill( struct _PipelineOutput *Output )
+{
+
+    struct _MeerSpool *Spool = NULL;
+    struct _MeerEvent Event;
+    char *spool = NULL;
+    char *json = NULL;
+    uint64_t position = 0;
+    size_t len = 0;
+    uint32_t i = 0;
+
+    while ( Spill_Read( Output->Spill, &spool, &position, &json, &len ) == true )
+        {
+
+            Spool = NULL;
+
+            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                {
+
+                    if ( !strcmp( MeerSpool[i].filename, spool ) )
+                        {
+                            Spool = &MeerSpool[i];
+                            break;
+                        }
+                }
+
+            if ( Spool != NULL )
+                {
+
+                    memset(&Event, 0, sizeof(_MeerEvent));
+
+                    Event.spool = Spool;
+                    Event.position = position;
+                    Event.json_string = json;
+                    Event.json_len = len;
+
+                    Decode_JSON( &Event );
+
+                    pthread_mutex_lock(&Output->busy);
+                    Output_JSON( &Event, Output->output );
+                    pthread_mutex_unlock(&Output->busy);
+
+                    Free_JSON( &Event );
+
+                    Output->replayed++;
+
+                }
+            else
+                {
+                    Meer_Log(WARN, "Spilled event for the '%s' output is from %s,  which isn't configured anymore.  Skipping.", Output->name, spool);
+                    Output->missed++;
+                }
+
+            Spill_Commit( Output->Spill );
+
+        }
+
+}
+
+/* Catch an output up from its cursors.  Returns once it has rejoined the
+   ring. */
+
+static void Pipeline_Catch_Up( struct _PipelineOutput *Output )
+{
+
+    struct _MeerSpool *Spool = NULL;
+    uint64_t replayed = 0;
+    uint32_t i = 0;
+    bool caught_up = false;
+
+    Meer_Log(NORMAL, "The '%s' output is catching up.", Output->name);
+
+    while ( 1 )
+        {
+
+            caught_up = true;
+            replayed = Output->replayed;
+
+            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                {
+
+                    if ( MeerSpool[i].type == SPOOL_TYPE_FILE && Pipeline_Catch_Up_Spool( Output, i ) == false )
+                        {
+                            caught_up = false;
+                        }
+                }
+
+            if ( Output->Spill != NULL )
+                {
+                    Pipeline_Catch_Up_Spill( Output );
+                }
+
+            if ( caught_up == true )
+                {
+
+                    /* The reader may have moved on since we looked.  It
+                       can't spill anything more for us while we decide. */
+
+                    if ( Output->Spill != NULL )
+                        {
+                            pthread_mutex_lock(&Output->spill_lock);
+                            caught_up = Spill_Empty( Output->Spill );
+                        }
+
+                    pthread_mutex_lock(&PipelineMutex);
+
+                    /* Left behind again and its spill isn't written yet */
+
+                    if ( Output->spill_count != 0 )
+                        {
+                            caught_up = false;
+                        }
+
+                    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                        {
+
+                            Spool = &MeerSpool[i];
+
+                            if ( Spool->type == SPOOL_TYPE_FILE &&
+                                    ( Spool->cursor[Output->index].inode != Spool->waldo->inode ||
+                                      Spool->cursor[Output->index].offset != Spool->waldo->offset + Spool->in_flight_bytes ) )
+                                {
+                                    caught_up = false;
+                                }
+                        }
+
+                    if ( caught_up == true )
+                        {
+
+                            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                                {
+                                    MeerSpool[i].cursor[Output->index].behind = 0;
+                                }
+
+                            Output->seq = submit_seq;
+                            Output->end = submit_seq;
+                            Output->behind = false;
+                            PipelineLive++;
+                        }
+
+                    pthread_mutex_unlock(&PipelineMutex);
+
+                    if ( Output->Spill != NULL )
+                        {
+                            pthread_mutex_unlock(&Output->spill_lock);
+                        }
+
+                    if ( caught_up == true )
+                        {
+                            break;
+                        }
+
+                }
+
+            if ( Output->replayed == replayed )
+                {
+                    usleep( PIPELINE_CATCHUP_SLEEP );
+                }
+
+        }
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+
+            if ( Output->fd[i] != -1 )
+                {
+                    close( Output->fd[i] );
+                    Output->fd[i] = -1;
+                }
+        }
+
+    Meer_Log(NORMAL, "The '%s' output has caught up.", Output->name);
+
+}
+
+static void Pipeline_Free_Event( struct _PipelineEvent *Event )
+{
+    Free_JSON( &Event->Event );
+    free( Event );
+}
+
+/* Write what Pipeline_Leave_Behind() set aside for an output's spill queue.
+   Called without PipelineMutex,  Spill_Write() may fdatasync().  Until
+   spill_count is back to 0 the output can't rejoin.  "locked" is true if
+   the caller already holds its spill_lock. */
+
+static void Pipeline_Spill_Pending( struct _PipelineOutput *Output, bool locked )
+{
+
+    struct _PipelineEvent *Event = NULL;
+    uint32_t i = 0;
+
+    if ( locked == false )
+        {
+            pthread_mutex_lock(&Output->spill_lock);
+        }
+
+    for ( i = 0; i < Output->spill_count; i++ )
+        {
+            Event = Output->spill_pending[i];
+            Spill_Write( Output->Spill, Event->Event.spool->filename, Event->Event.position, Event->Event.json_string, Event->Event.json_len );
+            Output->spilled++;
+        }
+
+    pthread_mutex_lock(&PipelineMutex);
+
+    for ( i = 0; i < Output->spill_count; i++ )
+        {
+            if ( --Output->spill_pending[i]->refs != 0 )
+                {
+                    Output->spill_pending[i] = NULL;
+                }
+        }
+
+    pthread_mutex_unlock(&PipelineMutex);
+
+    for ( i = 0; i < Output->spill_count; i++ )
+        {
+            if ( Output->spill_pending[i] != NULL )
+                {
+                    Pipeline_Free_Event( Output->spill_pending[i] );
+                }
+        }
+
+    Output->spill_count = 0;
+
+    if ( locked == false )
+        {
+            pthread_mutex_unlock(&Output->spill_lock);
+        }
+
+}
+
+static void *Pipeline_Output_Thread( void *arg )
+{
+
+    struct _PipelineOutput *Output = (struct _PipelineOutput *) arg;
+    struct _PipelineEvent *Batch[PIPELINE_BATCH];
+    struct _PipelineEvent *Event = NULL;
+    uint64_t seq = 0;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    Block_Signals();
+
+    while ( 1 )
+        {
+
+            if ( Output->behind == true )
+                {
+                    Pipeline_Catch_Up( Output );
+                }
+
+            pthread_mutex_lock(&PipelineMutex);
+
+            while ( Output->behind == false && ( Output->seq == submit_seq || PIPELINE_SLOT(Output->seq)->decoded == false ) )
+                {
+                    pthread_cond_wait(&PipelineOutputCond, &PipelineMutex);
+                }
+
+            if ( Output->behind == true )
+                {
+                    pthread_mutex_unlock(&PipelineMutex);
+                    continue;
+                }
+
+            /* Take everything that's ready (up to PIPELINE_BATCH) */
+
+            for ( Output->end = Output->seq; Output->end < submit_seq && Output->end - Output->seq < PIPELINE_BATCH && PIPELINE_SLOT(Output->end)->decoded == true; Output->end++ )
+                {
+                    Batch[Output->end - Output->seq] = PIPELINE_SLOT(Output->end)->Event;
+                }
+
+            count = Output->end - Output->seq;
+
+            pthread_mutex_unlock(&PipelineMutex);
+
+            for ( i = 0; i < count; i++ )
+                {
+                    pthread_mutex_lock(&Output->busy);
+                    Output_JSON( &Batch[i]->Event, Output->output );
+                    pthread_mutex_unlock(&Output->busy);
+                }
+
+            pthread_mutex_lock(&PipelineMutex);
+
+            if ( Output->behind == false )
+                {
+
+                    for ( seq = Output->seq; seq < Output->end; seq++ )
+                        {
+                            PIPELINE_SLOT(seq)->outputs_left--;
+                        }
+
+                    Output->seq = Output->end;
+
+                    pthread_cond_signal(&PipelineRetireCond);
+                    pthread_mutex_unlock(&PipelineMutex);
+                    continue;
+
+                }
+
+            /* Left behind while we were busy.  The ring has moved on without
+               these,  they go in our cursors and we let go of them. */
+
+            for ( i = 0; i < count; i++ )
+                {
+
+                    Event = Batch[i];
+
+                    Event->Event.spool->cursor[Output->index].position++;
+                    Event->Event.spool->cursor[Output->index].offset += Event->consumed;
+
+                    if ( --Event->refs != 0 )
+                        {
+                            Batch[i] = NULL;
+                        }
+                }
+
+            Output->seq = Output->end;
+
+            pthread_mutex_unlock(&PipelineMutex);
+
+            for ( i = 0; i < count; i++ )
+                {
+
+                    if ( Batch[i] != NULL )
+                        {
+                            Pipeline_Free_Event( Batch[i] );
+                        }
+                }
+
+        }
+
+    return(NULL);
+
+}
+
+static void *Pipeline_Retire_Thread( void *arg )
+{
+
+    struct _PipelineSlot *Slot = NULL;
+    uint64_t seq = 0;
+    uint64_t end = 0;
+
+    Block_Signals();
+
+    while ( 1 )
+        {
+
+            pthread_mutex_lock(&PipelineMutex);
+
+            while ( checkpoint_seq == submit_seq || PIPELINE_SLOT(checkpoint_seq)->decoded == false || PIPELINE_SLOT(checkpoint_seq)->outputs_left != 0 )
+                {
+                    pthread_cond_wait(&PipelineRetireCond, &PipelineMutex);
+                }
+
+            end = checkpoint_seq;
+
+            while ( end < submit_seq && PIPELINE_SLOT(end)->decoded == true && PIPELINE_SLOT(end)->outputs_left == 0 )
+                {
+                    end++;
+                }
+
+            for ( seq = checkpoint_seq; seq < end; seq++ )
+                {
+
+                    Slot = PIPELINE_SLOT(seq);
+
+                    Slot->Event->Event.spool->waldo->position++;
+                    Slot->Event->Event.spool->waldo->offset += Slot->Event->consumed;
+                    Slot->Event->Event.spool->in_flight--;
+                    Slot->Event->Event.spool->in_flight_bytes -= Slot->Event->consumed;
+
+                    /* Someone that was left behind still has it */
+
+                    if ( --Slot->Event->refs != 0 )
+                        {
+                            Slot->Event = NULL;
+                        }
+
+                }
+
+            checkpoint_seq = end;
+
+            pthread_mutex_unlock(&PipelineMutex);
+
+            /* Nobody else touches these slots until we give them back */
+
+            for ( seq = retire_seq; seq < end; seq++ )
+                {
+
+                    Slot = PIPELINE_SLOT(seq);
+
+                    if ( Slot->Event != NULL )
+                        {
+                            Pipeline_Free_Event( Slot->Event );
+                        }
+
+                }
+
+            pthread_mutex_lock(&PipelineMutex);
+
+            retire_seq = end;
+
+            pthread_cond_broadcast(&PipelineSpaceCond);
+            pthread_mutex_unlock(&PipelineMutex);
+
+        }
+
+    return(NULL);
+
+}
+
+static void Pipeline_Add_Output( const char *name, int output )
+{
+
+    struct _PipelineOutput *Output = &PipelineOutput[PipelineOutputCount];
+    uint32_t i = 0;
+
+    Output->name = name;
+    Output->output = output;
+    Output->index = ffs(output) - 1;
+    Output->seq = 0;
+    Output->end = 0;
+    Output->behind = false;
+
+    pthread_mutex_init(&Output->busy, NULL);
+
+    /* Globs can add spools later,  see Pipeline_Add_Spool() */
+
+    if (( Output->fd = malloc( sizeof(int) * MAX_SPOOLS ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for pipeline output. Abort!", __FILE__, __LINE__);
+        }
+
+    for ( i = 0; i < MAX_SPOOLS; i++ )
+        {
+            Output->fd[i] = -1;
+        }
+
+    Output->buf_size = PIPELINE_CATCHUP_BUFFER;
+
+    if (( Output->buf = malloc( Output->buf_size + 1 ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for pipeline output. Abort!", __FILE__, __LINE__);
+        }
+
+    /* Was it behind when we last stopped? */
+
+    for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+        {
+
+            if ( MeerSpool[i].cursor[Output->index].behind != 0 )
+                {
+                    Output->behind = true;
+                }
+        }
+
+    if ( MeerConfig->spill_dir[0] != '\0' )
+        {
+
+            Output->Spill = Spill_Open( MeerConfig->spill_dir, name );
+            pthread_mutex_init(&Output->spill_lock, NULL);
+
+            if (( Output->spill_pending = malloc( sizeof(struct _PipelineEvent *) * PIPELINE_DEPTH ) ) == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for pipeline output. Abort!", __FILE__, __LINE__);
+                }
+
+            if ( Spill_Empty( Output->Spill ) == false )
+                {
+                    Output->behind = true;
+                }
+        }
+
+    if ( Output->behind == true )
+        {
+
+            Meer_Log(NORMAL, "The '%s' output was behind when Meer stopped.", name);
+
+            /* Spools it wasn't behind in (new ones) start where the reader is */
+
+            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                {
+
+                    if ( MeerSpool[i].cursor[Output->index].behind == 0 )
+                        {
+                            MeerSpool[i].cursor[Output->index].position = MeerSpool[i].waldo->position;
+                            MeerSpool[i].cursor[Output->index].offset = MeerSpool[i].waldo->offset;
+                            MeerSpool[i].cursor[Output->index].inode = MeerSpool[i].waldo->inode;
+                            MeerSpool[i].cursor[Output->index].behind = 1;
+                        }
+                }
+        }
+    else
+        {
+            PipelineLive++;
+        }
+
+    PipelineOutputCount++;
+
+}
+
+static void Pipeline_Thread( void *(*func)(void *), void *arg, pthread_t *thread )
+{
+
+    pthread_attr_t attr;
+    pthread_t tmp;
+    int ret = 0;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_attr_setstacksize(&attr, PIPELINE_STACK_SIZE);
+
+    if ( ( ret = pthread_create( thread != NULL ? thread : &tmp, &attr, func, arg ) ) != 0 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot create pipeline thread [%s]. Abort!", __FILE__, __LINE__, strerror(ret));
+        }
+
+    pthread_attr_destroy(&attr);
+
+}
+
+void Init_Pipeline( void )
+{
+
+    uint32_t i = 0;
+
+    if ( MeerConfig->decode_threads == 0 )
+        {
+            return;
+        }
+
+    if (( PipelineSlot = calloc( PIPELINE_DEPTH, sizeof(_PipelineSlot) ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for the pipeline. Abort!", __FILE__, __LINE__);
+        }
+
+    /* One thread per output.  Each output's state (connections,  batches,
+       etc) is only ever touched by its own thread. */
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+
+    if ( MeerOutput->sql_enabled == true )
+        {
+            Pipeline_Add_Output( "sql", OUTPUT_SQL );
+        }
+
+#endif
+
+#ifdef HAVE_LIBHIREDIS
+
+    if ( MeerOutput->redis_flag == true )
+        {
+            Pipeline_Add_Output( "redis", OUTPUT_REDIS );
+        }
+
+#endif
+
+    if ( MeerOutput->pipe_enabled == true )
+        {
+            Pipeline_Add_Output( "pipe", OUTPUT_PIPE );
+        }
+
+    if ( MeerOutput->external_enabled == true )
+        {
+            Pipeline_Add_Output( "external", OUTPUT_EXTERNAL );
+        }
+
+#ifdef WITH_BLUEDOT
+
+    if ( MeerOutput->bluedot_flag == true )
+        {
+            Pipeline_Add_Output( "bluedot", OUTPUT_BLUEDOT );
+        }
+
+#endif
+
+#ifdef WITH_ELASTICSEARCH
+
+    if ( MeerOutput->elasticsearch_flag == true )
+        {
+            Pipeline_Add_Output( "elasticsearch", OUTPUT_ELASTICSEARCH );
+        }
+
+#endif
+
+    for ( i = 0; i < MeerConfig->decode_threads; i++ )
+        {
+            Pipeline_Thread( Pipeline_Decode_Thread, NULL, NULL );
+        }
+
+    for ( i = 0; i < PipelineOutputCount; i++ )
+        {
+            Pipeline_Thread( Pipeline_Output_Thread, &PipelineOutput[i], &PipelineOutput[i].thread );
+        }
+
+    Pipeline_Thread( Pipeline_Retire_Thread, NULL, NULL );
+
+    Meer_Log(NORMAL, "Pipeline: %d decode thread(s),  %d output thread(s),  %d events deep.", MeerConfig->decode_threads, PipelineOutputCount, PIPELINE_DEPTH);
+
+}
+
+/* One line from a spool or socket.  "consumed" is how far the spool's waldo
+   offset moves once it's been handled. */
+
+void Pipeline_Line( struct _MeerSpool *Spool, char *line, size_t len, size_t consumed )
+{
+
+    struct _MeerEvent Event;
+    struct _PipelineSlot *Slot = NULL;
+    struct timespec ts;
+    uint64_t position = 0;
+    uint32_t spill = 0;		/* Outputs to spill this event for */
+    uint32_t spill_pending = 0;	/* Outputs just left behind */
+    uint8_t i = 0;
+    bool framed = Pipeline_Check_Line( line, &len, true );
+    bool spilling = MeerConfig->spill_dir[0] != '\0' && Spool->type == SPOOL_TYPE_SOCKET && framed == true;
+
+    if ( PipelineSlot == NULL )
+        {
+
+            if ( framed == true )
+                {
+
+                    memset(&Event, 0, sizeof(_MeerEvent));
+
+                    Event.spool = Spool;
+                    Event.position = Spool->waldo->position;
+                    Event.json_string = line;
+                    Event.json_len = len;
+
+                    Decode_JSON( &Event );
+                    Output_JSON( &Event, OUTPUT_ALL );
+                    Free_JSON( &Event );
+
+                }
+
+            Spool->waldo->position++;
+            Spool->waldo->offset += consumed;
+
+            return;
+        }
+
+    /* Socket events can't be read again.  Outputs that are behind get them
+       in their spill queue,  and can't rejoin until they have been written. */
+
+    if ( spilling == true )
+        {
+
+            for ( i = 0; i < PipelineOutputCount; i++ )
+                {
+                    pthread_mutex_lock(&PipelineOutput[i].spill_lock);
+                }
+        }
+
+    pthread_mutex_lock(&PipelineMutex);
+
+    while ( submit_seq - retire_seq == PIPELINE_DEPTH )
+        {
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += PIPELINE_LAG_TIMEOUT;
+
+            if ( pthread_cond_timedwait(&PipelineSpaceCond, &PipelineMutex, &ts) != ETIMEDOUT ||
+                    submit_seq - retire_seq != PIPELINE_DEPTH ||
+                    PIPELINE_SLOT(checkpoint_seq)->decoded == false )
+                {
+                    continue;
+                }
+
+            /* Still full.  Leave behind whichever outputs haven't handled the
+               oldest event,  as long as someone is left to keep going (or
+               everything can be caught up on later). */
+
+            for ( i = 0; i < PipelineOutputCount; i++ )
+                {
+
+                    if ( PipelineOutput[i].behind == false && PipelineOutput[i].seq <= checkpoint_seq &&
+                            ( PipelineLive > 1 || MeerConfig->spill_dir[0] != '\0' ) )
+                        {
+                            Pipeline_Leave_Behind( &PipelineOutput[i] );
+                            spill_pending |= 1 << i;
+                        }
+                }
+
+            /* Nobody else waits while their spill queues are written */
+
+            if ( spill_pending != 0 && MeerConfig->spill_dir[0] != '\0' )
+                {
+
+                    pthread_mutex_unlock(&PipelineMutex);
+
+                    for ( i = 0; i < PipelineOutputCount; i++ )
+                        {
+                            if ( spill_pending & ( 1 << i ) )
+                                {
+                                    Pipeline_Spill_Pending( &PipelineOutput[i], spilling );
+                                }
+                        }
+
+                    pthread_mutex_lock(&PipelineMutex);
+
+                }
+
+            spill_pending = 0;
+
+        }
+
+    position = Spool->waldo->position + Spool->in_flight;
+
+    pthread_mutex_unlock(&PipelineMutex);
+
+    /* This slot has been retired,  so it's ours until we hand it off */
+
+    Slot = PIPELINE_SLOT(submit_seq);
+
+    if (( Slot->Event = malloc( sizeof(_PipelineEvent) + len + 1 ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for pipeline line. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(&Slot->Event->Event, 0, sizeof(_MeerEvent));
+
+    Slot->Event->Event.spool = Spool;
+    Slot->Event->Event.position = position;
+    Slot->Event->Event.json_string = (char *) ( Slot->Event + 1 );
+    Slot->Event->Event.json_len = len;
+    Slot->Event->consumed = consumed;
+    Slot->Event->refs = 1;
+
+    memcpy( Slot->Event->Event.json_string, line, len + 1 );
+
+    Slot->decoded = false;
+
+    pthread_mutex_lock(&PipelineMutex);
+
+    Slot->framed = framed == true && PipelineLive > 0;	/* No one to decode it for */
+    Slot->outputs_left = PipelineLive;
+
+    Spool->in_flight++;
+    Spool->in_flight_bytes += consumed;
+    submit_seq++;
+
+    for ( i = 0; i < PipelineOutputCount; i++ )
+        {
+
+            if ( PipelineOutput[i].behind == true )
+                {
+                    spill |= 1 << i;
+                }
+        }
+
+    pthread_cond_signal(&PipelineDecodeCond);
+    pthread_mutex_unlock(&PipelineMutex);
+
+    if ( spilling == false )
+        {
+            return;
+        }
+
+    for ( i = 0; i < PipelineOutputCount; i++ )
+        {
+
+            if ( spill & ( 1 << i ) )
+                {
+                    Spill_Write( PipelineOutput[i].Spill, Spool->filename, position, line, len );
+                    PipelineOutput[i].spilled++;
+                }
+
+            pthread_mutex_unlock(&PipelineOutput[i].spill_lock);
+        }
+
+}
+
+/* Is any output behind?  Sockets spool to disk while one is,  so it can
+   catch up on those events too.  Not needed when outputs have their own
+   spill queue. */
+
+bool Pipeline_Lagging( void )
+{
+
+    bool lagging = false;
+
+    if ( PipelineSlot == NULL || MeerConfig->spill_dir[0] != '\0' )
+        {
+            return(false);
+        }
+
+    pthread_mutex_lock(&PipelineMutex);
+    lagging = PipelineLive < PipelineOutputCount;
+    pthread_mutex_unlock(&PipelineMutex);
+
+    return(lagging);
+
+}
+
+/* A glob found spool "s" after we started.  Outputs that are behind read it
+   from the top,  same as the reader. */
+
+void Pipeline_Add_Spool( uint32_t s )
+{
+
+    struct _MeerCursor *Cursor = NULL;
+    uint8_t i = 0;
+
+    if ( PipelineSlot == NULL )
+        {
+            return;		/* Init_Pipeline() will see it */
+        }
+
+    pthread_mutex_lock(&PipelineMutex);
+
+    for ( i = 0; i < PipelineOutputCount; i++ )
+        {
+
+            Cursor = &MeerSpool[s].cursor[PipelineOutput[i].index];
+
+            Cursor->position = 0;
+            Cursor->offset = 0;
+            Cursor->inode = 0;
+            Cursor->behind = PipelineOutput[i].behind == true ? 1 : 0;
+
+            PipelineOutput[i].fd[s] = -1;
+        }
+
+    pthread_mutex_unlock(&PipelineMutex);
+
+}
+
+/* How far into a spool every output is done with.  That's the waldo,  unless
+   an output that's behind still needs to read from further back. */
+
+uint64_t Pipeline_Consumed( struct _MeerSpool *Spool )
+{
+
+    struct _MeerCursor *Cursor = NULL;
+    uint64_t consumed = 0;
+    uint8_t i = 0;
+
+    if ( PipelineSlot == NULL )
+        {
+            return( Spool->waldo->offset );
+        }
+
+    pthread_mutex_lock(&PipelineMutex);
+
+    consumed = Spool->waldo->offset;
+
+    for ( i = 0; i < PipelineOutputCount; i++ )
+        {
+
+            Cursor = &Spool->cursor[PipelineOutput[i].index];
+
+            if ( PipelineOutput[i].behind == true && Cursor->inode == Spool->waldo->inode && Cursor->offset < consumed )
+                {
+                    consumed = Cursor->offset;
+                }
+        }
+
+    pthread_mutex_unlock(&PipelineMutex);
+
+    return(consumed);
+
+}
+
+/* Wait until everything handed to the pipeline has been handled and
+   checkpointed.  Used before a waldo is reset. */
+
+void Pipeline_Flush( void )
+{
+
+    if ( PipelineSlot == NULL )
+        {
+            return;
+        }
+
+    pthread_mutex_lock(&PipelineMutex);
+
+    while ( retire_seq != submit_seq )
+        {
+            pthread_cond_wait(&PipelineSpaceCond, &PipelineMutex);
+        }
+
+    pthread_mutex_unlock(&PipelineMutex);
+
+}
+
+/* On shutdown,  make sure no output thread is in the middle of something
+   (a SQL transaction,  etc) and keep them from starting anything new.  An
+   output that is stuck (reconnecting,  etc) is given PIPELINE_STOP_TIMEOUT
+   seconds. */
+
+void Pipeline_Stop( void )
+{
+
+    struct timespec ts;
+    uint8_t i = 0;
+
+    if ( PipelineSlot == NULL )
+        {
+            return;
+        }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += PIPELINE_STOP_TIMEOUT;
+
+    for ( i = 0; i < PipelineOutputCount; i++ )
+        {
+
+            if ( pthread_mutex_timedlock(&PipelineOutput[i].busy, &ts) != 0 )
+                {
+                    Meer_Log(WARN, "The '%s' output didn't stop in time.", PipelineOutput[i].name);
+                }
+
+            if ( PipelineOutput[i].Spill != NULL )
+                {
+                    Spill_Sync( PipelineOutput[i].Spill );
+                }
+
+        }
+
+}
+
+/* Where each output is.  Called from Statistics(),  which can run from a
+   signal handler,  so this doesn't lock anything.  The numbers may be a
+   little stale. */
+
+void Pipeline_Statistics( void )
+{
+
+    struct _PipelineOutput *Output = NULL;
+    struct _MeerCursor *Cursor = NULL;
+    uint64_t lag = 0;
+    uint32_t s = 0;
+    uint8_t i = 0;
+
+    if ( PipelineSlot == NULL )
+        {
+            return;
+        }
+
+    Meer_Log(NORMAL, " - Pipeline Statistics:");
+    Meer_Log(NORMAL, "");
+    Meer_Log(NORMAL, " In flight     : %" PRIu64 "", submit_seq - checkpoint_seq);
+
+    for ( i = 0; i < PipelineOutputCount; i++ )
+        {
+
+            Output = &PipelineOutput[i];
+
+            Meer_Log(NORMAL, "");
+            Meer_Log(NORMAL, " Output        : %s (%s)", Output->name, Output->behind ? "catching up" : "live");
+
+            if ( Output->behind == false )
+                {
+                    Meer_Log(NORMAL, " Lag           : %" PRIu64 " events", submit_seq - Output->seq);
+                }
+            else
+                {
+
+                    lag = 0;
+
+                    for ( s = 0; s < MeerCounters->SpoolCount; s++ )
+                        {
+
+                            Cursor = &MeerSpool[s].cursor[Output->index];
+
+                            if ( MeerSpool[s].type == SPOOL_TYPE_FILE && Cursor->inode == MeerSpool[s].waldo->inode && Cursor->offset < MeerSpool[s].waldo->offset )
+                                {
+                                    lag += MeerSpool[s].waldo->offset - Cursor->offset;
+                                }
+                        }
+
+                    Meer_Log(NORMAL, " Lag           : %" PRIu64 " bytes", lag);
+                }
+
+            Meer_Log(NORMAL, " Fell behind   : %" PRIu64 "", Output->behind_count);
+            Meer_Log(NORMAL, " Replayed      : %" PRIu64 "", Output->replayed);
+            Meer_Log(NORMAL, " Missed        : %" PRIu64 "", Output->missed);
+
+            if ( Output->Spill != NULL )
+                {
+                    Meer_Log(NORMAL, " Spilled       : %" PRIu64 "", Output->spilled);
+                    Meer_Log(NORMAL, " Spill queue   : %" PRIu64 " events,  %" PRIu64 " bytes", Output->Spill->events, Output->Spill->bytes);
+                }
+
+        }
+
+    Meer_Log(NORMAL, "");
+
+}
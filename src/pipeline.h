@@ -0,0 +1,28 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+void Init_Pipeline( void );
+void Pipeline_Line( struct _MeerSpool *Spool, char *line, size_t len, size_t consumed );
+void Pipeline_Flush( void );
+void Pipeline_Stop( void );
+bool Pipeline_Lagging( void );
+void Pipeline_Add_Spool( uint32_t s );
+uint64_t Pipeline_Consumed( struct _MeerSpool *Spool );
+void Pipeline_Statistics( void );
@@ -0,0 +1,241 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Per-signature decision cache.  A hash on gid/sid/rev,  so rule sets with
+   tens of thousands of signatures don't mean walking MeerHealth[] and
+   SID_Map[] (or parsing metadata) for every alert. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "decode-json-alert.h"
+#include "sid-map.h"
+#include "sid-cache.h"
+
+struct _MeerConfig *MeerConfig;
+struct _MeerOutput *MeerOutput;
+struct _MeerCounters *MeerCounters;
+struct _MeerHealth *MeerHealth;
+struct _SID_Map *SID_Map;
+
+static struct _SID_Cache *SID_Cache[SID_CACHE_BUCKETS];
+static pthread_mutex_t SID_Cache_Mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t SID_Cache_Hash( uint32_t gid, uint64_t sid, uint32_t rev )
+{
+
+    uint64_t h = sid * 0x9E3779B97F4A7C15ULL;
+
+    h ^= ( (uint64_t)gid << 32 ) | rev;
+    h ^= h >> 29;
+
+    return( (uint32_t)( h % SID_CACHE_BUCKETS ) );
+}
+
+/* Work out everything for a signature we haven't seen */
+
+static void SID_Cache_Fill( struct _SID_Cache *Sig, struct _DecodeAlert *DecodeAlert )
+{
+
+    int i = 0;
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+
+    if ( MeerConfig->health == true )
+        {
+
+            for ( i = 0; i < MeerCounters->HealthCount; i++ )
+                {
+
+                    if ( MeerHealth[i].health_signature == Sig->sid )
+                        {
+                            Sig->health = true;
+                            break;
+                        }
+                }
+        }
+
+#endif
+
+    /* Same tests Output_External() used to make per alert */
+
+    if ( Decode_JSON_Alert_Metadata_Has( DecodeAlert, "meer", "external" ) ||
+            ( MeerOutput->external_metadata_security_ips == true && Decode_JSON_Alert_Metadata_Has( DecodeAlert, "policy", "security-ips drop" ) ) ||
+            ( MeerOutput->external_metadata_max_detect_ips == true && Decode_JSON_Alert_Metadata_Has( DecodeAlert, "policy", "max-detect-ips drop" ) ) ||
+            ( MeerOutput->external_metadata_balanced_ips == true && Decode_JSON_Alert_Metadata_Has( DecodeAlert, "policy", "balanced-ips drop" ) ) ||
+            ( MeerOutput->external_metadata_connectivity_ips == true && Decode_JSON_Alert_Metadata_Has( DecodeAlert, "policy", "connectivity-ips" ) ) )
+        {
+            Sig->external = true;
+        }
+
+    Sig->bluedot = Decode_JSON_Alert_Metadata_Has( DecodeAlert, "meer", "bluedot" );
+
+    if ( Decode_JSON_Alert_Metadata_Has( DecodeAlert, "bluedot", "by_source" ) )
+        {
+            Sig->bluedot_by = SID_CACHE_BLUEDOT_SOURCE;
+        }
+
+    else if ( Decode_JSON_Alert_Metadata_Has( DecodeAlert, "bluedot", "by_destination" ) )
+        {
+            Sig->bluedot_by = SID_CACHE_BLUEDOT_DESTINATION;
+        }
+
+    for ( i = 0; i < DecodeAlert->metadata_count; i++ )
+        {
+
+            if ( !strncmp( DecodeAlert->metadata[i].key, "fingerprint_", 12 ) )
+                {
+                    Sig->fingerprint = true;
+                    break;
+                }
+        }
+
+    /* Legacy references */
+
+#if defined(HAVE_LIBMYSQLCLIENT) || defined(HAVE_LIBPQ)
+
+    if ( MeerOutput->sql_enabled == true && MeerOutput->sql_reference_system == true )
+        {
+
+            uint32_t count = 0;
+
+            for ( i = 0; i < MeerCounters->SIDMapCount; i++ )
+                {
+
+                    if ( SID_Map[i].sid == Sig->sid )
+                        {
+                            count++;
+                        }
+                }
+
+            if ( count > 0 )
+                {
+
+                    Sig->sid_map = (uint32_t *) malloc( count * sizeof(uint32_t) );
+
+                    if ( Sig->sid_map == NULL )
+                        {
+                            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _SID_Cache sid_map. Abort!", __FILE__, __LINE__);
+                        }
+
+                    for ( i = 0; i < MeerCounters->SIDMapCount; i++ )
+                        {
+
+                            if ( SID_Map[i].sid == Sig->sid )
+                                {
+                                    Sig->sid_map[Sig->sid_map_count++] = i;
+                                }
+                        }
+                }
+        }
+
+#endif
+
+}
+
+/****************************************************************************
+ * SID_Cache_Get - Find (or build) the decisions for an alert's signature
+ ****************************************************************************/
+
+struct _SID_Cache *SID_Cache_Get( struct _DecodeAlert *DecodeAlert )
+{
+
+    struct _SID_Cache *Sig = NULL;
+
+    uint32_t gid = atoi( DecodeAlert->alert_gid );
+    uint32_t hash = SID_Cache_Hash( gid, DecodeAlert->alert_signature_id, DecodeAlert->alert_rev );
+
+    pthread_mutex_lock(&SID_Cache_Mutex);
+
+    for ( Sig = SID_Cache[hash]; Sig != NULL; Sig = Sig->next )
+        {
+
+            if ( Sig->sid == DecodeAlert->alert_signature_id && Sig->gid == gid && Sig->rev == DecodeAlert->alert_rev )
+                {
+                    pthread_mutex_unlock(&SID_Cache_Mutex);
+                    __sync_fetch_and_add(&MeerCounters->SIDCacheHitCount, 1);
+                    return(Sig);
+                }
+        }
+
+    Sig = (struct _SID_Cache *) malloc(sizeof(_SID_Cache));
+
+    if ( Sig == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _SID_Cache. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(Sig, 0, sizeof(_SID_Cache));
+
+    Sig->sid = DecodeAlert->alert_signature_id;
+    Sig->gid = gid;
+    Sig->rev = DecodeAlert->alert_rev;
+
+    SID_Cache_Fill( Sig, DecodeAlert );
+
+    Sig->next = SID_Cache[hash];
+    SID_Cache[hash] = Sig;
+
+    pthread_mutex_unlock(&SID_Cache_Mutex);
+
+    __sync_fetch_and_add(&MeerCounters->SIDCacheMissCount, 1);
+
+    return(Sig);
+}
+
+/****************************************************************************
+ * SID_Cache_Flush - Forget everything.  For when the configuration (health
+ * signatures,  sid-map,  external policies) changes.  Nothing may be
+ * holding an entry when this is called.
+ ****************************************************************************/
+
+void SID_Cache_Flush( void )
+{
+
+    struct _SID_Cache *Sig = NULL;
+    uint32_t i = 0;
+
+    pthread_mutex_lock(&SID_Cache_Mutex);
+
+    for ( i = 0; i < SID_CACHE_BUCKETS; i++ )
+        {
+
+            while ( SID_Cache[i] != NULL )
+                {
+                    Sig = SID_Cache[i];
+                    SID_Cache[i] = Sig->next;
+                    free(Sig->sid_map);
+                    free(Sig);
+                }
+        }
+
+    pthread_mutex_unlock(&SID_Cache_Mutex);
+
+}
@@ -0,0 +1,51 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* What Meer decides about a signature only depends on the signature,  so
+   it is worked out the first time a gid/sid/rev is seen and kept.  The
+   SQL ids are filled in by the SQL output the first time it needs them. */
+
+typedef struct _SID_Cache _SID_Cache;
+struct _SID_Cache
+{
+
+    uint64_t sid;
+    uint32_t gid;
+    uint32_t rev;
+
+    bool health;			/* One of the "health" signatures */
+    bool external;			/* Send to the external program */
+    bool bluedot;			/* metadata "meer: bluedot" */
+    unsigned char bluedot_by;		/* SID_CACHE_BLUEDOT_* */
+    bool fingerprint;			/* Has "fingerprint_*" metadata */
+
+    int sql_signature_id;		/* 0 until the SQL output has looked */
+    int sql_class_id;
+
+    uint32_t *sid_map;			/* Indexes into SID_Map[] (references) */
+    uint32_t sid_map_count;
+
+    struct _SID_Cache *next;
+
+};
+
+struct _SID_Cache *SID_Cache_Get( struct _DecodeAlert *DecodeAlert );
+void SID_Cache_Flush( void );
+
@@ -0,0 +1,559 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* A durable queue on local disk.  Records are appended to segment files
+   ("name.N.spill",  SPILL_SEGMENT_SIZE bytes or so each) and read back in
+   the order they were written.  Segments are removed once they have been
+   read.  Each record has a CRC,  so a record torn by a crash is found and
+   dropped rather than handed back.  Writes are fdatasync()'d in batches
+   (every SPILL_SYNC_EVENTS records or once a second).  The read position
+   is kept in "name.head",  so after a restart reading picks up where it
+   left off (a few records may be read twice).
+
+   One thread writes and one thread reads. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "spill.h"
+
+typedef struct _SpillRecord _SpillRecord;
+struct _SpillRecord
+{
+    uint32_t magic;
+    uint32_t crc;		/* Of the rest of the header and the data */
+    uint64_t position;		/* In the spool the event came from */
+    uint32_t len;		/* Bytes of JSON */
+    uint16_t name_len;		/* Bytes of spool name */
+    uint16_t pad;
+};
+
+static uint32_t SpillCRCTable[256];
+
+static void Spill_CRC_Init( void )
+{
+
+    uint32_t c = 0;
+    int i = 0;
+    int k = 0;
+
+    for ( i = 0; i < 256; i++ )
+        {
+
+            c = (uint32_t)i;
+
+            for ( k = 0; k < 8; k++ )
+                {
+                    c = ( c & 1 ) ? 0xedb88320 ^ ( c >> 1 ) : c >> 1;
+                }
+
+            SpillCRCTable[i] = c;
+        }
+
+}
+
+static uint32_t Spill_CRC( uint32_t crc, const void *data, size_t len )
+{
+
+    const unsigned char *p = data;
+
+    crc = ~crc;
+
+    while ( len-- )
+        {
+            crc = SpillCRCTable[ ( crc ^ *p++ ) & 0xff ] ^ ( crc >> 8 );
+        }
+
+    return(~crc);
+
+}
+
+static uint32_t Spill_Record_CRC( struct _SpillRecord *Record, const char *name, const char *json )
+{
+
+    uint32_t crc = 0;
+
+    crc = Spill_CRC( crc, &Record->position, sizeof(_SpillRecord) - offsetof(_SpillRecord, position) );
+    crc = Spill_CRC( crc, name, Record->name_len );
+    crc = Spill_CRC( crc, json, Record->len );
+
+    return(crc);
+
+}
+
+static int Spill_Open_Segment( struct _MeerSpill *Spill, uint64_t seg, int flags )
+{
+
+    char filename[300] = { 0 };
+
+    snprintf(filename, sizeof(filename), "%s.%" PRIu64 ".spill", Spill->path, seg);
+
+    return( open( filename, flags, 0600 ) );
+
+}
+
+static void Spill_Remove_Segment( struct _MeerSpill *Spill, uint64_t seg )
+{
+
+    char filename[300] = { 0 };
+
+    snprintf(filename, sizeof(filename), "%s.%" PRIu64 ".spill", Spill->path, seg);
+
+    if ( unlink( filename ) != 0 && errno != ENOENT )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot remove %s [%s]", __FILE__, __LINE__, filename, strerror(errno));
+        }
+
+}
+
+/* Read the record at "offset" into Spill->buf.  Returns its size,  0 at the
+   end of the segment or -1 if it's damaged. */
+
+static ssize_t Spill_Read_Record( struct _MeerSpill *Spill, int fd, uint64_t offset, struct _SpillRecord *Record )
+{
+
+    ssize_t got = 0;
+    size_t need = 0;
+
+    if ( ( got = pread( fd, Record, sizeof(_SpillRecord), offset ) ) == 0 )
+        {
+            return(0);
+        }
+
+    if ( got != sizeof(_SpillRecord) || Record->magic != SPILL_MAGIC || Record->len > SPILL_MAX_RECORD )
+        {
+            return(-1);
+        }
+
+    need = Record->name_len + Record->len;
+
+    if ( need + 2 > Spill->buf_size )
+        {
+
+            Spill->buf_size = need + 2;
+
+            if (( Spill->buf = realloc( Spill->buf, Spill->buf_size ) ) == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to reallocate memory for spill buffer. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    if ( pread( fd, Spill->buf, need, offset + sizeof(_SpillRecord) ) != (ssize_t)need )
+        {
+            return(-1);
+        }
+
+    if ( Spill_Record_CRC( Record, Spill->buf, Spill->buf + Record->name_len ) != Record->crc )
+        {
+            return(-1);
+        }
+
+    return( sizeof(_SpillRecord) + need );
+
+}
+
+/* Count what's in one segment from "offset" on.  Returns where the last
+   good record ends. */
+
+static uint64_t Spill_Scan_Segment( struct _MeerSpill *Spill, uint64_t seg, uint64_t offset )
+{
+
+    struct _SpillRecord Record;
+    ssize_t size = 0;
+    int fd = -1;
+
+    if ( ( fd = Spill_Open_Segment( Spill, seg, O_RDONLY ) ) == -1 )
+        {
+            return(offset);
+        }
+
+    while ( ( size = Spill_Read_Record( Spill, fd, offset, &Record ) ) > 0 )
+        {
+            offset += size;
+            Spill->events++;
+            Spill->bytes += size;
+        }
+
+    close(fd);
+
+    return(offset);
+
+}
+
+struct _MeerSpill *Spill_Open( const char *dir, const char *name )
+{
+
+    struct _MeerSpill *Spill = NULL;
+    char filename[300] = { 0 };
+    char pattern[300] = { 0 };
+    uint64_t head[2] = { 0, 0 };
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    uint64_t seg = 0;
+    uint64_t end = 0;
+    glob_t g;
+    size_t i = 0;
+
+    if ( SpillCRCTable[1] == 0 )
+        {
+            Spill_CRC_Init();
+        }
+
+    if (( Spill = calloc( 1, sizeof(_MeerSpill) ) ) == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _MeerSpill. Abort!", __FILE__, __LINE__);
+        }
+
+    snprintf(Spill->path, sizeof(Spill->path), "%s/%s", dir, name);
+    pthread_mutex_init(&Spill->lock, NULL);
+
+    Spill->read_fd = -1;
+    Spill->synced = time(NULL);
+
+    /* Where we left off reading */
+
+    snprintf(filename, sizeof(filename), "%s.head", Spill->path);
+
+    if (( Spill->head_fd = open( filename, O_RDWR | O_CREAT, 0600 ) ) == -1 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot open %s [%s]. Abort!", __FILE__, __LINE__, filename, strerror(errno));
+        }
+
+    if ( pread( Spill->head_fd, head, sizeof(head), 0 ) == sizeof(head) )
+        {
+            Spill->read_seg = head[0];
+            Spill->read_off = head[1];
+        }
+
+    /* What segments are there? */
+
+    snprintf(pattern, sizeof(pattern), "%s.*.spill", Spill->path);
+
+    if ( glob( pattern, 0, NULL, &g ) == 0 )
+        {
+
+            for ( i = 0; i < g.gl_pathc; i++ )
+                {
+
+                    if ( sscanf( g.gl_pathv[i] + strlen(Spill->path), ".%" SCNu64 ".spill", &seg ) == 1 )
+                        {
+                            first = seg < first ? seg : first;
+                            last = seg > last ? seg : last;
+                        }
+                }
+
+            globfree(&g);
+        }
+
+    if ( first == UINT64_MAX || Spill->read_seg > last )
+        {
+            first = last = Spill->read_seg;
+            Spill->read_off = 0;
+        }
+
+    else if ( Spill->read_seg < first )
+        {
+            Spill->read_seg = first;
+            Spill->read_off = 0;
+        }
+
+    /* Count what's waiting.  Anything after the last good record in the
+       last segment is from a write that didn't finish. */
+
+    for ( seg = Spill->read_seg; seg <= last; seg++ )
+        {
+            end = Spill_Scan_Segment( Spill, seg, seg == Spill->read_seg ? Spill->read_off : 0 );
+        }
+
+    Spill->write_seg = last;
+
+    if (( Spill->write_fd = Spill_Open_Segment( Spill, Spill->write_seg, O_WRONLY | O_CREAT ) ) == -1 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot open spill segment %s.%" PRIu64 ".spill [%s]. Abort!", __FILE__, __LINE__, Spill->path, Spill->write_seg, strerror(errno));
+        }
+
+    if ( ftruncate( Spill->write_fd, end ) != 0 || lseek( Spill->write_fd, end, SEEK_SET ) == -1 )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot set up spill segment %s.%" PRIu64 ".spill [%s]. Abort!", __FILE__, __LINE__, Spill->path, Spill->write_seg, strerror(errno));
+        }
+
+    Spill->write_off = end;
+
+    if ( Spill->events > 0 )
+        {
+            Meer_Log(NORMAL, "Spill queue %s has %" PRIu64 " events (%" PRIu64 " bytes) waiting.", Spill->path, Spill->events, Spill->bytes);
+        }
+
+    return(Spill);
+
+}
+
+static void Spill_Save_Head( struct _MeerSpill *Spill )
+{
+
+    uint64_t head[2] = { 0, 0 };
+
+    pthread_mutex_lock(&Spill->lock);
+    head[0] = Spill->read_seg;
+    head[1] = Spill->read_off;
+    pthread_mutex_unlock(&Spill->lock);
+
+    if ( pwrite( Spill->head_fd, head, sizeof(head), 0 ) != sizeof(head) )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot save read position for %s [%s]", __FILE__, __LINE__, Spill->path, strerror(errno));
+        }
+
+    Spill->uncommitted = 0;
+
+}
+
+/* Flush what's been written and save where reading is up to.  Called on
+   the way out. */
+
+void Spill_Sync( struct _MeerSpill *Spill )
+{
+
+    if ( Spill->uncommitted > 0 )
+        {
+            Spill_Save_Head( Spill );
+        }
+
+    pthread_mutex_lock(&Spill->lock);
+
+    if ( Spill->unsynced > 0 )
+        {
+            fdatasync( Spill->write_fd );
+            Spill->unsynced = 0;
+            Spill->synced = time(NULL);
+        }
+
+    pthread_mutex_unlock(&Spill->lock);
+
+}
+
+void Spill_Write( struct _MeerSpill *Spill, const char *spool, uint64_t position, const char *json, size_t len )
+{
+
+    struct _SpillRecord Record;
+    struct iovec iov[3];
+    size_t size = 0;
+    ssize_t ret = 0;
+
+    memset(&Record, 0, sizeof(_SpillRecord));
+
+    Record.magic = SPILL_MAGIC;
+    Record.position = position;
+    Record.len = len;
+    Record.name_len = strlen(spool);
+    Record.crc = Spill_Record_CRC( &Record, spool, json );
+
+    iov[0].iov_base = &Record;
+    iov[0].iov_len = sizeof(_SpillRecord);
+    iov[1].iov_base = (void *)spool;
+    iov[1].iov_len = Record.name_len;
+    iov[2].iov_base = (void *)json;
+    iov[2].iov_len = len;
+
+    size = sizeof(_SpillRecord) + Record.name_len + len;
+
+    pthread_mutex_lock(&Spill->lock);
+
+    /* Time for a new segment? */
+
+    if ( Spill->write_off >= SPILL_SEGMENT_SIZE )
+        {
+
+            fdatasync( Spill->write_fd );
+            close( Spill->write_fd );
+
+            Spill->write_seg++;
+            Spill->write_off = 0;
+            Spill->unsynced = 0;
+
+            if (( Spill->write_fd = Spill_Open_Segment( Spill, Spill->write_seg, O_WRONLY | O_CREAT | O_TRUNC ) ) == -1 )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Cannot open spill segment %s.%" PRIu64 ".spill [%s]. Abort!", __FILE__, __LINE__, Spill->path, Spill->write_seg, strerror(errno));
+                }
+        }
+
+    while ( ( ret = writev( Spill->write_fd, iov, 3 ) ) == -1 && errno == EINTR );
+
+    if ( ret != (ssize_t)size )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Cannot write to spill segment %s.%" PRIu64 ".spill [%s]. Abort!", __FILE__, __LINE__, Spill->path, Spill->write_seg, ret == -1 ? strerror(errno) : "short write");
+        }
+
+    Spill->write_off += size;
+    Spill->events++;
+    Spill->bytes += size;
+    Spill->unsynced++;
+
+    if ( Spill->unsynced >= SPILL_SYNC_EVENTS || time(NULL) != Spill->synced )
+        {
+            fdatasync( Spill->write_fd );
+            Spill->unsynced = 0;
+            Spill->synced = time(NULL);
+        }
+
+    pthread_mutex_unlock(&Spill->lock);
+
+}
+
+bool Spill_Empty( struct _MeerSpill *Spill )
+{
+
+    bool empty = false;
+
+    pthread_mutex_lock(&Spill->lock);
+    empty = Spill->read_seg == Spill->write_seg && Spill->read_off >= Spill->write_off;
+    pthread_mutex_unlock(&Spill->lock);
+
+    return(empty);
+
+}
+
+/* The next record.  What's handed back is good until the next call.  Call
+   Spill_Commit() once it has been dealt with. */
+
+bool Spill_Read( struct _MeerSpill *Spill, char **spool, uint64_t *position, char **json, size_t *len )
+{
+
+    struct _SpillRecord Record;
+    ssize_t size = 0;
+    uint64_t write_seg = 0;
+
+    while ( 1 )
+        {
+
+            if ( Spill_Empty( Spill ) == true )
+                {
+                    return(false);
+                }
+
+            pthread_mutex_lock(&Spill->lock);
+            write_seg = Spill->write_seg;
+            pthread_mutex_unlock(&Spill->lock);
+
+            if ( Spill->read_fd == -1 && ( Spill->read_fd = Spill_Open_Segment( Spill, Spill->read_seg, O_RDONLY ) ) == -1 )
+                {
+                    size = 0;
+                }
+            else
+                {
+                    size = Spill_Read_Record( Spill, Spill->read_fd, Spill->read_off, &Record );
+                }
+
+            if ( size > 0 )
+                {
+                    break;
+                }
+
+            if ( size == -1 )
+                {
+                    Meer_Log(WARN, "Damaged record in %s.%" PRIu64 ".spill at offset %" PRIu64 ".  Skipping the rest of the segment.", Spill->path, Spill->read_seg, Spill->read_off);
+                }
+
+            if ( Spill->read_seg == write_seg )
+                {
+                    return(false);	/* Shouldn't happen,  the writer is past us */
+                }
+
+            /* Done with this segment */
+
+            if ( Spill->read_fd != -1 )
+                {
+                    close( Spill->read_fd );
+                    Spill->read_fd = -1;
+                }
+
+            Spill_Remove_Segment( Spill, Spill->read_seg );
+
+            pthread_mutex_lock(&Spill->lock);
+            Spill->read_seg++;
+            Spill->read_off = 0;
+            pthread_mutex_unlock(&Spill->lock);
+
+        }
+
+    Spill->pending = size;
+
+    /* The spool name isn't \0 terminated on disk */
+
+    Spill->buf[Record.name_len + Record.len] = '\0';
+
+    memcpy( Spill->spool, Spill->buf, Record.name_len < sizeof(Spill->spool) ? Record.name_len : sizeof(Spill->spool) - 1 );
+    Spill->spool[ Record.name_len < sizeof(Spill->spool) ? Record.name_len : sizeof(Spill->spool) - 1 ] = '\0';
+
+    *spool = Spill->spool;
+    *position = Record.position;
+    *json = Spill->buf + Record.name_len;
+    *len = Record.len;
+
+    return(true);
+
+}
+
+void Spill_Commit( struct _MeerSpill *Spill )
+{
+
+    pthread_mutex_lock(&Spill->lock);
+
+    Spill->read_off += Spill->pending;
+    Spill->events--;
+    Spill->bytes -= Spill->pending;
+    Spill->pending = 0;
+
+    /* All caught up.  Start the segment over rather than let it grow. */
+
+    if ( Spill->read_seg == Spill->write_seg && Spill->read_off == Spill->write_off &&
+            ftruncate( Spill->write_fd, 0 ) == 0 && lseek( Spill->write_fd, 0, SEEK_SET ) == 0 )
+        {
+            Spill->read_off = 0;
+            Spill->write_off = 0;
+        }
+
+    pthread_mutex_unlock(&Spill->lock);
+
+    if ( ++Spill->uncommitted >= SPILL_COMMIT_EVENTS || Spill_Empty( Spill ) == true )
+        {
+            Spill_Save_Head( Spill );
+        }
+
+}
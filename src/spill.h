@@ -0,0 +1,58 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#include <pthread.h>
+#include <time.h>
+
+typedef struct _MeerSpill _MeerSpill;
+struct _MeerSpill
+{
+
+    char path[256];		/* Segments are "path.N.spill" */
+    pthread_mutex_t lock;
+
+    int write_fd;
+    uint64_t write_seg;
+    uint64_t write_off;
+    uint32_t unsynced;		/* Records written since the last fdatasync() */
+    time_t synced;
+
+    int read_fd;
+    uint64_t read_seg;
+    uint64_t read_off;
+    size_t pending;		/* Size of the record Spill_Read() handed out */
+    uint32_t uncommitted;	/* Records read since the read position was saved */
+    int head_fd;		/* Where the read position is saved */
+
+    uint64_t events;		/* Waiting to be read */
+    uint64_t bytes;
+
+    char *buf;
+    size_t buf_size;
+    char spool[256];		/* Spool the last record read came from */
+
+};
+
+struct _MeerSpill *Spill_Open( const char *dir, const char *name );
+void Spill_Write( struct _MeerSpill *Spill, const char *spool, uint64_t position, const char *json, size_t len );
+bool Spill_Read( struct _MeerSpill *Spill, char **spool, uint64_t *position, char **json, size_t *len );
+void Spill_Commit( struct _MeerSpill *Spill );
+void Spill_Sync( struct _MeerSpill *Spill );
+bool Spill_Empty( struct _MeerSpill *Spill );
@@ -30,24 +30,46 @@
 #include "meer-def.h"
 #include "stats.h"
 #include "util.h"
+#include "pipeline.h"
 
 
 struct _MeerCounters *MeerCounters;
 struct _MeerWaldo *MeerWaldo;
 struct _MeerConfig *MeerConfig;
 struct _MeerOutput *MeerOutput;
+struct _MeerSpool *MeerSpool;
 
 void Statistics( void )
 {
 
+    uint32_t i = 0;
+
     Meer_Log(NORMAL, "");
     Meer_Log(NORMAL, "--[ Meer Statistics ]---------------------------------------");
     Meer_Log(NORMAL, "");
     Meer_Log(NORMAL, " - Decoded Statistics:");
     Meer_Log(NORMAL, "");
-    Meer_Log(NORMAL, " Waldo Postion : %" PRIu64 "", MeerWaldo->position);
+
+    if ( MeerCounters->SpoolCount <= 1 )
+        {
+            Meer_Log(NORMAL, " Waldo Postion : %" PRIu64 "", MeerWaldo->position);
+            Meer_Log(NORMAL, " Waldo Offset  : %" PRIu64 "", MeerWaldo->offset);
+        }
+    else
+        {
+
+            for ( i = 0; i < MeerCounters->SpoolCount; i++ )
+                {
+                    Meer_Log(NORMAL, " Spool         : %s", MeerSpool[i].filename);
+                    Meer_Log(NORMAL, " Waldo Postion : %" PRIu64 "", MeerSpool[i].waldo->position);
+                    Meer_Log(NORMAL, " Waldo Offset  : %" PRIu64 "", MeerSpool[i].waldo->offset);
+                }
+
+        }
+
     Meer_Log(NORMAL, " JSON          : %" PRIu64 "", MeerCounters->JSONCount);
     Meer_Log(NORMAL, " Invalid JSON  : %" PRIu64 " (%.3f%%)", MeerCounters->InvalidJSONCount, CalcPct(MeerCounters->JSONCount,MeerCounters->InvalidJSONCount));
+    Meer_Log(NORMAL, " Pre-scanned   : %" PRIu64 " (%.3f%%)", MeerCounters->PrescanCount, CalcPct(MeerCounters->JSONCount,MeerCounters->PrescanCount));
     Meer_Log(NORMAL, " Flow          : %" PRIu64 "", MeerCounters->FlowCount);
     Meer_Log(NORMAL, " HTTP          : %" PRIu64 "", MeerCounters->HTTPCount);
     Meer_Log(NORMAL, " TLS           : %" PRIu64 "", MeerCounters->TLSCount);
@@ -55,6 +77,21 @@ void Statistics( void )
     Meer_Log(NORMAL, " SMTP          : %" PRIu64 "", MeerCounters->SMTPCount);
     Meer_Log(NORMAL, " Email         : %" PRIu64 "", MeerCounters->EmailCount);
     Meer_Log(NORMAL, " Metadata      : %" PRIu64 "", MeerCounters->MetadataCount);
+    Meer_Log(NORMAL, " Signatures    : %" PRIu64 " (%" PRIu64 " cache hits,  %.3f%%)", MeerCounters->SIDCacheMissCount, MeerCounters->SIDCacheHitCount, CalcPct(MeerCounters->SIDCacheHitCount,MeerCounters->SIDCacheMissCount));
+    Meer_Log(NORMAL, " Rotations     : %" PRIu64 "", MeerCounters->SpoolRotations);
+    Meer_Log(NORMAL, " Rotate Drain  : %" PRIu64 " bytes", MeerCounters->SpoolDrainBytes);
+    Meer_Log(NORMAL, " Cache Dropped : %" PRIu64 " bytes", MeerCounters->SpoolReleasedBytes);
+
+    if ( MeerConfig->spool_punch_holes == true )
+        {
+            Meer_Log(NORMAL, " Punched Out   : %" PRIu64 " bytes", MeerCounters->SpoolPunchedBytes);
+        }
+
+    if ( MeerConfig->socket_spool[0] != '\0' )
+        {
+            Meer_Log(NORMAL, " Socket Spools : %" PRIu64 "", MeerCounters->SocketSpools);
+            Meer_Log(NORMAL, " Socket Spooled: %" PRIu64 "", MeerCounters->SocketSpooled);
+        }
 
 #ifdef BLUEDOT
     Meer_Log(NORMAL, " Bluedot       : %" PRIu64 "", MeerCounters->BluedotCount);
@@ -63,6 +100,8 @@ void Statistics( void )
 
     Meer_Log(NORMAL, "");
 
+    Pipeline_Statistics();
+
     if ( MeerConfig->dns == true )
         {
 
@@ -70,6 +109,11 @@ void Statistics( void )
             Meer_Log(NORMAL, "");
             Meer_Log(NORMAL, " DNS Lookups   : %"PRIu64 "", MeerCounters->DNSCount);
             Meer_Log(NORMAL, " DNS Cache Hits: %"PRIu64 " (%.3f%%)", MeerCounters->DNSCacheCount, CalcPct(MeerCounters->DNSCacheCount,MeerCounters->DNSCount));
+            Meer_Log(NORMAL, " DNS Failures  : %"PRIu64 "", MeerCounters->DNSFailCount);
+            Meer_Log(NORMAL, " DNS Expired   : %"PRIu64 "", MeerCounters->DNSCacheExpired);
+            Meer_Log(NORMAL, " DNS Evictions : %"PRIu64 "", MeerCounters->DNSCacheEvictions);
+            Meer_Log(NORMAL, " DNS Late      : %"PRIu64 "", MeerCounters->DNSLate);
+            Meer_Log(NORMAL, " DNS Dropped   : %"PRIu64 "", MeerCounters->DNSQueueDropped);
             Meer_Log(NORMAL, "");
 
         }
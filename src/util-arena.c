@@ -0,0 +1,119 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Bump allocator for things that live exactly as long as one event */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "util-arena.h"
+
+void Arena_Init( struct _MeerArena *Arena, size_t block_size )
+{
+    Arena->head = NULL;
+    Arena->block_size = block_size;
+}
+
+void *Arena_Alloc( struct _MeerArena *Arena, size_t size )
+{
+
+    struct _MeerArenaBlock *Block = Arena->head;
+    size_t block_size = Arena->block_size;
+    void *ptr = NULL;
+
+    size = ( size + 7 ) & ~(size_t)7;
+
+    if ( Block == NULL || Block->size - Block->used < size )
+        {
+
+            /* Oversized requests get a block of their own */
+
+            if ( size > block_size )
+                {
+                    block_size = size;
+                }
+
+            Block = (struct _MeerArenaBlock *) malloc( sizeof(struct _MeerArenaBlock) + block_size );
+
+            if ( Block == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for _MeerArenaBlock. Abort!", __FILE__, __LINE__);
+                }
+
+            Block->size = block_size;
+            Block->used = 0;
+            Block->next = Arena->head;
+            Arena->head = Block;
+        }
+
+    ptr = Block->data + Block->used;
+    Block->used += size;
+
+    return(ptr);
+}
+
+char *Arena_Strdup( struct _MeerArena *Arena, const char *string )
+{
+
+    size_t len = strlen(string) + 1;
+    char *copy = Arena_Alloc(Arena, len);
+
+    memcpy(copy, string, len);
+
+    return(copy);
+}
+
+/* Keep the oldest block (the first one made),  drop the rest */
+
+void Arena_Reset( struct _MeerArena *Arena )
+{
+
+    struct _MeerArenaBlock *Block = NULL;
+
+    while ( Arena->head != NULL && Arena->head->next != NULL )
+        {
+            Block = Arena->head;
+            Arena->head = Block->next;
+            free(Block);
+        }
+
+    if ( Arena->head != NULL )
+        {
+            Arena->head->used = 0;
+        }
+
+}
+
+void Arena_Free( struct _MeerArena *Arena )
+{
+
+    Arena_Reset(Arena);
+    free(Arena->head);
+    Arena->head = NULL;
+
+}
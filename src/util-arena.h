@@ -0,0 +1,44 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* A simple bump allocator.  Everything in it goes away at once with
+   Arena_Reset(),  which keeps the first block for the next user. */
+
+typedef struct _MeerArenaBlock _MeerArenaBlock;
+struct _MeerArenaBlock
+{
+    struct _MeerArenaBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+typedef struct _MeerArena _MeerArena;
+struct _MeerArena
+{
+    struct _MeerArenaBlock *head;
+    size_t block_size;			/* Size of the first (kept) block */
+};
+
+void Arena_Init( struct _MeerArena *Arena, size_t block_size );
+void *Arena_Alloc( struct _MeerArena *Arena, size_t size );
+char *Arena_Strdup( struct _MeerArena *Arena, const char *string );
+void Arena_Reset( struct _MeerArena *Arena );
+void Arena_Free( struct _MeerArena *Arena );
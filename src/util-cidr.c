@@ -0,0 +1,199 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* CIDR membership ("is this IP in any of these networks?") for
+   "fingerprint_networks",  bluedot "skip_networks" and Is_Notroutable().
+
+   A multibit trie over the 16 byte IP (as from IP_Parse()),  one nibble
+   per level.  Each slot is empty,  CIDR_COVERED (some prefix covers all of
+   it) or the index of the next node.  Prefixes that don't end on a nibble
+   fill all the slots they cover.  A lookup walks one node (one cache line)
+   per nibble and stops at the first covered or empty slot,  so a /24 takes
+   at most six steps no matter how many networks are loaded.
+
+   Tries are built at start up and only read after that. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "util.h"
+#include "util-cidr.h"
+
+#define CIDR_NIBBLE(ip, d)	( ( (ip)[(d) >> 1] >> ( (d) & 1 ? 0 : 4 ) ) & 0x0f )
+
+static uint32_t CIDR_Trie_Node( struct _CIDR_Trie *trie )
+{
+
+    if ( trie->count == trie->size )
+        {
+
+            trie->size = trie->size == 0 ? 64 : trie->size * 2;
+
+            if ( ( trie->node = (_CIDR_Node *) realloc( trie->node, trie->size * sizeof(_CIDR_Node) ) ) == NULL )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for CIDR trie. Abort!", __FILE__, __LINE__);
+                }
+        }
+
+    memset(&trie->node[trie->count], 0, sizeof(_CIDR_Node));
+
+    return(trie->count++);
+}
+
+/* Add "ip"/"bits".  Host bits in "ip" are ignored */
+
+void CIDR_Trie_Add( struct _CIDR_Trie *trie, const unsigned char *ip, int bits )
+{
+
+    uint32_t node = 0;
+    uint32_t next = 0;
+    uint32_t base = 0;
+    uint32_t span = 0;
+    uint32_t i = 0;
+    int depth = 0;
+
+    if ( trie->count == 0 )
+        {
+            CIDR_Trie_Node( trie );		/* Root */
+        }
+
+    trie->prefixes++;
+
+    for ( depth = 0; bits - depth * 4 > 4; depth++ )
+        {
+
+            next = trie->node[node].child[ CIDR_NIBBLE(ip, depth) ];
+
+            /* Already covered by a shorter prefix */
+
+            if ( next == CIDR_COVERED )
+                {
+                    return;
+                }
+
+            if ( next == 0 )
+                {
+                    next = CIDR_Trie_Node( trie );
+                    trie->node[node].child[ CIDR_NIBBLE(ip, depth) ] = next;
+                }
+
+            node = next;
+        }
+
+    /* The last 0 - 4 bits.  Anything that was under these slots is
+       covered now,  so whatever it pointed at is simply dropped. */
+
+    span = 1 << ( 4 - ( bits - depth * 4 ) );
+    base = CIDR_NIBBLE(ip, depth) & ~( span - 1 );
+
+    for ( i = 0; i < span; i++ )
+        {
+            trie->node[node].child[base + i] = CIDR_COVERED;
+        }
+
+}
+
+/* Parse and add "10.0.0.0/8" or "2001:db8::/32".  Without a "/" it's a single
+   host.  Returns false if it's not a valid network. */
+
+bool CIDR_Trie_Add_String( struct _CIDR_Trie *trie, const char *cidr )
+{
+
+    unsigned char ip[MAXIPBIT] = { 0 };
+    char tmp[MAXIP] = { 0 };
+    char *mask = NULL;
+    char *end = NULL;
+    long bits = 0;
+    int ver = 0;
+
+    strlcpy(tmp, cidr, sizeof(tmp));
+
+    if ( ( mask = strchr(tmp, '/') ) != NULL )
+        {
+            *mask++ = '\0';
+        }
+
+    if ( ( ver = IP_Parse( tmp, ip ) ) == 0 )
+        {
+            return(false);
+        }
+
+    if ( mask == NULL )
+        {
+            bits = ver == IPv4 ? 32 : 128;
+        }
+
+    else
+        {
+
+            bits = strtol(mask, &end, 10);
+
+            if ( end == mask || *end != '\0' || bits <= 0 || bits > ( ver == IPv4 ? 32 : 128 ) )
+                {
+                    return(false);
+                }
+        }
+
+    CIDR_Trie_Add( trie, ip, (int)bits );
+
+    return(true);
+}
+
+bool CIDR_Trie_Match( const struct _CIDR_Trie *trie, const unsigned char *ip )
+{
+
+    uint32_t node = 0;
+    uint32_t next = 0;
+    int depth = 0;
+
+    if ( trie->count == 0 )
+        {
+            return(false);
+        }
+
+    for ( depth = 0; depth < MAXIPBIT * 2; depth++ )
+        {
+
+            next = trie->node[node].child[ CIDR_NIBBLE(ip, depth) ];
+
+            if ( next == CIDR_COVERED )
+                {
+                    return(true);
+                }
+
+            if ( next == 0 )
+                {
+                    return(false);
+                }
+
+            node = next;
+        }
+
+    return(false);
+}
@@ -0,0 +1,40 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* CIDR membership trie.  See util-cidr.c */
+
+typedef struct _CIDR_Node _CIDR_Node;
+struct _CIDR_Node
+{
+    uint32_t child[16];		/* 0 == empty,  CIDR_COVERED,  or node index */
+};
+
+typedef struct _CIDR_Trie _CIDR_Trie;
+struct _CIDR_Trie
+{
+    struct _CIDR_Node *node;	/* node[0] is the root */
+    uint32_t count;
+    uint32_t size;
+    uint32_t prefixes;		/* Networks added */
+};
+
+void CIDR_Trie_Add( struct _CIDR_Trie *trie, const unsigned char *ip, int bits );
+bool CIDR_Trie_Add_String( struct _CIDR_Trie *trie, const char *cidr );
+bool CIDR_Trie_Match( const struct _CIDR_Trie *trie, const unsigned char *ip );
@@ -0,0 +1,871 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Reverse DNS with a bounded cache.  Entries live in one array,  found
+   through an open addressing index (binary IP -> entry) and kept on an LRU
+   list.  When the cache is full the least recently used entry goes.
+   Failed lookups (NXDOMAIN,  time outs) are cached too,  for
+   "dns_negative_cache" seconds,  so a dead resolver isn't asked about the
+   same IP for every alert.
+
+   Lookups themselves are done by a pool of resolver threads ("dns_threads")
+   so a slow or dead resolver doesn't stall the ingest loop.
+
+   With "dns_snapshot" the cache is written to disk at shutdown and every
+   "dns_snapshot_interval" seconds,  and loaded back at start up. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"             /* From autoconf */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "meer.h"
+#include "meer-def.h"
+#include "util.h"
+#include "util-dns.h"
+
+struct _MeerConfig *MeerConfig;
+struct _MeerCounters *MeerCounters;
+
+static struct _DnsCache *DnsCache = NULL;
+static uint32_t *DnsCacheIndex = NULL;		/* DNS_CACHE_NONE = empty */
+static uint32_t DnsCacheIndexMask = 0;
+static uint32_t DnsCacheCount = 0;
+static uint32_t DnsCacheHead = DNS_CACHE_NONE;	/* Most recently used */
+static uint32_t DnsCacheTail = DNS_CACHE_NONE;
+static uint32_t DnsCacheFree = DNS_CACHE_NONE;	/* Expired entries,  through lru_next */
+static pthread_mutex_t DnsCacheMutex = PTHREAD_MUTEX_INITIALIZER;	/* Also covers DnsQueue */
+
+/* Lookups waiting for a resolver thread */
+
+static struct _DnsQueue DnsQueue[DNS_QUEUE_SIZE];
+static uint32_t DnsQueueHead = 0;
+static uint32_t DnsQueueTail = 0;
+static pthread_cond_t DnsQueueCond = PTHREAD_COND_INITIALIZER;		/* Work for the resolvers */
+static pthread_cond_t DnsDoneCond = PTHREAD_COND_INITIALIZER;		/* A resolver finished a lookup */
+static bool DnsResolvers = false;
+
+static pthread_mutex_t DnsSaveMutex = PTHREAD_MUTEX_INITIALIZER;	/* One snapshot writer at a time */
+
+void DNS_Cache_Init( void )
+{
+
+    uint32_t size = 2;
+
+    if ( MeerConfig->dns == false || MeerConfig->dns_cache == 0 || MeerConfig->dns_cache_size == 0 )
+        {
+            return;
+        }
+
+    /* Keep the index at most half full */
+
+    while ( size < MeerConfig->dns_cache_size * 2 )
+        {
+            size <<= 1;
+        }
+
+    DnsCache = (struct _DnsCache *) calloc( MeerConfig->dns_cache_size, sizeof(_DnsCache) );
+    DnsCacheIndex = (uint32_t *) malloc( size * sizeof(uint32_t) );
+
+    if ( DnsCache == NULL || DnsCacheIndex == NULL )
+        {
+            Meer_Log(ERROR, "[%s, line %d] Failed to allocate memory for the DNS cache. Abort!", __FILE__, __LINE__);
+        }
+
+    memset(DnsCacheIndex, 0xff, size * sizeof(uint32_t));
+    DnsCacheIndexMask = size - 1;
+
+    if ( MeerConfig->dns_snapshot[0] != '\0' )
+        {
+            DNS_Cache_Load();
+        }
+
+}
+
+static uint32_t DNS_Cache_Hash( const unsigned char *ip )
+{
+
+    uint32_t hash = 2166136261U;
+    int i = 0;
+
+    for ( i = 0; i < MAXIPBIT; i++ )
+        {
+            hash = ( hash ^ ip[i] ) * 16777619U;
+        }
+
+    return(hash);
+}
+
+/* Slot in DnsCacheIndex[] holding "ip",  or the empty slot where it would go */
+
+static uint32_t DNS_Cache_Find( const unsigned char *ip, uint8_t ver, uint32_t hash )
+{
+
+    uint32_t slot = hash & DnsCacheIndexMask;
+    uint32_t e = 0;
+
+    while ( ( e = DnsCacheIndex[slot] ) != DNS_CACHE_NONE )
+        {
+
+            if ( DnsCache[e].hash == hash && DnsCache[e].ver == ver &&
+                    !memcmp( DnsCache[e].ip, ip, MAXIPBIT ) )
+                {
+                    break;
+                }
+
+            slot = ( slot + 1 ) & DnsCacheIndexMask;
+        }
+
+    return(slot);
+}
+
+/* Take a slot out of the index and pull later entries of the same run back
+   (no tombstones) */
+
+static void DNS_Cache_Index_Remove( uint32_t slot )
+{
+
+    uint32_t next = slot;
+    uint32_t home = 0;
+
+    for ( ;; )
+        {
+
+            DnsCacheIndex[slot] = DNS_CACHE_NONE;
+
+            for ( ;; )
+                {
+
+                    next = ( next + 1 ) & DnsCacheIndexMask;
+
+                    if ( DnsCacheIndex[next] == DNS_CACHE_NONE )
+                        {
+                            return;
+                        }
+
+                    home = DnsCache[ DnsCacheIndex[next] ].hash & DnsCacheIndexMask;
+
+                    /* Can the entry at "next" move back to "slot"?  Only if
+                       its home isn't between the two (cyclically) */
+
+                    if ( slot <= next ? ( home <= slot || home > next ) : ( home <= slot && home > next ) )
+                        {
+                            break;
+                        }
+                }
+
+            DnsCacheIndex[slot] = DnsCacheIndex[next];
+            slot = next;
+        }
+
+}
+
+static void DNS_Cache_LRU_Unlink( uint32_t e )
+{
+
+    if ( DnsCache[e].lru_prev != DNS_CACHE_NONE )
+        {
+            DnsCache[ DnsCache[e].lru_prev ].lru_next = DnsCache[e].lru_next;
+        }
+    else
+        {
+            DnsCacheHead = DnsCache[e].lru_next;
+        }
+
+    if ( DnsCache[e].lru_next != DNS_CACHE_NONE )
+        {
+            DnsCache[ DnsCache[e].lru_next ].lru_prev = DnsCache[e].lru_prev;
+        }
+    else
+        {
+            DnsCacheTail = DnsCache[e].lru_prev;
+        }
+
+}
+
+static void DNS_Cache_LRU_Push( uint32_t e )
+{
+
+    DnsCache[e].lru_prev = DNS_CACHE_NONE;
+    DnsCache[e].lru_next = DnsCacheHead;
+
+    if ( DnsCacheHead != DNS_CACHE_NONE )
+        {
+            DnsCache[DnsCacheHead].lru_prev = e;
+        }
+
+    DnsCacheHead = e;
+
+    if ( DnsCacheTail == DNS_CACHE_NONE )
+        {
+            DnsCacheTail = e;
+        }
+
+}
+
+/* Look in the cache.  DnsCacheMutex must be held.  On a hit "str" is
+   filled in */
+
+static int DNS_Cache_Get( const unsigned char *ip, uint8_t ver, uint32_t hash, uint64_t now, char *str, size_t size )
+{
+
+    uint32_t slot = 0;
+    uint32_t e = 0;
+    uint64_t ttl = 0;
+
+    slot = DNS_Cache_Find( ip, ver, hash );
+
+    if ( ( e = DnsCacheIndex[slot] ) == DNS_CACHE_NONE )
+        {
+            return(DNS_CACHE_MISS);
+        }
+
+    /* Still with a resolver thread */
+
+    if ( DnsCache[e].pending == true )
+        {
+            return(DNS_CACHE_PENDING);
+        }
+
+    ttl = DnsCache[e].reverse[0] != '\0' ? MeerConfig->dns_cache : MeerConfig->dns_negative_cache;
+
+    /* "now" can be older than the entry:  the caller reads the clock
+       before it waits,  and the answer may land in a later second */
+
+    if ( now > DnsCache[e].lookup_time && now - DnsCache[e].lookup_time >= ttl )
+        {
+
+            /* Expired.  Drop it,  the lookup will put it back */
+
+            DNS_Cache_Index_Remove( slot );
+            DNS_Cache_LRU_Unlink( e );
+
+            DnsCache[e].lru_next = DnsCacheFree;
+            DnsCacheFree = e;
+
+            __sync_fetch_and_add(&MeerCounters->DNSCacheExpired, 1);
+            return(DNS_CACHE_MISS);
+        }
+
+    DNS_Cache_LRU_Unlink( e );
+    DNS_Cache_LRU_Push( e );
+
+    snprintf(str, size, "%s", DnsCache[e].reverse);
+
+    return(DNS_CACHE_HIT);
+}
+
+/* Add or update an entry.  DnsCacheMutex must be held.  A "pending" entry
+   is a placeholder for a lookup a resolver thread is working on */
+
+static void DNS_Cache_Put( const unsigned char *ip, uint8_t ver, uint32_t hash, uint64_t now, const char *reverse, bool pending )
+{
+
+    uint32_t slot = 0;
+    uint32_t e = 0;
+
+    slot = DNS_Cache_Find( ip, ver, hash );
+
+    /* Another thread might have added it while we were looking it up */
+
+    if ( ( e = DnsCacheIndex[slot] ) != DNS_CACHE_NONE )
+        {
+            DNS_Cache_LRU_Unlink( e );
+        }
+
+    else
+        {
+
+            /* Reuse an expired entry before growing */
+
+            if ( DnsCacheFree != DNS_CACHE_NONE )
+                {
+                    e = DnsCacheFree;
+                    DnsCacheFree = DnsCache[e].lru_next;
+                }
+
+            else if ( DnsCacheCount < MeerConfig->dns_cache_size )
+                {
+                    e = DnsCacheCount++;
+                }
+
+            else
+                {
+
+                    /* Full.  The least recently used goes.  If that's a
+                       pending entry,  its resolver just adds it back. */
+
+                    e = DnsCacheTail;
+
+                    DNS_Cache_Index_Remove( DNS_Cache_Find( DnsCache[e].ip, DnsCache[e].ver, DnsCache[e].hash ) );
+                    DNS_Cache_LRU_Unlink( e );
+
+                    __sync_fetch_and_add(&MeerCounters->DNSCacheEvictions, 1);
+
+                    slot = DNS_Cache_Find( ip, ver, hash );
+                }
+
+            memcpy(DnsCache[e].ip, ip, MAXIPBIT);
+            DnsCache[e].ver = ver;
+            DnsCache[e].hash = hash;
+
+            DnsCacheIndex[slot] = e;
+        }
+
+    strlcpy(DnsCache[e].reverse, reverse, sizeof(DnsCache[e].reverse));
+    DnsCache[e].lookup_time = now;
+    DnsCache[e].pending = pending;
+
+    DNS_Cache_LRU_Push( e );
+
+}
+
+/* The actual PTR lookup.  This is the part that can take seconds */
+
+static void DNS_Resolve( const unsigned char *ip, uint8_t ver, char *str, size_t size )
+{
+
+    struct sockaddr_storage ipaddr;
+    socklen_t len = 0;
+    int err = 0;
+
+    memset(&ipaddr, 0, sizeof(ipaddr));
+
+    if ( ver == IPv6 )
+        {
+            struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&ipaddr;
+
+            in6->sin6_family = AF_INET6;
+            memcpy(&in6->sin6_addr, ip, 16);
+            len = sizeof(struct sockaddr_in6);
+        }
+    else
+        {
+            struct sockaddr_in *in = (struct sockaddr_in *)&ipaddr;
+
+            in->sin_family = AF_INET;
+            memcpy(&in->sin_addr, ip, 4);
+            len = sizeof(struct sockaddr_in);
+        }
+
+    err = getnameinfo((struct sockaddr *)&ipaddr, len, str, size, NULL, 0, NI_NAMEREQD);
+
+    __sync_fetch_and_add(&MeerCounters->DNSCount, 1);
+
+    if ( err != 0 )
+        {
+            str[0] = '\0';
+            __sync_fetch_and_add(&MeerCounters->DNSFailCount, 1);
+        }
+
+}
+
+/* Resolver thread.  Takes IPs off DnsQueue,  looks them up and puts the
+   answer in the cache for whoever asks next (or is waiting now) */
+
+static void *DNS_Resolver( void *arg )
+{
+
+    struct _DnsQueue job;
+    char host_r[NI_MAXHOST] = { 0 };
+
+    Block_Signals();
+
+    for ( ;; )
+        {
+
+            pthread_mutex_lock(&DnsCacheMutex);
+
+            while ( DnsQueueHead == DnsQueueTail )
+                {
+                    pthread_cond_wait(&DnsQueueCond, &DnsCacheMutex);
+                }
+
+            job = DnsQueue[ DnsQueueHead % DNS_QUEUE_SIZE ];
+            DnsQueueHead++;
+
+            pthread_mutex_unlock(&DnsCacheMutex);
+
+            DNS_Resolve( job.ip, job.ver, host_r, sizeof(host_r) );
+
+            pthread_mutex_lock(&DnsCacheMutex);
+            DNS_Cache_Put( job.ip, job.ver, job.hash, (uint64_t)time(NULL), host_r, false );
+            pthread_mutex_unlock(&DnsCacheMutex);
+
+            pthread_cond_broadcast(&DnsDoneCond);
+        }
+
+    return(NULL);
+}
+
+/* Writes a snapshot every "dns_snapshot_interval" seconds */
+
+static void *DNS_Snapshot_Thread( void *arg )
+{
+
+    Block_Signals();
+
+    for ( ;; )
+        {
+            sleep( MeerConfig->dns_snapshot_interval );
+            DNS_Cache_Save();
+        }
+
+    return(NULL);
+}
+
+/* Start the resolver and snapshot threads.  Called after we've become a
+   daemon,  since threads don't survive a fork() */
+
+void DNS_Resolver_Init( void )
+{
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    uint32_t i = 0;
+    int ret = 0;
+
+    if ( MeerConfig->dns == false || DnsCache == NULL )
+        {
+
+            /* Answers are handed back through the cache */
+
+            if ( MeerConfig->dns == true && MeerConfig->dns_threads > 0 )
+                {
+                    Meer_Log(WARN, "'dns_threads' needs 'dns_cache'.  PTR lookups will be done inline.");
+                }
+
+            return;
+        }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    if ( MeerConfig->dns_snapshot[0] != '\0' && MeerConfig->dns_snapshot_interval > 0 )
+        {
+
+            if ( ( ret = pthread_create( &thread, &attr, DNS_Snapshot_Thread, NULL ) ) != 0 )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Cannot create DNS snapshot thread [%s]. Abort!", __FILE__, __LINE__, strerror(ret));
+                }
+        }
+
+    if ( MeerConfig->dns_threads == 0 )
+        {
+            pthread_attr_destroy(&attr);
+            return;
+        }
+
+    for ( i = 0; i < MeerConfig->dns_threads; i++ )
+        {
+
+            if ( ( ret = pthread_create( &thread, &attr, DNS_Resolver, NULL ) ) != 0 )
+                {
+                    Meer_Log(ERROR, "[%s, line %d] Cannot create DNS resolver thread [%s]. Abort!", __FILE__, __LINE__, strerror(ret));
+                }
+        }
+
+    pthread_attr_destroy(&attr);
+
+    DnsResolvers = true;
+
+    Meer_Log(NORMAL, "Started %" PRIu32 " DNS resolver thread(s),  waiting up to %" PRIu32 " ms for PTR records.", MeerConfig->dns_threads, MeerConfig->dns_wait);
+
+}
+
+/* Look up the PTR record for "host".  With resolver threads running this
+   never does the lookup itself.  A miss is handed to a resolver and we wait
+   up to "dns_wait" ms for the answer.  If it doesn't come in time the
+   event goes out without it ("str" is empty),  and the answer is there for
+   the next event with that IP.
+
+   Without resolver threads (or a cache to hand answers back through) the
+   lookup is done here,  like it always was. */
+
+void DNS_Lookup_Reverse( char *host, char *str, size_t size )
+{
+
+    unsigned char ip[MAXIPBIT] = { 0 };
+    uint8_t ver = 0;
+    uint32_t hash = 0;
+    uint64_t now = (uint64_t)time(NULL);
+    int state = DNS_CACHE_MISS;
+
+    struct timespec ts;
+    char host_r[NI_MAXHOST] = { 0 };
+
+    str[0] = '\0';
+
+    if ( ( ver = IP_Parse( host, ip ) ) == 0 )
+        {
+            return;
+        }
+
+    if ( DnsCache == NULL )
+        {
+            DNS_Resolve( ip, ver, host_r, sizeof(host_r) );
+            snprintf(str, size, "%s", host_r);
+            return;
+        }
+
+    hash = DNS_Cache_Hash( ip );
+
+    pthread_mutex_lock(&DnsCacheMutex);
+
+    if ( ( state = DNS_Cache_Get( ip, ver, hash, now, str, size ) ) == DNS_CACHE_HIT )
+        {
+            pthread_mutex_unlock(&DnsCacheMutex);
+            __sync_fetch_and_add(&MeerCounters->DNSCacheCount, 1);
+            return;
+        }
+
+    if ( DnsResolvers == false )
+        {
+
+            /* The lookup isn't locked,  so one slow lookup doesn't hold up
+               other "decode_threads" */
+
+            pthread_mutex_unlock(&DnsCacheMutex);
+
+            DNS_Resolve( ip, ver, host_r, sizeof(host_r) );
+
+            pthread_mutex_lock(&DnsCacheMutex);
+            DNS_Cache_Put( ip, ver, hash, now, host_r, false );
+            pthread_mutex_unlock(&DnsCacheMutex);
+
+            snprintf(str, size, "%s", host_r);
+            return;
+        }
+
+    if ( state == DNS_CACHE_MISS )
+        {
+
+            if ( DnsQueueTail - DnsQueueHead == DNS_QUEUE_SIZE )
+                {
+
+                    /* The resolvers are that far behind.  Skip this one,  a
+                       later event with the same IP will try again. */
+
+                    pthread_mutex_unlock(&DnsCacheMutex);
+                    __sync_fetch_and_add(&MeerCounters->DNSQueueDropped, 1);
+                    return;
+                }
+
+            memcpy(DnsQueue[ DnsQueueTail % DNS_QUEUE_SIZE ].ip, ip, MAXIPBIT);
+            DnsQueue[ DnsQueueTail % DNS_QUEUE_SIZE ].ver = ver;
+            DnsQueue[ DnsQueueTail % DNS_QUEUE_SIZE ].hash = hash;
+            DnsQueueTail++;
+
+            DNS_Cache_Put( ip, ver, hash, now, "", true );
+
+            pthread_cond_signal(&DnsQueueCond);
+
+            state = DNS_CACHE_PENDING;
+        }
+
+    if ( MeerConfig->dns_wait > 0 )
+        {
+
+            clock_gettime(CLOCK_REALTIME, &ts);
+
+            ts.tv_sec += MeerConfig->dns_wait / 1000;
+            ts.tv_nsec += ( MeerConfig->dns_wait % 1000 ) * 1000000L;
+
+            if ( ts.tv_nsec >= 1000000000L )
+                {
+                    ts.tv_sec++;
+                    ts.tv_nsec -= 1000000000L;
+                }
+
+            while ( state == DNS_CACHE_PENDING )
+                {
+
+                    if ( pthread_cond_timedwait(&DnsDoneCond, &DnsCacheMutex, &ts) == ETIMEDOUT )
+                        {
+                            break;
+                        }
+
+                    state = DNS_Cache_Get( ip, ver, hash, now, str, size );
+                }
+        }
+
+    pthread_mutex_unlock(&DnsCacheMutex);
+
+    if ( state != DNS_CACHE_HIT )
+        {
+            str[0] = '\0';
+            __sync_fetch_and_add(&MeerCounters->DNSLate, 1);
+        }
+
+}
+
+/* Snapshot file:  a _DnsSnapshot header,  then "count" records of
+
+       uint64_t lookup_time
+       unsigned char ip[MAXIPBIT]
+       uint8_t ver
+       uint8_t len
+       char reverse[len]		(not NULL terminated)
+
+   in host byte order,  least recently used first,  so loading them in
+   order rebuilds the LRU list. */
+
+#define DNS_SNAPSHOT_RECORD	( sizeof(uint64_t) + MAXIPBIT + 2 )
+
+/* The signal handler may have interrupted a thread holding "mutex",  so
+   we don't wait on it for long */
+
+static bool DNS_Trylock( pthread_mutex_t *mutex )
+{
+
+    int tries = 0;
+
+    while ( pthread_mutex_trylock(mutex) != 0 )
+        {
+
+            if ( ++tries == DNS_SNAPSHOT_LOCK_TRIES )
+                {
+                    return(false);
+                }
+
+            usleep(10000);
+        }
+
+    return(true);
+}
+
+static void DNS_Cache_Write( void )
+{
+
+    struct _DnsSnapshot header;
+
+    char tmp[sizeof(MeerConfig->dns_snapshot) + 8] = { 0 };
+    unsigned char *buf = NULL;
+    size_t pos = 0;
+    uint32_t e = 0;
+    uint8_t len = 0;
+    int fd = 0;
+
+    if ( ( buf = malloc( (size_t)MeerConfig->dns_cache_size * ( DNS_SNAPSHOT_RECORD + 255 ) ) ) == NULL )
+        {
+            Meer_Log(WARN, "[%s, line %d] Failed to allocate memory for the DNS snapshot.", __FILE__, __LINE__);
+            return;
+        }
+
+    if ( DNS_Trylock( &DnsCacheMutex ) == false )
+        {
+            Meer_Log(WARN, "DNS cache is busy.  Not writing a DNS snapshot.");
+            free(buf);
+            return;
+        }
+
+    memset(&header, 0, sizeof(header));
+
+    for ( e = DnsCacheTail; e != DNS_CACHE_NONE; e = DnsCache[e].lru_prev )
+        {
+
+            if ( DnsCache[e].pending == true )
+                {
+                    continue;
+                }
+
+            len = strlen( DnsCache[e].reverse );
+
+            memcpy(buf + pos, &DnsCache[e].lookup_time, sizeof(uint64_t));
+            pos += sizeof(uint64_t);
+            memcpy(buf + pos, DnsCache[e].ip, MAXIPBIT);
+            pos += MAXIPBIT;
+            buf[pos++] = DnsCache[e].ver;
+            buf[pos++] = len;
+            memcpy(buf + pos, DnsCache[e].reverse, len);
+            pos += len;
+
+            header.count++;
+        }
+
+    pthread_mutex_unlock(&DnsCacheMutex);
+
+    header.magic = DNS_SNAPSHOT_MAGIC;
+    header.version = DNS_SNAPSHOT_VERSION;
+
+    /* Write to a temp file and rename() it over the old one so a crash
+       half way doesn't leave a broken snapshot */
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", MeerConfig->dns_snapshot);
+
+    if ( ( fd = open(tmp, (O_CREAT | O_TRUNC | O_WRONLY), (S_IREAD | S_IWRITE)) ) < 0 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot open() DNS snapshot '%s' [%s]", __FILE__, __LINE__, tmp, strerror(errno));
+            free(buf);
+            return;
+        }
+
+    if ( write(fd, &header, sizeof(header)) != sizeof(header) ||
+            write(fd, buf, pos) != (ssize_t)pos ||
+            fsync(fd) != 0 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Failed writing DNS snapshot '%s' [%s]", __FILE__, __LINE__, tmp, strerror(errno));
+            close(fd);
+            unlink(tmp);
+            free(buf);
+            return;
+        }
+
+    close(fd);
+    free(buf);
+
+    if ( rename(tmp, MeerConfig->dns_snapshot) != 0 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot rename DNS snapshot '%s' to '%s' [%s]", __FILE__, __LINE__, tmp, MeerConfig->dns_snapshot, strerror(errno));
+            unlink(tmp);
+        }
+
+}
+
+/* Write the cache out.  Called from the snapshot thread and the signal
+   handler.  Only one of them writes "<dns_snapshot>.tmp" at a time.  If
+   the cache or the other writer is busy for too long,  the last snapshot
+   is left as it is. */
+
+void DNS_Cache_Save( void )
+{
+
+    if ( DnsCache == NULL || MeerConfig->dns_snapshot[0] == '\0' )
+        {
+            return;
+        }
+
+    if ( DNS_Trylock( &DnsSaveMutex ) == false )
+        {
+            Meer_Log(WARN, "A DNS snapshot is already being written.  Not writing another.");
+            return;
+        }
+
+    DNS_Cache_Write();
+
+    pthread_mutex_unlock(&DnsSaveMutex);
+
+}
+
+/* Load a snapshot into the (empty) cache,  skipping anything that has
+   expired since it was written.  A missing or broken snapshot just means a
+   cold cache. */
+
+void DNS_Cache_Load( void )
+{
+
+    struct _DnsSnapshot header;
+    struct stat st;
+
+    unsigned char *map = NULL;
+    size_t pos = sizeof(header);
+    uint64_t now = (uint64_t)time(NULL);
+    uint64_t lookup_time = 0;
+    uint64_t ttl = 0;
+    uint32_t i = 0;
+    uint32_t loaded = 0;
+    uint8_t ver = 0;
+    uint8_t len = 0;
+    int fd = 0;
+
+    char reverse[256] = { 0 };
+
+    if ( ( fd = open(MeerConfig->dns_snapshot, O_RDONLY) ) < 0 )
+        {
+            return;
+        }
+
+    if ( fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header) )
+        {
+            close(fd);
+            return;
+        }
+
+    if ( ( map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ) == MAP_FAILED )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot mmap() DNS snapshot '%s' [%s]", __FILE__, __LINE__, MeerConfig->dns_snapshot, strerror(errno));
+            close(fd);
+            return;
+        }
+
+    close(fd);
+
+    memcpy(&header, map, sizeof(header));
+
+    if ( header.magic != DNS_SNAPSHOT_MAGIC || header.version != DNS_SNAPSHOT_VERSION )
+        {
+            Meer_Log(WARN, "DNS snapshot '%s' isn't a snapshot this version of Meer can read.  Ignoring it.", MeerConfig->dns_snapshot);
+            munmap(map, st.st_size);
+            return;
+        }
+
+    for ( i = 0; i < header.count; i++ )
+        {
+
+            if ( pos + DNS_SNAPSHOT_RECORD > (size_t)st.st_size )
+                {
+                    break;
+                }
+
+            memcpy(&lookup_time, map + pos, sizeof(uint64_t));
+            ver = map[ pos + sizeof(uint64_t) + MAXIPBIT ];
+            len = map[ pos + sizeof(uint64_t) + MAXIPBIT + 1 ];
+
+            if ( pos + DNS_SNAPSHOT_RECORD + len > (size_t)st.st_size )
+                {
+                    break;
+                }
+
+            memcpy(reverse, map + pos + DNS_SNAPSHOT_RECORD, len);
+            reverse[len] = '\0';
+
+            ttl = len != 0 ? MeerConfig->dns_cache : MeerConfig->dns_negative_cache;
+
+            if ( ( ver == IPv4 || ver == IPv6 ) && now >= lookup_time && now - lookup_time < ttl )
+                {
+                    DNS_Cache_Put( map + pos + sizeof(uint64_t), ver, DNS_Cache_Hash( map + pos + sizeof(uint64_t) ), lookup_time, reverse, false );
+                    loaded++;
+                }
+
+            pos += DNS_SNAPSHOT_RECORD + len;
+        }
+
+    munmap(map, st.st_size);
+
+    Meer_Log(NORMAL, "Loaded %" PRIu32 " of %" PRIu32 " DNS cache entries from '%s'.", loaded, header.count, MeerConfig->dns_snapshot);
+
+}
@@ -0,0 +1,58 @@
+/*
+** Copyright (C) 2018-2020 Quadrant Information Security <quadrantsec.com>
+** Copyright (C) 2018-2020 Champ Clark III <cclark@quadrantsec.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License Version 2 as
+** published by the Free Software Foundation.  You may not use, modify or
+** distribute this program under any other version of the GNU General
+** Public License.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program; if not, write to the Free Software
+** Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* Reverse DNS (PTR) lookups and the cache in front of them */
+
+typedef struct _DnsCache _DnsCache;
+struct _DnsCache
+{
+    unsigned char ip[MAXIPBIT];
+    uint8_t ver;			/* IPv4/IPv6 */
+    uint32_t hash;
+    uint32_t lru_prev;			/* DNS_CACHE_NONE at the ends */
+    uint32_t lru_next;
+    uint64_t lookup_time;
+    char reverse[256];			/* "" if the lookup failed (negative) */
+    bool pending;			/* A resolver thread is looking it up */
+};
+
+typedef struct _DnsSnapshot _DnsSnapshot;
+struct _DnsSnapshot
+{
+    uint32_t magic;			/* DNS_SNAPSHOT_MAGIC */
+    uint32_t version;
+    uint32_t count;			/* Records that follow */
+    uint32_t reserved;
+};
+
+typedef struct _DnsQueue _DnsQueue;
+struct _DnsQueue
+{
+    unsigned char ip[MAXIPBIT];
+    uint8_t ver;
+    uint32_t hash;
+};
+
+void DNS_Cache_Init( void );
+void DNS_Resolver_Init( void );
+void DNS_Cache_Save( void );
+void DNS_Cache_Load( void );
+void DNS_Lookup_Reverse( char *host, char *str, size_t size );
+
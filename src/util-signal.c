@@ -35,6 +35,9 @@
 #include "decode-json-alert.h"
 #include "lockfile.h"
 #include "stats.h"
+#include "follow.h"
+#include "pipeline.h"
+#include "util-dns.h"
 
 #include "output-plugins/sql.h"
 
@@ -72,6 +75,10 @@ void Signal_Handler(int sig_num)
 //        case SIGSEGV:
 //        case SIGABRT:
 
+            Pipeline_Stop();
+
+            DNS_Cache_Save();
+
             if ( MeerOutput->pipe_enabled == true )
                 {
                     close(MeerOutput->pipe_fd);
@@ -98,8 +105,7 @@ void Signal_Handler(int sig_num)
                                     MySQL_DB_Query("ROLLBACK");
                                 }
 
-                            MeerOutput->sql_last_cid++;
-                            SQL_Record_Last_CID();
+                            Follow_Record_Last_CID();
                             sleep(1);
                             mysql_close(MeerOutput->mysql_dbh);
                         }
@@ -120,8 +126,7 @@ void Signal_Handler(int sig_num)
                                     PG_DB_Query("ROLLBACK");
                                 }
 
-                            MeerOutput->sql_last_cid++;
-                            SQL_Record_Last_CID();
+                            Follow_Record_Last_CID();
                             sleep(1);
                             PQfinish(MeerOutput->psql);
                         }
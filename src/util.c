@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <time.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -38,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <pthread.h>
 
 
 #include "meer.h"
@@ -45,12 +47,10 @@
 #include "lockfile.h"
 #include "stats.h"
 #include "util.h"
+#include "util-cidr.h"
 
 struct _MeerConfig *MeerConfig;
 struct _MeerCounters *MeerCounters;
-struct _DnsCache *DnsCache;
-
-uint32_t DnsCacheCount = 0;
 
 void Drop_Priv(void)
 {
@@ -93,10 +93,10 @@ void Meer_Log (int type, const char *format,... )
     char *chr="*";
     char curtime[64];
     time_t t;
-    struct tm *now;
+    struct tm now;
     t = time(NULL);
-    now=localtime(&t);
-    strftime(curtime, sizeof(curtime), "%m/%d/%Y %H:%M:%S",  now);
+    localtime_r(&t, &now);
+    strftime(curtime, sizeof(curtime), "%m/%d/%Y %H:%M:%S",  &now);
 
     if ( type == ERROR )
         {
@@ -154,85 +154,278 @@ void Remove_Spaces(char *s)
 }
 
 
-bool IP2Bit(char *ipaddr, unsigned char *out)
+/****************************************************************************
+ * IP_Parse - Turn an IPv4/IPv6 string into MAXIPBIT bytes (IPv4 goes in
+ * the first four,  the rest are zeroed).  Returns IPv4,  IPv6 or 0 if it
+ * isn't an address.  This is done for every alert,  so it's by hand
+ * rather than getaddrinfo()/inet_pton().  Follows inet_pton()'s rules.
+ ****************************************************************************/
+
+static bool IP_Parse_IPv4( const char *ipaddr, unsigned char *out )
 {
 
-    bool ret = false;
-    struct addrinfo hints = {0};
-    struct addrinfo *result = NULL;
+    int octets = 0;
+    int digits = 0;
+    unsigned int val = 0;
+
+    for ( ;; ipaddr++ )
+        {
+
+            if ( *ipaddr >= '0' && *ipaddr <= '9' )
+                {
 
-    /* Use getaddrinfo so we can get ipv4 or 6 */
+                    /* No leading zeros,  no more than 255 */
 
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_DGRAM;
-    hints.ai_flags = AI_PASSIVE|AI_NUMERICHOST;
+                    if ( digits > 0 && val == 0 )
+                        {
+                            return(false);
+                        }
 
-    if ( ipaddr == NULL || ipaddr[0] == '\0' )
+                    val = val * 10 + ( *ipaddr - '0' );
+
+                    if ( val > 255 )
+                        {
+                            return(false);
+                        }
+
+                    digits++;
+                    continue;
+                }
+
+            if ( digits == 0 || octets == 4 )
+                {
+                    return(false);
+                }
+
+            out[octets++] = (unsigned char)val;
+
+            if ( *ipaddr == '\0' )
+                {
+                    return(octets == 4);
+                }
+
+            if ( *ipaddr != '.' )
+                {
+                    return(false);
+                }
+
+            digits = 0;
+            val = 0;
+        }
+
+}
+
+static bool IP_Parse_IPv6( const char *ipaddr, unsigned char *out )
+{
+
+    unsigned char tmp[MAXIPBIT] = { 0 };
+    const char *group = ipaddr;
+    int pos = 0;
+    int gap = -1;			/* Where "::" was */
+    int digits = 0;
+    unsigned int val = 0;
+    int c = 0;
+
+    if ( *ipaddr == ':' )
         {
-            return false;
+
+            if ( *++ipaddr != ':' )
+                {
+                    return(false);
+                }
         }
 
-    ret = getaddrinfo(ipaddr, NULL, &hints, &result) == 0;
+    group = ipaddr;
 
-    /*
-    if (!ret)
+    while ( ( c = (unsigned char)*ipaddr++ ) != '\0' )
         {
-            Meer_Log(S_WARN, "Warning: Got a getaddrinfo() error for \"%s\" but continuing...", ipaddr);
+
+            if ( isxdigit(c) )
+                {
+
+                    if ( ++digits > 4 )
+                        {
+                            return(false);
+                        }
+
+                    val = ( val << 4 ) | ( c <= '9' ? c - '0' : ( c | 0x20 ) - 'a' + 10 );
+                    continue;
+                }
+
+            if ( c == ':' )
+                {
+
+                    group = ipaddr;
+
+                    if ( digits == 0 )
+                        {
+
+                            if ( gap != -1 )
+                                {
+                                    return(false);
+                                }
+
+                            gap = pos;
+                            continue;
+                        }
+
+                    if ( *ipaddr == '\0' || pos + 2 > MAXIPBIT )
+                        {
+                            return(false);
+                        }
+
+                    tmp[pos++] = (unsigned char)( val >> 8 );
+                    tmp[pos++] = (unsigned char)val;
+                    digits = 0;
+                    val = 0;
+                    continue;
+                }
+
+            /* IPv4 on the end ("::ffff:10.0.0.1") */
+
+            if ( c == '.' && pos + 4 <= MAXIPBIT && IP_Parse_IPv4( group, tmp + pos ) )
+                {
+                    pos += 4;
+                    digits = 0;
+                    break;
+                }
+
+            return(false);
         }
-    else
+
+    if ( digits > 0 )
         {
-    */
-    switch (((struct sockaddr_storage *)result->ai_addr)->ss_family)
+
+            if ( pos + 2 > MAXIPBIT )
+                {
+                    return(false);
+                }
+
+            tmp[pos++] = (unsigned char)( val >> 8 );
+            tmp[pos++] = (unsigned char)val;
+        }
+
+    if ( gap != -1 )
         {
-        case AF_INET:
 
-            ret = true;
-            if (out != NULL)
+            if ( pos == MAXIPBIT )
                 {
-                    memcpy(out, &((struct sockaddr_in *)result->ai_addr)->sin_addr, sizeof(((struct sockaddr_in *)0)->sin_addr));
+                    return(false);
                 }
-            break;
 
-        case AF_INET6:
+            memmove( tmp + MAXIPBIT - ( pos - gap ), tmp + gap, pos - gap );
+            memset( tmp + gap, 0, MAXIPBIT - pos );
+            pos = MAXIPBIT;
+        }
+
+    if ( pos != MAXIPBIT )
+        {
+            return(false);
+        }
+
+    memcpy(out, tmp, MAXIPBIT);
+    return(true);
+}
 
-            ret = true;
-            if (out != NULL)
+int IP_Parse( const char *ipaddr, unsigned char *out )
+{
+
+    unsigned char tmp[MAXIPBIT] = { 0 };
+
+    if ( ipaddr == NULL || ipaddr[0] == '\0' )
+        {
+            return(0);
+        }
+
+    if ( IP_Parse_IPv4( ipaddr, tmp ) )
+        {
+
+            if ( out != NULL )
                 {
-                    memcpy(out, &((struct sockaddr_in6 *)result->ai_addr)->sin6_addr, sizeof(((struct sockaddr_in6 *)0)->sin6_addr));
+                    memcpy(out, tmp, MAXIPBIT);
                 }
-            break;
 
-//                default:
-//                    Sagan_Log(S_WARN, "Warning: Got a getaddrinfo() received a non IPv4/IPv6 address for \"%s\" but continuing...", ipaddr);
+            return(IPv4);
         }
-//        }
-    if (result != NULL)
+
+    if ( IP_Parse_IPv6( ipaddr, tmp ) )
         {
-            freeaddrinfo(result);
+
+            if ( out != NULL )
+                {
+                    memcpy(out, tmp, MAXIPBIT);
+                }
+
+            return(IPv6);
         }
 
-    return ret;
+    return(0);
 }
 
+/* Parse a MAC address ("00:1b:c5:0a:ff:01",  '-' or '.' separated works
+   too) into the low 48 bits of "out".  Parsing stops at a '/' so it also
+   takes the prefixes in Wireshark's manuf file ("00:1B:C5" or
+   "00:1B:C5:00:00:00/36").  Returns the number of octets,  0 on error. */
 
-bool Mask2Bit(int mask, unsigned char *out)
+int MAC_Parse( const char *mac, uint64_t *out )
 {
-    int i;
-    bool ret = false;
 
-    if (mask < 1 || mask > 128)
+    uint64_t val = 0;
+    unsigned int octet = 0;
+    int octets = 0;
+    int digits = 0;
+    int c = 0;
+
+    if ( mac == NULL )
         {
-            return false;
+            return(0);
         }
 
-    ret = true;
-
-    for (i=0; i<mask; i+=8)
+    for ( ;; mac++ )
         {
-            out[i/8] = i+8 <= mask ? 0xff : ~((1 << (8 - mask%8)) - 1);
+
+            c = (unsigned char)*mac;
+
+            if ( isxdigit(c) )
+                {
+
+                    if ( ++digits > 2 )
+                        {
+                            return(0);
+                        }
+
+                    octet = ( octet << 4 ) | ( isdigit(c) ? c - '0' : ( c | 0x20 ) - 'a' + 10 );
+                    continue;
+                }
+
+            if ( digits == 0 || octets == 6 )
+                {
+                    return(0);
+                }
+
+            val = ( val << 8 ) | octet;
+            octets++;
+            octet = 0;
+            digits = 0;
+
+            if ( c == '\0' || c == '/' )
+                {
+                    break;
+                }
+
+            if ( c != ':' && c != '-' && c != '.' )
+                {
+                    return(0);
+                }
         }
-    return ret;
 
+    *out = val;
+    return(octets);
+}
+
+bool IP2Bit(char *ipaddr, unsigned char *out)
+{
+    return( IP_Parse( ipaddr, out ) != 0 );
 }
 
 
@@ -278,12 +471,12 @@ uint64_t Current_Epoch( void )
 {
 
     time_t t;
-    struct tm *run;
+    struct tm run;
     char utime_string[20] = { 0 };
 
     t = time(NULL);
-    run=localtime(&t);
-    strftime(utime_string, sizeof(utime_string), "%s",  run);
+    localtime_r(&t, &run);
+    strftime(utime_string, sizeof(utime_string), "%s",  &run);
     uint64_t utime = atol(utime_string);
 
     return(utime);
@@ -292,115 +485,7 @@ uint64_t Current_Epoch( void )
 
 bool Is_IP (char *ipaddr, int ver )
 {
-
-    struct sockaddr_in sa;
-    bool ret = false;
-    char ip[MAXIP];
-
-    strlcpy(ip, ipaddr, sizeof(ip));
-
-    /* We don't use getaddrinfo().  Here's why:
-     * See https://blog.powerdns.com/2014/05/21/a-surprising-discovery-on-converting-ipv6-addresses-we-no-longer-prefer-getaddrinfo/
-     */
-
-    if ( ver == 4 )
-        {
-            ret = inet_pton(AF_INET, ip,  &(sa.sin_addr));
-        }
-    else
-        {
-            ret = inet_pton(AF_INET6, ip,  &(sa.sin_addr));
-        }
-
-    return(ret);
-
-}
-
-void DNS_Lookup_Reverse( char *host, char *str, size_t size )
-{
-
-
-    struct sockaddr_in ipaddr;
-    time_t t;
-    struct tm *run;
-    char utime_string[20] = { 0 };
-    int i = 0;
-    int err = 0;
-
-    t = time(NULL);
-    run=localtime(&t);
-    strftime(utime_string, sizeof(utime_string), "%s",  run);
-    uint64_t utime = atol(utime_string);
-
-
-    char host_r[NI_MAXHOST] = { 0 };
-
-    for (i=0; i<DnsCacheCount; i++)
-        {
-
-            /* If we have a fresh copy,  return whats in memory */
-
-            if ( !strcmp(host, DnsCache[i].ipaddress ) )
-                {
-
-                    if ( ( utime - DnsCache[i].lookup_time ) < MeerConfig->dns_cache )
-                        {
-
-                            MeerCounters->DNSCacheCount++;
-
-                            snprintf(str, size, "%s", DnsCache[i].reverse);
-                            return;
-
-                        }
-                    else
-                        {
-
-                            /* Re-look it up and return it if cache is stale */
-
-                            memset(&ipaddr, 0, sizeof(struct sockaddr_in));
-
-                            ipaddr.sin_family = AF_INET;
-                            ipaddr.sin_port = htons(0);
-
-                            inet_pton(AF_INET, host, &ipaddr.sin_addr);
-
-                            err = getnameinfo((struct sockaddr *)&ipaddr, sizeof(struct sockaddr_in), host_r, sizeof(host_r), NULL, 0, NI_NAMEREQD);
-
-                            strlcpy(DnsCache[i].reverse, host_r, sizeof(DnsCache[i].reverse));
-                            DnsCache[i].lookup_time = utime;
-
-                            MeerCounters->DNSCount++;
-
-                            snprintf(str, size, "%s", DnsCache[i].reverse);
-                            return;
-                        }
-
-                }
-
-        }
-
-    memset(&ipaddr, 0, sizeof(struct sockaddr_in));
-
-    ipaddr.sin_family = AF_INET;
-    ipaddr.sin_port = htons(0);
-
-    inet_pton(AF_INET, host, &ipaddr.sin_addr);
-
-    err = getnameinfo((struct sockaddr *)&ipaddr, sizeof(struct sockaddr_in), host_r, sizeof(host_r), NULL, 0, NI_NAMEREQD);
-
-    /* Insert DNS into cache */
-
-    DnsCache = (_DnsCache *) realloc(DnsCache, (DnsCacheCount+1) * sizeof(_DnsCache));
-
-    strlcpy(DnsCache[DnsCacheCount].ipaddress, host, sizeof(DnsCache[DnsCacheCount].ipaddress));
-    strlcpy(DnsCache[DnsCacheCount].reverse, host_r, sizeof(DnsCache[DnsCacheCount].reverse));
-    DnsCache[DnsCacheCount].lookup_time = utime;
-
-    DnsCacheCount++;
-    MeerCounters->DNSCount++;
-
-    snprintf(str, size, "%s", host_r);
-
+    return( IP_Parse( ipaddr, NULL ) == ver );
 }
 
 int DNS_Lookup_Forward( const char *host, char *str, size_t size )
@@ -496,33 +581,6 @@ int File_Check (char *filename)
     return (stat (filename, &buffer) == 0);
 }
 
-bool Is_Inrange ( unsigned char *ip, unsigned char *tests, int count)
-{
-    int i,j,k;
-    bool inrange = false;
-    for (i=0; i<count*MAXIPBIT*2; i+=MAXIPBIT*2)
-        {
-            inrange = true;
-
-            // We can stop if the mask is 0.  We only handle wellformed masks.
-
-            for(j=0,k=16; j<16 && tests[i+k] != 0x00; j++,k++)
-                {
-                    if((tests[i+j] & tests[i+k]) != (ip[j] & tests[i+k]))
-                        {
-                            inrange = false;
-                            break;
-                        }
-                }
-
-            if (inrange)
-                {
-                    break;
-                }
-        }
-    return inrange;
-}
-
 void To_UpperC(char *const s)
 {
     char* cur = s;
@@ -535,19 +593,193 @@ void To_UpperC(char *const s)
 
 /***************************************************************************
  * MariaDB/MySQL really don't like ISO8601 timestamps :(  This converts
- * the timestamp to a usable SQL value
+ * the timestamp to a usable SQL value ("YYYY-MM-DD HH:MM:SS") and,  if
+ * asked,  to epoch/usec.
+ *
+ * EVE always writes "YYYY-MM-DDTHH:MM:SS.ffffff+zzzz" so that is parsed
+ * by hand.  Events come in bursts from the same second,  so the last
+ * second seen (per thread) is remembered.  Anything else goes through
+ * strptime()/mktime() like it always has.
  ***************************************************************************/
 
-void Convert_ISO8601_For_SQL( char *time, char *str, size_t size )
+static int64_t Days_From_Civil( int y, int m, int d )
+{
+
+    int64_t era = 0;
+    int64_t yoe = 0;
+    int64_t doy = 0;
+    int64_t doe = 0;
+
+    y -= m <= 2;
+    era = ( y >= 0 ? y : y - 399 ) / 400;
+    yoe = y - era * 400;
+    doy = ( 153 * ( m + ( m > 2 ? -3 : 9 ) ) + 2 ) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return( era * 146097 + doe - 719468 );
+}
+
+static __thread char ISO8601_Last[19];
+static __thread int64_t ISO8601_Last_Epoch;		/* Of ISO8601_Last,  as if UTC */
+
+bool Convert_ISO8601( const char *time, uint64_t *epoch, uint32_t *usec, char *str, size_t size )
 {
 
     struct tm tm_;
     char newtime[64] = { 0 };
 
-    strptime(time,"%FT%T",&tm_);
-    strftime(newtime,sizeof(newtime),"%F %T",&tm_);
+    const char *p = time;
+    int64_t base = 0;
+    int offset = 0;
+    uint32_t frac = 0;
+    int digits = 0;
+    int sign = 0;
+    int i = 0;
+
+    static const char format[] = "dddd-dd-ddTdd:dd:dd";
+
+    for ( i = 0; i < 19; i++ )
+        {
+
+            if ( format[i] == 'd' ? !isdigit((unsigned char)p[i]) : p[i] != format[i] )
+                {
+                    goto slow;
+                }
+        }
+
+    if ( memcmp(p, ISO8601_Last, 19) == 0 )
+        {
+            base = ISO8601_Last_Epoch;
+        }
+    else
+        {
+
+            int year  = (p[0]-'0') * 1000 + (p[1]-'0') * 100 + (p[2]-'0') * 10 + (p[3]-'0');
+            int month = (p[5]-'0') * 10 + (p[6]-'0');
+            int day   = (p[8]-'0') * 10 + (p[9]-'0');
+            int hour  = (p[11]-'0') * 10 + (p[12]-'0');
+            int min   = (p[14]-'0') * 10 + (p[15]-'0');
+            int sec   = (p[17]-'0') * 10 + (p[18]-'0');
+
+            if ( month < 1 || month > 12 || day < 1 || day > 31 ||
+                    hour > 23 || min > 59 || sec > 60 )
+                {
+                    goto slow;
+                }
+
+            base = Days_From_Civil(year, month, day) * 86400 + hour * 3600 + min * 60 + sec;
+
+            memcpy(ISO8601_Last, p, 19);
+            ISO8601_Last_Epoch = base;
+        }
+
+    p += 19;
+
+    if ( *p == '.' )
+        {
+
+            p++;
+
+            while ( isdigit((unsigned char)*p) )
+                {
+
+                    if ( digits < 6 )
+                        {
+                            frac = frac * 10 + (*p - '0');
+                            digits++;
+                        }
+
+                    p++;
+                }
+
+            while ( digits < 6 )
+                {
+                    frac = frac * 10;
+                    digits++;
+                }
+        }
+
+    if ( *p == 'Z' )
+        {
+            p++;
+        }
+
+    else if ( ( *p == '+' || *p == '-' ) && isdigit((unsigned char)p[1]) && isdigit((unsigned char)p[2]) )
+        {
+
+            sign = *p == '-' ? -1 : 1;
+            offset = ( (p[1]-'0') * 10 + (p[2]-'0') ) * 3600;
+            p += 3;
+
+            if ( *p == ':' )
+                {
+                    p++;
+                }
+
+            if ( isdigit((unsigned char)p[0]) && isdigit((unsigned char)p[1]) )
+                {
+                    offset += ( (p[0]-'0') * 10 + (p[1]-'0') ) * 60;
+                    p += 2;
+                }
+
+            offset *= sign;
+        }
+
+    else
+        {
+            goto slow;		/* No zone,  leave it to mktime() */
+        }
 
-    snprintf(str, size, "%s", newtime);
+    if ( *p != '\0' )
+        {
+            goto slow;
+        }
+
+    if ( str != NULL && size > 0 )
+        {
+            snprintf(str, size, "%.10s %.8s", time, time + 11);
+        }
+
+    if ( epoch != NULL )
+        {
+            *epoch = (uint64_t)( base - offset );
+        }
+
+    if ( usec != NULL )
+        {
+            *usec = frac;
+        }
+
+    return(true);
+
+slow:
+
+    memset(&tm_, 0, sizeof(tm_));
+
+    if ( strptime(time,"%FT%T",&tm_) == NULL )
+        {
+            return(false);
+        }
+
+    tm_.tm_isdst = -1;
+
+    if ( str != NULL && size > 0 )
+        {
+            strftime(newtime,sizeof(newtime),"%F %T",&tm_);
+            snprintf(str, size, "%s", newtime);
+        }
+
+    if ( epoch != NULL )
+        {
+            *epoch = (uint64_t)mktime(&tm_);
+        }
+
+    if ( usec != NULL )
+        {
+            *usec = 0;
+        }
+
+    return(true);
 }
 
 
@@ -557,152 +789,48 @@ void Convert_ISO8601_For_SQL( char *time, char *str, size_t size )
 /* Checks to see if an ip address is routable or not                        */
 /****************************************************************************/
 
-bool Is_Notroutable ( unsigned char *ip )
-{
+static struct _CIDR_Trie Notroutable;
+static pthread_once_t Notroutable_Once = PTHREAD_ONCE_INIT;
 
-    /* Start of subnet followd by mask */
+static void Is_Notroutable_Init( void )
+{
 
-    static unsigned char tests[][32] =
+    static const char *networks[] =
     {
+        "ff00::/8",			/* IPv6 Multicast */
+        "fe80::/10",			/* IPv6 Link Local */
+        "fc00::/7",			/* IPv6 RFC4193 */
+        "::1/128",			/* IPv6 LocalHost */
+        "10.0.0.0/8",			/* IPv4 RFC1918 */
+        "::ffff:10.0.0.0/104",
+        "192.168.0.0/16",		/* IPv4 RFC1918 */
+        "::ffff:192.168.0.0/112",
+        "172.16.0.0/12",		/* IPv4 RFC1918 */
+        "::ffff:172.16.0.0/108",
+        "127.0.0.0/8",			/* IPv4 localhost */
+        "::ffff:127.0.0.0/104",
+        "224.0.0.0/4",			/* IPv4 Multicast */
+        "::ffff:224.0.0.0/100",
+        "255.255.255.255/32",		/* IPv4 Broadcast */
+        "::ffff:255.255.255.255/128",
+        "169.254.0.0/16",		/* APIPA - Automatic Private IP Addressing */
+    };
+
+    unsigned int i = 0;
 
-        // IPv6 Multicast - ff00::/8
-        {
-            0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv6 Link Local fe80::/10
-        {
-            0xFE, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv6 RFC4193 - fc00::/7
-        {
-            0xFC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv6  LocalHost - ::1/128
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
-        },
-        // IPv4 RFC1918 - 10.0.0.0/8
-        {
-            0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv4-mapped RFC1918 - ::ffff:10.0.0.0/104
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0xFF, 0xFF, 0xA0, 0x00, 0x00, 0x00,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00
-        },
-        // IPv4 RFC1918 - 192.168.0.0/16
-        {
-            0xC0, 0xA8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv4-mapped RFC1918 - ::ffff:192.168.0.0/112
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0xFF, 0xFF, 0xC0, 0xA8, 0x00, 0x00,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00
-        },
-
-        // IPv4 localhost - 127.0.0.0/8
-        {
-            0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv4-mapped localhost - ::ffff:127.0.0.0/104
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0xFF, 0xFF, 0x7F, 0x00, 0x00, 0x00,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00
-        },
-        // IPv4  Mulitcast - 224.0.0.0/4
-        {
-            0xE0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv4-mapped  Mulitcast - ::ffff:224.0.0.0/100
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0xFF, 0xFF, 0xE0, 0x00, 0x00, 0x00,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xF0, 0x00, 0x00, 0x00
-        },
-        // IPv4  Broadcast - 255.255.255.255/32
-        {
-            0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv4-mapped  Broadcast - ::ffff:255.255.255.255/128
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
-        },
-        // IPv4 RFC1918 - 172.16.0.0/12
-        {
-            0xAC, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv4-mapped RFC1918 - ::ffff:172.16.0.0/108
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0xFF, 0xFF, 0xAC, 0x10, 0x00, 0x00,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x6C, 0x00, 0x00
-        },
-        // IPv4 RFC1918 - 172.16.0.0/12
-        {
-            0xAC, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-        },
-        // IPv4-mapped RFC1918 - ::ffff:172.16.0.0/108
-        {
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0xFF, 0xFF, 0xAC, 0x10, 0x00, 0x00,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-            0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x6C, 0x00, 0x00
-        },
-        // 169.254.0.0/16 - APIPA - Automatic Private IP Addressing
-        {
-            0xA9, 0xFE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    for ( i = 0; i < sizeof(networks) / sizeof(networks[0]); i++ )
+        {
+            CIDR_Trie_Add_String( &Notroutable, networks[i] );
         }
 
-    };
+}
+
+bool Is_Notroutable ( unsigned char *ip )
+{
 
-    return Is_Inrange(ip, (unsigned char *)tests, sizeof(tests)/(sizeof(char[32])));
+    pthread_once( &Notroutable_Once, Is_Notroutable_Init );
+
+    return( CIDR_Trie_Match( &Notroutable, ip ) );
 }
 
 /****************************************************************************/
@@ -775,4 +903,18 @@ void Replace_String(const char *in_str, char *orig, char *rep, char *str, size_t
 
 }
 
+/****************************************************************
+ * Block every signal in the calling thread.  Threads we start
+ * call this so signals are handled by the main thread only.
+ ****************************************************************/
+
+void Block_Signals( void )
+{
+
+    sigset_t set;
+
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+}
 
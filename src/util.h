@@ -21,36 +21,14 @@
 #include <stdbool.h>
 #include "meer-def.h"
 
-typedef struct _DnsCache _DnsCache;
-struct _DnsCache
-{
-    char ipaddress[48];
-    char reverse[256];
-    uint64_t lookup_time;
-
-};
-
-typedef struct _Fingerprint_Networks _Fingerprint_Networks;
-struct _Fingerprint_Networks
-{
-
-    struct
-    {
-        unsigned char ipbits[MAXIPBIT];
-        unsigned char maskbits[MAXIPBIT];
-    } range;
-
-};
-
-
 void Drop_Priv(void);
 bool Check_Endian(void);
 char *Hexify(char *xdata, int length);
-void DNS_Lookup_Reverse( char *host, char *str, size_t size );
 int DNS_Lookup_Forward( const char *host, char *str, size_t size );
 bool Validate_JSON_String( const char *buf );
+int IP_Parse( const char *ipaddr, unsigned char *out );
+int MAC_Parse( const char *mac, uint64_t *out );
 bool IP2Bit(char *ipaddr, unsigned char *out);
-bool Mask2Bit(int mask, unsigned char *out);
 void Remove_Spaces(char *s);
 void Remove_Return(char *s);
 uint64_t Current_Epoch( void );
@@ -58,11 +36,11 @@ bool Is_IPv6 (char *ipaddr);
 double CalcPct(uint64_t cnt, uint64_t total);
 bool Is_IP (char *ipaddr, int ver );
 int File_Check (char *filename);
-bool Is_Inrange ( unsigned char *ip, unsigned char *tests, int count);
 void To_UpperC(char *const s);
 uint32_t Djb2_Hash(char *str);
-void Convert_ISO8601_For_SQL( char *time, char *str, size_t size );
+bool Convert_ISO8601( const char *time, uint64_t *epoch, uint32_t *usec, char *str, size_t size );
 bool Is_Notroutable ( unsigned char *ip );
 bool Try_And_Fix_IP ( char *orig_ip, char *str, size_t size );
 void Replace_String(const char *in_str, char *orig, char *rep, char *str, size_t size);
+void Block_Signals( void );
 
@@ -35,10 +35,25 @@
 
 #include "meer.h"
 #include "meer-def.h"
+#include "waldo.h"
 
 struct _MeerWaldo *MeerWaldo;
 struct _MeerConfig *MeerConfig;
 
+/* The waldo file holds one record per spool (MAX_SPOOLS).  The first
+   record is laid out like the original single record waldo,  so old
+   files still load.  MeerWaldo points at the record of the spool we are
+   currently processing.
+
+   After the records come the per-output cursors (OUTPUT_MAX for each
+   record).  Older waldo files are extended with zeros,  which means no
+   output is behind. */
+
+static struct _MeerWaldo *WaldoRecords = NULL;
+static struct _MeerCursor *WaldoCursors = NULL;
+
+#define WALDO_FILE_SIZE	( ( sizeof(_MeerWaldo) + sizeof(_MeerCursor) * OUTPUT_MAX ) * MAX_SPOOLS )
+
 void Init_Waldo( void )
 {
 
@@ -57,21 +72,249 @@ void Init_Waldo( void )
             Meer_Log(ERROR, "[%s, line %d] Cannot open() for waldo '%s' [%s]", __FILE__, __LINE__, MeerConfig->waldo_file, strerror(errno));
         }
 
-    if ( ftruncate(MeerConfig->waldo_fd, sizeof(_MeerWaldo)) != 0 )
+    if ( ftruncate(MeerConfig->waldo_fd, WALDO_FILE_SIZE) != 0 )
         {
             Meer_Log(ERROR, "[%s, line %d] Failed to ftruncate for _MeerWaldo. [%s]", __FILE__, __LINE__, strerror(errno));
         }
 
-    if (( MeerWaldo = mmap(0, sizeof(_MeerWaldo), (PROT_READ | PROT_WRITE), MAP_SHARED, MeerConfig->waldo_fd, 0)) == MAP_FAILED )
+    if (( WaldoRecords = mmap(0, WALDO_FILE_SIZE, (PROT_READ | PROT_WRITE), MAP_SHARED, MeerConfig->waldo_fd, 0)) == MAP_FAILED )
         {
             Meer_Log(ERROR,"[%s, line %d] Error allocating memory for counters object! [%s]", __FILE__, __LINE__, strerror(errno));
         }
 
+    WaldoCursors = (struct _MeerCursor *) &WaldoRecords[MAX_SPOOLS];
+
+    MeerWaldo = &WaldoRecords[0];
+
     if ( new_waldo == false )
         {
-            Meer_Log(NORMAL, "Waldo loaded. Current position: %" PRIu64 "", MeerWaldo->position);
+
+            /* Waldo files from older versions of Meer only have a line count.  The
+               rest of the structure was zero filled by ftruncate() above.  We'll fall
+               back to counting lines on resume and start recording offsets. */
+
+            if ( MeerWaldo->magic != WALDO_MAGIC )
+                {
+                    Meer_Log(NORMAL, "Old style waldo found.  Resume will be by line count.");
+                    MeerWaldo->offset = 0;
+                    MeerWaldo->inode = 0;
+                    MeerWaldo->dev = 0;
+                    MeerWaldo->head_hash = 0;
+                    MeerWaldo->head_len = 0;
+                }
+
+            Meer_Log(NORMAL, "Waldo loaded. Current position: %" PRIu64 " (byte offset %" PRIu64 ")", MeerWaldo->position, MeerWaldo->offset);
         }
 
+    MeerWaldo->magic = WALDO_MAGIC;
+    MeerWaldo->version = WALDO_VERSION;
+
     Meer_Log(NORMAL, "");
 
 }
+
+/* Hash the first "len" bytes of the spool.  Suricata only appends,  so
+   once written these bytes never change unless the file is replaced. */
+
+static uint64_t Waldo_Hash_Head( int fd, uint64_t len )
+{
+
+    unsigned char buf[WALDO_HEAD_SIZE];
+    uint64_t hash = 14695981039346656037ULL;	/* FNV-1a */
+    ssize_t ret = 0;
+    ssize_t i = 0;
+
+    if ( len == 0 )
+        {
+            return(0);
+        }
+
+    if ( len > sizeof(buf) )
+        {
+            len = sizeof(buf);
+        }
+
+    if ( ( ret = pread( fd, buf, len, 0 ) ) != (ssize_t)len )
+        {
+            return(0);
+        }
+
+    for ( i = 0; i < ret; i++ )
+        {
+            hash ^= buf[i];
+            hash *= 1099511628211ULL;
+        }
+
+    return(hash);
+}
+
+/* Record which spool the current offset belongs to.  Called when the
+   spool is (re)opened. */
+
+void Waldo_Set_Spool( int fd )
+{
+
+    struct stat st;
+
+    if ( fstat( fd, &st ) != 0 )
+        {
+            Meer_Log(WARN, "[%s, line %d] Cannot 'stat' spool for waldo [%s]", __FILE__, __LINE__, strerror(errno));
+            return;
+        }
+
+    MeerWaldo->inode = (uint64_t)st.st_ino;
+    MeerWaldo->dev = (uint64_t)st.st_dev;
+    MeerWaldo->head_len = 0;
+    MeerWaldo->head_hash = 0;
+
+    Waldo_Update_Head( fd );
+
+}
+
+/* Keep the head hash current until we've consumed WALDO_HEAD_SIZE bytes.
+   After that,  this is a no-op. */
+
+void Waldo_Update_Head( int fd )
+{
+
+    uint64_t len = MeerWaldo->offset;
+
+    if ( MeerWaldo->head_len >= WALDO_HEAD_SIZE || len == MeerWaldo->head_len )
+        {
+            return;
+        }
+
+    if ( len > WALDO_HEAD_SIZE )
+        {
+            len = WALDO_HEAD_SIZE;
+        }
+
+    MeerWaldo->head_hash = Waldo_Hash_Head( fd, len );
+    MeerWaldo->head_len = len;
+
+}
+
+/* Is the open spool the same one our waldo offset was recorded against? */
+
+bool Waldo_Check_Spool( int fd )
+{
+
+    struct stat st;
+
+    if ( MeerWaldo->offset == 0 || MeerWaldo->inode == 0 )
+        {
+            return(false);
+        }
+
+    if ( fstat( fd, &st ) != 0 )
+        {
+            return(false);
+        }
+
+    if ( (uint64_t)st.st_ino != MeerWaldo->inode || (uint64_t)st.st_dev != MeerWaldo->dev )
+        {
+            Meer_Log(NORMAL, "Spool inode/device doesn't match waldo.");
+            return(false);
+        }
+
+    if ( (uint64_t)st.st_size < MeerWaldo->offset )
+        {
+            Meer_Log(NORMAL, "Spool is smaller than waldo offset.");
+            return(false);
+        }
+
+    if ( Waldo_Hash_Head( fd, MeerWaldo->head_len ) != MeerWaldo->head_hash )
+        {
+            Meer_Log(NORMAL, "Spool head doesn't match waldo.");
+            return(false);
+        }
+
+    return(true);
+}
+
+/* Find (or claim) the waldo record for a spool.  The first spool may adopt
+   the first record if it doesn't belong to anyone yet.  That's the case for
+   waldo files written before Meer could follow more than one spool. */
+
+struct _MeerWaldo *Waldo_Get( const char *spool, bool first )
+{
+
+    int i = 0;
+
+    for ( i = 0; i < MAX_SPOOLS; i++ )
+        {
+            if ( !strcmp( WaldoRecords[i].spool, spool ) )
+                {
+                    return( &WaldoRecords[i] );
+                }
+        }
+
+    if ( first == true && WaldoRecords[0].spool[0] == '\0' )
+        {
+            strlcpy( WaldoRecords[0].spool, spool, sizeof(WaldoRecords[0].spool) );
+            return( &WaldoRecords[0] );
+        }
+
+    for ( i = 1; i < MAX_SPOOLS; i++ )
+        {
+            if ( WaldoRecords[i].spool[0] == '\0' )
+                {
+                    memset( &WaldoRecords[i], 0, sizeof(_MeerWaldo) );
+                    memset( &WaldoCursors[i * OUTPUT_MAX], 0, sizeof(_MeerCursor) * OUTPUT_MAX );
+                    WaldoRecords[i].magic = WALDO_MAGIC;
+                    WaldoRecords[i].version = WALDO_VERSION;
+                    strlcpy( WaldoRecords[i].spool, spool, sizeof(WaldoRecords[i].spool) );
+                    return( &WaldoRecords[i] );
+                }
+        }
+
+    Meer_Log(ERROR, "[%s, line %d] No free waldo records for %s (max %d). Abort!", __FILE__, __LINE__, spool, MAX_SPOOLS);
+
+    return(NULL);
+}
+
+/* Clear the records (and cursors) of spools that aren't in "Spools" */
+
+void Waldo_Release_Unused( struct _MeerSpool *Spools, uint32_t count )
+{
+
+    uint32_t j = 0;
+    int i = 0;
+
+    for ( i = 0; i < MAX_SPOOLS; i++ )
+        {
+
+            if ( WaldoRecords[i].spool[0] == '\0' )
+                {
+                    continue;
+                }
+
+            for ( j = 0; j < count; j++ )
+                {
+                    if ( !strcmp( WaldoRecords[i].spool, Spools[j].filename ) )
+                        {
+                            break;
+                        }
+                }
+
+            if ( j < count )
+                {
+                    continue;
+                }
+
+            Meer_Log(NORMAL, "Releasing waldo record for %s,  which is no longer followed.", WaldoRecords[i].spool);
+
+            memset( &WaldoRecords[i], 0, sizeof(_MeerWaldo) );
+            memset( &WaldoCursors[i * OUTPUT_MAX], 0, sizeof(_MeerCursor) * OUTPUT_MAX );
+            WaldoRecords[i].magic = WALDO_MAGIC;
+            WaldoRecords[i].version = WALDO_VERSION;
+        }
+
+}
+
+/* The per-output cursors for a waldo record */
+
+struct _MeerCursor *Waldo_Get_Cursors( struct _MeerWaldo *Waldo )
+{
+    return( &WaldoCursors[ ( Waldo - WaldoRecords ) * OUTPUT_MAX ] );
+}
@@ -19,3 +19,9 @@
 */
 
 void Init_Waldo( void );
+void Waldo_Set_Spool( int fd );
+void Waldo_Update_Head( int fd );
+bool Waldo_Check_Spool( int fd );
+struct _MeerWaldo *Waldo_Get( const char *spool, bool first );
+void Waldo_Release_Unused( struct _MeerSpool *Spools, uint32_t count );
+struct _MeerCursor *Waldo_Get_Cursors( struct _MeerWaldo *Waldo );